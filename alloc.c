@@ -0,0 +1,156 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "alloc.h"
+
+#define ALLOC_HEADER ((sizeof(s_alloc_page) + ALLOC_GRANULE - 1) & \
+                      ~(ALLOC_GRANULE - 1))
+
+/* Pages not yet handed to a thread, taken from malloc in batches,
+   and the caches of threads that exited, waiting for a new thread to
+   take them over with their pages. */
+static pthread_mutex_t g_alloc_mutex = PTHREAD_MUTEX_INITIALIZER;
+static s_alloc_page *g_alloc_pages = NULL;
+static s_alloc_cache *g_alloc_orphans = NULL;
+static pthread_once_t g_alloc_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_alloc_key;
+static __thread s_alloc_cache *g_alloc_cache = NULL;
+
+/* Bytes requested by the calling thread. */
+__thread unsigned long g_alloc_bytes = 0;
+
+void (*g_alloc_track) (int type, size_t size) = NULL;
+
+static s_alloc_page * alloc_page (void)
+{
+        s_alloc_page *page;
+        pthread_mutex_lock(&g_alloc_mutex);
+        if (!g_alloc_pages) {
+                char *p = malloc((ALLOC_PAGE_BATCH + 1) * ALLOC_PAGE_SIZE);
+                unsigned long i;
+                if (!p) {
+                        pthread_mutex_unlock(&g_alloc_mutex);
+                        return NULL;
+                }
+                p += ALLOC_PAGE_SIZE - ((uintptr_t) p % ALLOC_PAGE_SIZE);
+                for (i = 0; i < ALLOC_PAGE_BATCH; i++) {
+                        page = (s_alloc_page*) (p + i * ALLOC_PAGE_SIZE);
+                        page->next = g_alloc_pages;
+                        g_alloc_pages = page;
+                }
+        }
+        page = g_alloc_pages;
+        g_alloc_pages = page->next;
+        pthread_mutex_unlock(&g_alloc_mutex);
+        return page;
+}
+
+/* Leaves the cache of an exiting thread, with what is left of its
+   pages and the objects other threads free into it, to the next
+   thread that needs one. */
+static void alloc_cache_exit (void *cache)
+{
+        s_alloc_cache *c = cache;
+        g_alloc_cache = NULL;
+        pthread_mutex_lock(&g_alloc_mutex);
+        c->next = g_alloc_orphans;
+        g_alloc_orphans = c;
+        pthread_mutex_unlock(&g_alloc_mutex);
+}
+
+static void alloc_key (void)
+{
+        pthread_key_create(&g_alloc_key, alloc_cache_exit);
+}
+
+static s_alloc_cache * alloc_cache (void)
+{
+        s_alloc_cache *cache;
+        if (g_alloc_cache)
+                return g_alloc_cache;
+        pthread_once(&g_alloc_once, alloc_key);
+        pthread_mutex_lock(&g_alloc_mutex);
+        if ((cache = g_alloc_orphans))
+                g_alloc_orphans = cache->next;
+        pthread_mutex_unlock(&g_alloc_mutex);
+        if (!cache && !(cache = calloc(1, sizeof(s_alloc_cache))))
+                return NULL;
+        pthread_setspecific(g_alloc_key, cache);
+        return g_alloc_cache = cache;
+}
+
+static void * alloc_refill (s_alloc_cache *cache, s_alloc_class *c,
+                            unsigned long size)
+{
+        s_alloc_page *page;
+        void *p;
+        if ((c->free = __atomic_exchange_n(&c->remote, NULL,
+                                           __ATOMIC_ACQUIRE))) {
+                p = c->free;
+                c->free = *(void**) p;
+                return p;
+        }
+        if (!(page = alloc_page()))
+                return NULL;
+        page->owner = cache;
+        page->size = size;
+        c->next = (char*) page + ALLOC_HEADER;
+        c->end = (char*) page + ALLOC_PAGE_SIZE;
+        p = c->next;
+        c->next += size;
+        return p;
+}
+
+/* Small objects come from the buffers of the calling thread, larger
+   ones from malloc. */
+void * alloc (size_t size)
+{
+        s_alloc_cache *cache;
+        s_alloc_class *c;
+        unsigned long i;
+        void *p;
+        g_alloc_bytes += size;
+        if (size > ALLOC_SMALL_MAX)
+                return malloc(size);
+        if (!(cache = alloc_cache()))
+                return NULL;
+        i = size ? (size - 1) / ALLOC_GRANULE : 0;
+        c = &cache->classes[i];
+        if ((p = c->free)) {
+                c->free = *(void**) p;
+                return p;
+        }
+        if ((unsigned long) (c->end - c->next) >= (i + 1) * ALLOC_GRANULE) {
+                p = c->next;
+                c->next += (i + 1) * ALLOC_GRANULE;
+                return p;
+        }
+        return alloc_refill(cache, c, (i + 1) * ALLOC_GRANULE);
+}
+
+/* Returns p, of the size it was allocated with, to the free list of
+   the thread that allocated it. */
+void alloc_free (void *p, size_t size)
+{
+        s_alloc_page *page;
+        s_alloc_class *c;
+        if (!p)
+                return;
+        if (size > ALLOC_SMALL_MAX) {
+                free(p);
+                return;
+        }
+        page = (s_alloc_page*) ((uintptr_t) p & ~(uintptr_t)
+                                (ALLOC_PAGE_SIZE - 1));
+        c = &page->owner->classes[page->size / ALLOC_GRANULE - 1];
+        if (page->owner == g_alloc_cache) {
+                *(void**) p = c->free;
+                c->free = p;
+                return;
+        }
+        *(void**) p = __atomic_load_n(&c->remote, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&c->remote, (void**) p, p, 0,
+                                            __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED))
+                ;
+}
@@ -0,0 +1,56 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+
+#define ALLOC_GRANULE   16
+#define ALLOC_CLASSES   8
+#define ALLOC_SMALL_MAX (ALLOC_GRANULE * ALLOC_CLASSES)
+#define ALLOC_PAGE_SIZE 65536
+#define ALLOC_PAGE_BATCH 16
+
+typedef struct alloc_page  s_alloc_page;
+typedef struct alloc_class s_alloc_class;
+typedef struct alloc_cache s_alloc_cache;
+
+/* A page of objects of one size class, aligned on its size so that
+   an object finds its page, and the cache it came from, by masking
+   its address. */
+struct alloc_page {
+        s_alloc_cache *owner;
+        unsigned long size;
+        s_alloc_page *next;
+};
+
+/* Objects of one size: freed ones, those freed by other threads,
+   pushed without a lock, and the rest of the current page. */
+struct alloc_class {
+        void *free;
+        void *remote;
+        char *next;
+        char *end;
+};
+
+/* The allocation buffers of one thread, passed on with its pages to
+   another thread when it exits. */
+struct alloc_cache {
+        s_alloc_class classes[ALLOC_CLASSES];
+        s_alloc_cache *next;
+};
+
+extern __thread unsigned long g_alloc_bytes;
+
+/* Called with the type and size of every object made while
+   allocations are tracked. */
+extern void (*g_alloc_track) (int type, size_t size);
+
+#define alloc_track(type, size)                                       \
+        do {                                                          \
+                if (g_alloc_track)                                    \
+                        g_alloc_track(type, size);                    \
+        } while (0)
+
+void * alloc (size_t size);
+void   alloc_free (void *p, size_t size);
+
+#endif
@@ -1,18 +1,30 @@
 
 #include <stdlib.h>
+#include "alloc.h"
 #include "backtrace.h"
 #include "env.h"
+#include "error.h"
 #include "frame.h"
 #include "lambda.h"
+#include "room.h"
 
 void push_backtrace_frame (u_form *fun, u_form *vars,
                            s_env *env)
 {
-        s_backtrace_frame *bf = malloc(sizeof(s_backtrace_frame));
+        unsigned long depth = env->backtrace ?
+                env->backtrace->depth + 1 : 1;
+        s_backtrace_frame *bf;
+        if (depth > BACKTRACE_DEPTH_LIMIT)
+                error(env, "evaluation nested too deeply");
+        bf = malloc(sizeof(s_backtrace_frame));
+        alloc_track(ROOM_BACKTRACE_FRAME, sizeof(s_backtrace_frame));
         if (bf) {
                 bf->fun = fun;
                 bf->vars = vars;
+                bf->depth = depth;
                 bf->next = env->backtrace;
+                /* The profiler reads the backtrace from a signal. */
+                __atomic_signal_fence(__ATOMIC_RELEASE);
                 env->backtrace = bf;
         }
 }
@@ -4,9 +4,14 @@
 #include "form.h"
 #include "typedefs.h"
 
+/* Evaluation nests deeper than this signal an error before they
+   run off the C stack of their thread or coroutine. */
+#define BACKTRACE_DEPTH_LIMIT 10000
+
 struct backtrace_frame {
         u_form *fun;
         u_form *vars;
+        unsigned long depth;
         struct backtrace_frame *next;
 };
 
@@ -0,0 +1,17 @@
+(load "bench/bench.lisp")
+
+(defun build (x)
+  (length (random-list 2000)))
+
+(defparameter *items* (random-list 256))
+
+(defun alloc-bench (n)
+  (thread-pool-size n)
+  (print (list 'threads n))
+  (bench "pmapcar random-list 2000" (pmapcar #'build *items*)))
+
+(bench "mapcar random-list 2000" (mapcar #'build *items*))
+(alloc-bench 1)
+(alloc-bench 2)
+(alloc-bench 4)
+(alloc-bench 8)
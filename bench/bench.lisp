@@ -0,0 +1,21 @@
+(defmacro bench (name form)
+  `(let ((start (get-internal-real-time)))
+     ,form
+     (print (list ,name (- (get-internal-real-time) start)))))
+
+(defun random-list (n)
+  (let ((x 42)
+        (l nil))
+    (do ((i 0 (+ i 1)))
+        ((>= i n) l)
+      (setq x (+ (* x 1103515245) 12345))
+      (setq x (- x (* (/ x 2147483648) 2147483648)))
+      (setq l (cons x l)))))
+
+(defun random-vector (n element-type)
+  (let ((v (make-array n :element-type element-type))
+        (i 0))
+    (do ((l (random-list n) (cdr l)))
+        ((endp l) v)
+      (setf (aref v i) (car l))
+      (setq i (+ i 1)))))
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "eval.h"
+#include "form.h"
+#include "hashtable.h"
+#include "symbols.h"
+#include "harness.h"
+
+#define HASHTABLE_OPS 10000
+
+typedef struct hashtable_bench {
+        s_hashtable *h;
+        u_form *keys[HASHTABLE_OPS];
+        u_form *strings[HASHTABLE_OPS];
+        u_form *lists[HASHTABLE_OPS];
+} s_hashtable_bench;
+
+/* Keeps the hashes from being optimised away. */
+static volatile long g_sink;
+
+static void setup_empty (void *arg, unsigned long ops)
+{
+        s_hashtable_bench *b = arg;
+        (void) ops;
+        b->h = new_hashtable(16, 0, 2.0, 1.0);
+}
+
+static void setup_full (void *arg, unsigned long ops)
+{
+        s_hashtable_bench *b = arg;
+        unsigned long i;
+        setup_empty(arg, ops);
+        for (i = 0; i < ops; i++)
+                sethash(b->h, b->keys[i], b->keys[i]);
+}
+
+static void run_sethash (void *arg, unsigned long ops)
+{
+        s_hashtable_bench *b = arg;
+        unsigned long i;
+        for (i = 0; i < ops; i++)
+                sethash(b->h, b->keys[i], b->keys[i]);
+}
+
+static void run_gethash (void *arg, unsigned long ops)
+{
+        s_hashtable_bench *b = arg;
+        unsigned long i;
+        for (i = 0; i < ops; i++)
+                if (gethash(b->h, b->keys[i]) != b->keys[i])
+                        abort();
+}
+
+static void run_remhash (void *arg, unsigned long ops)
+{
+        s_hashtable_bench *b = arg;
+        unsigned long i;
+        for (i = 0; i < ops; i++)
+                remhash(b->h, b->keys[i]);
+}
+
+static void run_sxhash_string (void *arg, unsigned long ops)
+{
+        s_hashtable_bench *b = arg;
+        unsigned long i;
+        long sum = 0;
+        for (i = 0; i < ops; i++)
+                sum += sxhash(b->strings[i]);
+        g_sink = sum;
+}
+
+static void run_sxhash_list (void *arg, unsigned long ops)
+{
+        s_hashtable_bench *b = arg;
+        unsigned long i;
+        long sum = 0;
+        for (i = 0; i < ops; i++)
+                sum += sxhash(b->lists[i]);
+        g_sink = sum;
+}
+
+int main (void)
+{
+        static s_hashtable_bench b;
+        unsigned long i;
+        init_symbols();
+        for (i = 0; i < HASHTABLE_OPS; i++) {
+                char name[32];
+                int len = snprintf(name, sizeof(name), "key-%lu", i);
+                b.keys[i] = (u_form*) new_long(i * 7919);
+                b.strings[i] = (u_form*) new_string(len, name);
+                b.lists[i] = cons(b.keys[i], cons(b.strings[i], nil()));
+        }
+        bench_run("hashtable sethash", setup_empty, run_sethash, &b,
+                  HASHTABLE_OPS);
+        setup_full(&b, HASHTABLE_OPS);
+        bench_run("hashtable gethash", NULL, run_gethash, &b,
+                  HASHTABLE_OPS);
+        bench_run("hashtable remhash", setup_full, run_remhash, &b,
+                  HASHTABLE_OPS);
+        bench_run("sxhash string", NULL, run_sxhash_string, &b,
+                  HASHTABLE_OPS);
+        bench_run("sxhash list", NULL, run_sxhash_list, &b,
+                  HASHTABLE_OPS);
+        return 0;
+}
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "env.h"
+#include "error.h"
+#include "eval.h"
+#include "form.h"
+#include "read.h"
+#include "harness.h"
+
+#define READ_FORMS 1000
+
+typedef struct lisp_bench {
+        const char *name;
+        const char *form;
+        unsigned long ops;
+} s_lisp_bench;
+
+/* Forms evaluated once per repetition, ops counting what they do:
+   loop iterations, calls, conses or list elements. The functions
+   they call are defined in suite.lisp. */
+static const s_lisp_bench g_lisp_benches[] = {
+        { "funcall",      "(call-loop 10000)",      10000 },
+        { "let",          "(let-loop 10000)",       10000 },
+        { "do",           "(do-loop 10000)",        10000 },
+        { "fib 12",       "(fib 12)",               465 },
+        { "tak 12 8 4",   "(tak 12 8 4)",           1 },
+        { "ackermann 2 5", "(ack 2 5)",             1 },
+        { "build list",   "(build-list 10000)",     10000 },
+        { "sort",         "(sort-copy)",            2000 },
+        { "print",        "(print-facts)",          1000 },
+        { NULL, NULL, 0 }
+};
+
+static s_env g_env;
+static char *g_read_text = NULL;
+
+static u_form * read_string (const char *text)
+{
+        s_stream *stream = stream_chunks("bench");
+        u_form *form;
+        stream_feed(stream, text, strlen(text));
+        stream_feed_eof(stream);
+        form = stream_next_form(stream, &g_env);
+        stream_close(stream);
+        return form;
+}
+
+static void run_eval (void *arg, unsigned long ops)
+{
+        (void) ops;
+        eval(arg, &g_env);
+}
+
+static void run_read (void *arg, unsigned long ops)
+{
+        s_stream *stream = stream_chunks("bench");
+        unsigned long n = 0;
+        stream_feed(stream, arg, strlen(arg));
+        stream_feed_eof(stream);
+        while (stream_next_form(stream, &g_env))
+                n++;
+        stream_close(stream);
+        if (n != ops)
+                abort();
+}
+
+static char * read_text (unsigned long forms)
+{
+        char *text = malloc(forms * 64);
+        char *p = text;
+        unsigned long i;
+        if (!text)
+                return NULL;
+        for (i = 0; i < forms; i++)
+                p += sprintf(p, "(fact alpha %lu \"name-%lu\" %lu.5)\n",
+                             i, i, i % 100);
+        return text;
+}
+
+int main (int argc, char **argv)
+{
+        s_error_handler eh;
+        const s_lisp_bench *b;
+        if (argc != 2) {
+                fprintf(stderr, "usage: %s suite.lisp\n", argv[0]);
+                return 2;
+        }
+        env_init_(&g_env, NULL);
+        if (setjmp(eh.buf)) {
+                print_error(&eh, stderr, &g_env);
+                return 1;
+        }
+        push_error_handler(&eh, &g_env);
+        load_file(argv[1], &g_env);
+        for (b = g_lisp_benches; b->name; b++)
+                bench_run(b->name, NULL, run_eval, read_string(b->form),
+                          b->ops);
+        if (!(g_read_text = read_text(READ_FORMS))) {
+                perror("bench");
+                return 1;
+        }
+        bench_run("read", NULL, run_read, g_read_text, READ_FORMS);
+        pop_error_handler(&g_env);
+        return 0;
+}
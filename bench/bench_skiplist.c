@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include "skiplist.h"
+#include "harness.h"
+
+#define SKIPLIST_OPS 10000
+
+typedef struct skiplist_bench {
+        s_skiplist *sl;
+        long keys[SKIPLIST_OPS];
+} s_skiplist_bench;
+
+/* Keys 1 to n in a fixed pseudo-random order. */
+static void shuffle_keys (long *keys, unsigned long n)
+{
+        unsigned long x = 42;
+        unsigned long i;
+        for (i = 0; i < n; i++)
+                keys[i] = i + 1;
+        for (i = n - 1; i > 0; i--) {
+                unsigned long j;
+                long k;
+                x = x * 6364136223846793005UL + 1442695040888963407UL;
+                j = (x >> 33) % (i + 1);
+                k = keys[i];
+                keys[i] = keys[j];
+                keys[j] = k;
+        }
+}
+
+static void setup_empty (void *arg, unsigned long ops)
+{
+        s_skiplist_bench *b = arg;
+        (void) ops;
+        b->sl = new_skiplist(12, 4);
+}
+
+static void setup_full (void *arg, unsigned long ops)
+{
+        s_skiplist_bench *b = arg;
+        unsigned long i;
+        setup_empty(arg, ops);
+        for (i = 0; i < ops; i++)
+                skiplist_insert(b->sl, (void*) b->keys[i]);
+}
+
+static void run_insert (void *arg, unsigned long ops)
+{
+        s_skiplist_bench *b = arg;
+        unsigned long i;
+        for (i = 0; i < ops; i++)
+                skiplist_insert(b->sl, (void*) b->keys[i]);
+}
+
+static void run_find (void *arg, unsigned long ops)
+{
+        s_skiplist_bench *b = arg;
+        unsigned long i;
+        for (i = 0; i < ops; i++)
+                if (!skiplist_find(b->sl, (void*) b->keys[ops - 1 - i]))
+                        abort();
+}
+
+static void run_delete (void *arg, unsigned long ops)
+{
+        s_skiplist_bench *b = arg;
+        unsigned long i;
+        for (i = 0; i < ops; i++)
+                skiplist_delete(b->sl, (void*) b->keys[i]);
+}
+
+int main (void)
+{
+        static s_skiplist_bench b;
+        shuffle_keys(b.keys, SKIPLIST_OPS);
+        setup_full(&b, SKIPLIST_OPS);
+        bench_run("skiplist insert", setup_empty, run_insert, &b,
+                  SKIPLIST_OPS);
+        bench_run("skiplist find", NULL, run_find, &b, SKIPLIST_OPS);
+        bench_run("skiplist delete", setup_full, run_delete, &b,
+                  SKIPLIST_OPS);
+        return 0;
+}
@@ -0,0 +1,16 @@
+(load "bench/bench.lisp")
+
+(defun add2 (a b) (+ a b))
+(defun add-rest (a &rest more) (+ a (car more)))
+(defparameter *h* (make-hash-table))
+(sethash 'a *h* 1)
+
+(bench "funcall 2 args 1e5"
+       (do ((i 0 (+ i 1))) ((>= i 100000)) (add2 i 1)))
+(bench "funcall &rest 1e5"
+       (do ((i 0 (+ i 1))) ((>= i 100000)) (add-rest i 1)))
+(bench "gethash hit 1e5"
+       (do ((i 0 (+ i 1))) ((>= i 100000)) (gethash 'a *h*)))
+(bench "flet call 1e5"
+       (flet ((f (x) x))
+         (do ((i 0 (+ i 1))) ((>= i 100000)) (f i))))
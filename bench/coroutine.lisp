@@ -0,0 +1,50 @@
+(load "bench/bench.lisp")
+
+(defparameter *done* (make-channel))
+
+(defun session (in)
+  (send *done* (+ 1 (receive in))))
+
+(defun sessions (n)
+  (let ((ins nil)
+        (sum 0))
+    (do ((i 0 (+ i 1)))
+        ((= i n))
+      (let ((c (make-channel)))
+        (setq ins (cons c ins))
+        (spawn #'session c)))
+    (mapcar (lambda (c) (send c 1)) ins)
+    (do ((i 0 (+ i 1)))
+        ((= i n) sum)
+      (setq sum (+ sum (receive *done*))))))
+
+(defun relay (in out n)
+  (do ((i 0 (+ i 1)))
+      ((= i n))
+    (send out (receive in))))
+
+(defun ping-pong (n)
+  (let ((a (make-channel))
+        (b (make-channel)))
+    (spawn #'relay a b n)
+    (do ((i 0 (+ i 1)))
+        ((= i n))
+      (send a i)
+      (receive b))))
+
+(defun yielder (n)
+  (do ((i 0 (+ i 1)))
+      ((= i n))
+    (yield))
+  (send *done* n))
+
+(bench "10000 sessions" (sessions 10000))
+(bench "ping-pong 10000" (ping-pong 10000))
+(bench "100 coroutines yielding 100 times"
+       (progn
+         (do ((i 0 (+ i 1)))
+             ((= i 100))
+           (spawn #'yielder 100))
+         (do ((i 0 (+ i 1)))
+             ((= i 100))
+           (receive *done*))))
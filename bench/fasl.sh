@@ -0,0 +1,24 @@
+#!/bin/sh
+# Loading a generated fact set from source versus from a fasl.
+# Usage: bench/fasl.sh [facts] ; CFACTS selects the binary.
+set -e
+N=${1:-200000}
+CFACTS=${CFACTS:-./cfacts}
+SRC=${TMPDIR:-/tmp}/cfacts-bench-fasl.lisp
+FASL=${TMPDIR:-/tmp}/cfacts-bench.fasl
+awk -v n="$N" 'BEGIN {
+        print "(defparameter *facts* nil)"
+        for (i = 0; i < n; i++)
+                printf("(setq *facts* (cons (quote (fact %d -%d %d.%d " \
+                       "\"name-%d\" alpha)) *facts*))\n", i, i % 977,
+                       i % 100, i % 7, i)
+}' > "$SRC"
+echo "(load \"bench/bench.lisp\")
+(bench \"source\" (load \"$SRC\"))
+(save-fasl \"$FASL\" (list (list 'defparameter '*facts*
+                                 (list 'quote *facts*))))" |
+        "$CFACTS" | grep '"source"'
+echo "(load \"bench/bench.lisp\") (bench \"fasl\" (load-fasl \"$FASL\"))" |
+        "$CFACTS" | grep '"fasl"'
+ls -l "$SRC" "$FASL" | awk '{ print $5, $NF }'
+rm -f "$SRC" "$FASL"
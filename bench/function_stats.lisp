@@ -0,0 +1,11 @@
+(load "bench/bench.lisp")
+
+(defun add2 (a b) (+ a b))
+
+(bench "funcall 2 args 1e5"
+       (do ((i 0 (+ i 1))) ((>= i 100000)) (add2 i 1)))
+(function-stats-start)
+(bench "funcall 2 args 1e5 counted"
+       (do ((i 0 (+ i 1))) ((>= i 100000)) (add2 i 1)))
+(function-stats-stop)
+(print (function-stats 'add2))
@@ -0,0 +1,68 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "harness.h"
+
+static unsigned long bench_now (void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+static int bench_compare (const void *a, const void *b)
+{
+        unsigned long x = *(const unsigned long*) a;
+        unsigned long y = *(const unsigned long*) b;
+        return x < y ? -1 : x > y;
+}
+
+static unsigned long bench_reps (void)
+{
+        const char *s = getenv("BENCH_REPS");
+        long reps = s ? atol(s) : 0;
+        return reps > 0 ? (unsigned long) reps : BENCH_REPS;
+}
+
+/* Nearest rank percentile of n sorted samples. */
+static unsigned long bench_percentile (unsigned long *samples,
+                                       unsigned long n, unsigned long p)
+{
+        unsigned long rank = (p * n + 99) / 100;
+        return samples[rank ? rank - 1 : 0];
+}
+
+void bench_run (const char *name, f_bench *setup, f_bench *run,
+                void *arg, unsigned long ops)
+{
+        unsigned long reps = bench_reps();
+        unsigned long *samples = malloc(reps * sizeof(unsigned long));
+        const char *commit = getenv("BENCH_COMMIT");
+        unsigned long i;
+        unsigned long median;
+        if (!samples) {
+                perror("bench");
+                exit(1);
+        }
+        for (i = 0; i < BENCH_WARMUP + reps; i++) {
+                unsigned long start;
+                if (setup)
+                        setup(arg, ops);
+                start = bench_now();
+                run(arg, ops);
+                if (i >= BENCH_WARMUP)
+                        samples[i - BENCH_WARMUP] = bench_now() - start;
+        }
+        qsort(samples, reps, sizeof(unsigned long), bench_compare);
+        median = bench_percentile(samples, reps, 50);
+        printf("{\"bench\": \"%s\", ", name);
+        if (commit && *commit)
+                printf("\"commit\": \"%s\", ", commit);
+        printf("\"ops\": %lu, \"reps\": %lu, \"median_ns\": %lu, "
+               "\"p99_ns\": %lu, \"min_ns\": %lu, \"ns_per_op\": %.1f}\n",
+               ops, reps, median, bench_percentile(samples, reps, 99),
+               samples[0], (double) median / ops);
+        fflush(stdout);
+        free(samples);
+}
@@ -0,0 +1,16 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#define BENCH_WARMUP 3
+#define BENCH_REPS   21
+
+typedef void f_bench (void *arg, unsigned long ops);
+
+/* Runs setup, untimed, then run, timed, BENCH_WARMUP times without
+   recording and BENCH_REPS times recording (BENCH_REPS in the
+   environment overrides it), then prints one line of JSON with the
+   median, 99th percentile and minimum nanoseconds per repetition. */
+void bench_run (const char *name, f_bench *setup, f_bench *run,
+                void *arg, unsigned long ops);
+
+#endif
@@ -0,0 +1,52 @@
+(load "bench/bench.lisp")
+
+(defparameter *keys* 20000)
+(defparameter *threads* 1)
+(defparameter *h* (make-hash-table :synchronized t))
+(do ((i 0 (+ i 1)))
+    ((= i *keys*))
+  (sethash i *h* i))
+
+(defun reader (k)
+  (do ((i k (+ i *threads*)))
+      ((>= i *keys*))
+    (gethash i *h*)))
+
+(defun writer (k)
+  (do ((i k (+ i *threads*)))
+      ((>= i *keys*))
+    (sethash (+ i (* k *keys*)) *h* i)))
+
+(defun mixed (k)
+  (if (= k 0)
+      (writer k)
+      (reader k)))
+
+(defun hashtable-bench (n)
+  (let ((ids nil))
+    (do ((i 0 (+ i 1)))
+        ((= i n))
+      (setq ids (cons i ids)))
+    (setq *threads* n)
+    (thread-pool-size n)
+    (print (list 'threads n))
+    (bench "gethash" (pmapcar #'reader ids))
+    (bench "sethash" (pmapcar #'writer ids))
+    (bench "gethash, one writer" (pmapcar #'mixed ids))))
+
+(let ((plain (make-hash-table)))
+  (do ((i 0 (+ i 1)))
+      ((= i *keys*))
+    (sethash i plain i))
+  (bench "gethash unsynchronized"
+         (do ((i 0 (+ i 1)))
+             ((= i *keys*))
+           (gethash i plain)))
+  (bench "gethash synchronized"
+         (do ((i 0 (+ i 1)))
+             ((= i *keys*))
+           (gethash i *h*))))
+(hashtable-bench 1)
+(hashtable-bench 2)
+(hashtable-bench 4)
+(hashtable-bench 8)
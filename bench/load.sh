@@ -0,0 +1,21 @@
+#!/bin/sh
+# Times (load) on a generated fact dump.
+# Usage: bench/load.sh [megabytes] ; CFACTS selects the binary.
+set -e
+MB=${1:-1024}
+CFACTS=${CFACTS:-./cfacts}
+FILE=${TMPDIR:-/tmp}/cfacts-bench-load.lisp
+awk -v mb="$MB" 'BEGIN {
+        line = sprintf("%099d", 0)
+        n = mb * 1024 * 1024 / 1040
+        for (i = 0; i < n; i++) {
+                printf("(quote (fact alpha beta %d \"", i)
+                for (j = 0; j < 9; j++)
+                        print line
+                printf("%s\"))\n", line)
+        }
+}' > "$FILE"
+ls -l "$FILE"
+echo "(load \"bench/bench.lisp\") (bench \"load ${MB}MB\" (load \"$FILE\"))" |
+        "$CFACTS" | grep load
+rm -f "$FILE"
@@ -0,0 +1,25 @@
+(load "bench/bench.lisp")
+
+(defun fib (n)
+  (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))
+
+(defun score (x)
+  (fib (+ 12 (- x (* (/ x 8) 8)))))
+
+(defparameter *l* (random-list 300))
+
+(defun pool-bench (n)
+  (thread-pool-size n)
+  (print (list 'threads n))
+  (bench "pmapcar score" (pmapcar #'score *l*))
+  (bench "pevery score" (pevery #'score *l*))
+  (bench "preduce + :key score" (preduce #'+ *l* :key #'score)))
+
+(bench "mapcar score" (mapcar #'score *l*))
+(bench "every score" (every #'score *l*))
+(bench "reduce + :key score" (reduce #'+ *l* :key #'score))
+(pool-bench 1)
+(pool-bench 2)
+(pool-bench 4)
+(pool-bench 8)
+(pool-bench 16)
@@ -0,0 +1,9 @@
+(load "bench/bench.lisp")
+
+(defparameter *l* (random-list 1000000))
+(defparameter *m* (mapcar (lambda (x) (list x 1.5 'sym "str"))
+                          (random-list 250000)))
+
+(bench "prin1 1e6 fixnums" (prin1 *l*))
+(bench "prin1 1e6 mixed" (prin1 *m*))
+(bench "prin1-to-string 1e6 fixnums" (prin1-to-string *l*))
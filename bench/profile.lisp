@@ -0,0 +1,20 @@
+(load "bench/bench.lisp")
+
+(defun fib (n)
+  (if (< n 2)
+      n
+      (+ (fib (- n 1)) (fib (- n 2)))))
+
+(bench "fib 22" (fib 22))
+(bench "fib 22 profiled"
+       (progn
+         (profile-start)
+         (fib 22)
+         (profile-stop)))
+(bench "fib 22" (fib 22))
+(bench "fib 22 profiled"
+       (progn
+         (profile-start)
+         (fib 22)
+         (profile-stop)))
+(print (profile-report))
@@ -0,0 +1,23 @@
+#!/bin/sh
+# Reader throughput on a generated file of short facts.
+# Usage: bench/read.sh [megabytes] ; CFACTS selects the binary.
+set -e
+MB=${1:-256}
+CFACTS=${CFACTS:-./cfacts}
+FILE=${TMPDIR:-/tmp}/cfacts-bench-read.lisp
+awk -v mb="$MB" 'BEGIN {
+        size = mb * 1024 * 1024
+        for (i = 0; n < size; i++) {
+                line = sprintf("(quote (fact %d -%d %d.%d \"name-%d\" " \
+                               "alpha 1.5e-3))", i, i % 977, i % 100,
+                               i % 7, i)
+                print line
+                n += length(line) + 1
+        }
+}' > "$FILE"
+BYTES=$(wc -c < "$FILE")
+echo "(load \"bench/bench.lisp\") (bench \"read\" (load \"$FILE\"))" |
+        "$CFACTS" | awk -v bytes="$BYTES" '/"read"/ {
+                gsub(/[()]/, ""); print $2 / 1000 " ms, " \
+                        bytes / $2 " MB/s" }'
+rm -f "$FILE"
@@ -0,0 +1,21 @@
+(load "bench/bench.lisp")
+
+(defun reduce-bench (n)
+  (let ((d (make-array n :element-type 'double-float :initial-element 1.5))
+        (f (make-array n :element-type 'fixnum :initial-element 3)))
+    (print (list 'elements n))
+    (bench "reduce #'+ double" (reduce #'+ d))
+    (bench "reduce #'+ fixnum" (reduce #'+ f))
+    (bench "reduce #'max double" (reduce #'max d))
+    (bench "reduce #'min fixnum" (reduce #'min f))
+    (bench "dot-product double" (dot-product d d))
+    (bench "count :test #'< double" (count 1.0 d :test #'<))
+    (bench "count :test #'< fixnum" (count 2 f :test #'<))
+    (bench "map-into #'+ double" (map-into d #'+ d d))
+    (bench "map-into #'- fixnum" (map-into f #'- f f))))
+
+(reduce-bench 1000000)
+(reduce-bench 100000000)
+
+(defparameter *l* (random-list 1000000))
+(bench "reduce #'+ list 1e6" (reduce #'+ *l*))
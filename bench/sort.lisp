@@ -0,0 +1,22 @@
+(load "bench/bench.lisp")
+
+(defparameter *l3* (random-list 1000))
+(defparameter *l5* (random-list 100000))
+(defparameter *l6* (random-list 1000000))
+
+(bench "sort 1e3 #'<" (setq *l3* (sort *l3* #'<)))
+(bench "sort 1e5 #'<" (setq *l5* (sort *l5* #'<)))
+(bench "sort 1e6 #'<" (setq *l6* (sort *l6* #'<)))
+
+(setq *l3* (random-list 1000))
+(setq *l5* (random-list 100000))
+(bench "sort 1e3 lambda" (sort *l3* (lambda (a b) (< a b))))
+(bench "sort 1e5 lambda" (sort *l5* (lambda (a b) (< a b))))
+
+(defparameter *v* (random-vector 100000 'fixnum))
+(bench "sort fixnum vector 1e5 #'<" (sort *v* #'<))
+(setq *v* (random-vector 10000 t))
+(bench "sort vector 1e4 lambda" (sort *v* (lambda (a b) (< a b))))
+(setq *v* (random-vector 10000 t))
+(bench "stable-sort vector 1e4 lambda"
+       (stable-sort *v* (lambda (a b) (< a b))))
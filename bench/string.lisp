@@ -0,0 +1,19 @@
+(load "bench/bench.lisp")
+
+(defparameter *piece*
+  "0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789")
+(defparameter *pieces* nil)
+(defparameter *s* nil)
+(do ((i 0 (+ i 1))) ((>= i 1000000)) (setq *pieces* (cons *piece* *pieces*)))
+
+(bench "write-string 1e6 x 100 bytes"
+       (let ((b (make-string-output-stream)))
+         (do ((l *pieces* (cdr l))) ((endp l))
+           (write-string (car l) b))
+         (setq *s* (get-output-stream-string b))))
+(bench "concatenate 1e6 x 100 bytes"
+       (apply #'concatenate 'string *pieces*))
+(bench "search 100 MB"
+       (search "0123456789x" *s*))
+(bench "subseq 1e6"
+       (do ((i 0 (+ i 1))) ((>= i 1000000)) (subseq *s* i (+ i 50))))
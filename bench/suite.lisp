@@ -0,0 +1,65 @@
+(defun add2 (a b) (+ a b))
+
+(defun call-loop (n)
+  (do ((i 0 (+ i 1)))
+      ((>= i n))
+    (add2 i 1)))
+
+(defun let-loop (n)
+  (do ((i 0 (+ i 1)))
+      ((>= i n))
+    (let ((a i)
+          (b 1))
+      (+ a b))))
+
+(defun do-loop (n)
+  (do ((i 0 (+ i 1)))
+      ((>= i n))))
+
+(defun fib (n)
+  (if (< n 2)
+      n
+      (+ (fib (- n 1)) (fib (- n 2)))))
+
+(defun tak (x y z)
+  (if (not (< y x))
+      z
+      (tak (tak (- x 1) y z)
+           (tak (- y 1) z x)
+           (tak (- z 1) x y))))
+
+(defun ack (m n)
+  (if (= m 0)
+      (+ n 1)
+      (if (= n 0)
+          (ack (- m 1) 1)
+          (ack (- m 1) (ack m (- n 1))))))
+
+(defun build-list (n)
+  (let ((l nil))
+    (do ((i 0 (+ i 1)))
+        ((>= i n) l)
+      (setq l (cons i l)))))
+
+(defun random-list (n)
+  (let ((x 42)
+        (l nil))
+    (do ((i 0 (+ i 1)))
+        ((>= i n) l)
+      (setq x (+ (* x 1103515245) 12345))
+      (setq x (- x (* (/ x 2147483648) 2147483648)))
+      (setq l (cons x l)))))
+
+(defparameter *sort-list* (random-list 2000))
+
+(defun sort-copy ()
+  (sort (append *sort-list* nil) #'<))
+
+(defparameter *facts*
+  (let ((l nil))
+    (do ((i 0 (+ i 1)))
+        ((>= i 1000) l)
+      (setq l (cons (list 'fact 'alpha i "name" 2.5) l)))))
+
+(defun print-facts ()
+  (prin1-to-string *facts*))
@@ -0,0 +1,20 @@
+#!/bin/sh
+# Reader interning cost on a generated file of distinct symbols.
+# Usage: bench/symbols.sh [symbols] ; CFACTS selects the binary.
+set -e
+N=${1:-1000000}
+CFACTS=${CFACTS:-./cfacts}
+FILE=${TMPDIR:-/tmp}/cfacts-bench-symbols.lisp
+awk -v n="$N" 'BEGIN {
+        for (i = 0; i < n; i += 8) {
+                printf("(quote (")
+                for (j = i; j < i + 8 && j < n; j++)
+                        printf(" symbol-%d", j)
+                print "))"
+        }
+}' > "$FILE"
+echo "(load \"bench/bench.lisp\")
+(bench \"intern $N\" (load \"$FILE\"))
+(bench \"find $N\" (load \"$FILE\"))" |
+        "$CFACTS" | grep '"'
+rm -f "$FILE"
@@ -0,0 +1,16 @@
+(load "bench/bench.lisp")
+
+(defun fib (n)
+  (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))
+
+(defun spawn-fibs (n)
+  (let ((threads nil))
+    (do ((i 0 (+ i 1)))
+        ((= i n) threads)
+      (setq threads (cons (make-thread #'fib 22) threads)))))
+
+(bench "fib 22 x1 sequential" (fib 22))
+(bench "fib 22 x1 threads" (mapcar #'join-thread (spawn-fibs 1)))
+(bench "fib 22 x2 threads" (mapcar #'join-thread (spawn-fibs 2)))
+(bench "fib 22 x4 threads" (mapcar #'join-thread (spawn-fibs 4)))
+(bench "fib 22 x8 threads" (mapcar #'join-thread (spawn-fibs 8)))
@@ -2,14 +2,17 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <readline/readline.h>
 #include <readline/history.h>
 #include "env.h"
 #include "error.h"
 #include "form.h"
+#include "function_stats.h"
 #include "package.h"
 #include "read.h"
 #include "eval.h"
+#include "fasl.h"
 #include "print.h"
 
 int repl (s_env *env)
@@ -27,34 +30,71 @@ int repl (s_env *env)
                                 break;
                         }
                         e = eval(r, env);
-                        if (valuesp(e)) {
+                        if (env->values_count) {
                                 unsigned long i;
-                                for (i = 0; i < e->values.count; i++) {
-                                        u_form *v = values_(e)[i];
-                                        print(v, stdout, env);
-                                }
-                        } else {
                                 print(e, stdout, env);
+                                for (i = 1; i < env->values_count; i++)
+                                        print(env->values[i], stdout,
+                                              env);
                         }
                         puts("");
+                        if (env->si->start == env->si->end)
+                                fflush(stdout);
                         pop_error_handler(env);
                 }
         }
         return 0;
 }
 
-int main ()
+/* Starts from a core saved by save-core instead of loading the init
+   files. */
+static int init_core (const char *path, s_stream *stream, s_env *env)
 {
+        s_error_handler eh;
+        env_init_(env, stream);
+        if (setjmp(eh.buf)) {
+                print_error(&eh, stderr, env);
+                return -1;
+        }
+        push_error_handler(&eh, env);
+        load_core(path, env);
+        pop_error_handler(env);
+        return 0;
+}
+
+static void usage (const char *argv0)
+{
+        fprintf(stderr, "usage: %s [--core path]\n", argv0);
+        exit(2);
+}
+
+int main (int argc, char **argv)
+{
+        s_env env;
         s_stream *stream;
+        const char *core = NULL;
+        const char *path;
+        int i;
         int r;
+        for (i = 1; i < argc; i++) {
+                if (!strcmp(argv[i], "--core") && i + 1 < argc)
+                        core = argv[++i];
+                else
+                        usage(argv[0]);
+        }
         srand(42);
+        if ((path = getenv("CFACTS_FUNCTION_STATS")))
+                function_stats_at_exit(path);
         if (isatty(0))
                 stream = stream_readline("cfacts> ");
         else
                 stream = stream_stdin();
-        env_init(&g_env, stream);
+        if (!core)
+                env_init(&env, stream);
+        else if (init_core(core, stream, &env))
+                return 1;
         using_history();
-        r = repl(&g_env);
+        r = repl(&env);
         if (isatty(0))
                 fputs("\n", stdout);
         return r;
@@ -4,6 +4,41 @@
 #include "compare.h"
 #include "form.h"
 
+static int compare_vectors (s_vector *a, s_vector *b)
+{
+        unsigned long i;
+        int c;
+        if (a->element_type != b->element_type)
+                return a->element_type < b->element_type ? -1 : 1;
+        for (i = 0; i < a->length && i < b->length; i++) {
+                switch (a->element_type) {
+                case VECTOR_T:
+                        c = compare_equal(vector_t(a)[i], vector_t(b)[i]);
+                        break;
+                case VECTOR_U8:
+                        c = (vector_u8(a)[i] < vector_u8(b)[i] ? -1 :
+                             vector_u8(a)[i] > vector_u8(b)[i] ? 1 : 0);
+                        break;
+                case VECTOR_FIXNUM:
+                        c = (vector_fixnum(a)[i] < vector_fixnum(b)[i] ? -1 :
+                             vector_fixnum(a)[i] > vector_fixnum(b)[i] ? 1 :
+                             0);
+                        break;
+                case VECTOR_DOUBLE:
+                        c = (vector_double(a)[i] < vector_double(b)[i] ? -1 :
+                             vector_double(a)[i] > vector_double(b)[i] ? 1 :
+                             0);
+                        break;
+                default:
+                        c = 0;
+                }
+                if (c)
+                        return c;
+        }
+        return (a->length < b->length ? -1 :
+                a->length > b->length ? 1 : 0);
+}
+
 int compare_equal (void *a, void *b)
 {
         u_form *fa = (u_form*) a;
@@ -15,10 +50,6 @@ int compare_equal (void *a, void *b)
                 return -1;
         if (!fb)
                 return 1;
-        if (fa->type == FORM_VALUES)
-                return compare_equal(value_(fa), fb);
-        if (fb->type == FORM_VALUES)
-                return compare_equal(fa, value_(fb));
         if (fa->type < fb->type)
                 return -1;
         if (fa->type > fb->type)
@@ -29,7 +60,7 @@ int compare_equal (void *a, void *b)
                         return c;
                 return compare_equal(fa->cons.cdr, fb->cons.cdr);
         case FORM_STRING:
-                return strcmp(string_str(fa), string_str(fb));
+                return compare_strings(fa, fb);
         case FORM_SYMBOL:
                 return compare_symbols(fa, fb);
         case FORM_PACKAGE:
@@ -44,11 +75,20 @@ int compare_equal (void *a, void *b)
         case FORM_DOUBLE:
                 return (fa->dbl.dbl < fb->dbl.dbl ? -1 :
                         fa->dbl.dbl > fb->dbl.dbl ? 1 : 0);
+        case FORM_VECTOR:
+                return compare_vectors(&fa->vector, &fb->vector);
+        case FORM_CHARACTER:
+                return (fa->character.code < fb->character.code ? -1 :
+                        fa->character.code > fb->character.code ? 1 : 0);
         case FORM_SKIPLIST:
-        case FORM_VALUES:
         case FORM_SKIPLIST_NODE:
         case FORM_FRAME:
         case FORM_HASHTABLE:
+        case FORM_OSTREAM:
+        case FORM_THREAD:
+        case FORM_FUTURE:
+        case FORM_COROUTINE:
+        case FORM_CHANNEL:
                 return skiplist_compare_ptr(fa, fb);
         }
         assert(0);
@@ -98,5 +138,21 @@ int compare_symbols (void *a, void *b)
         assert(sb->type == FORM_SYMBOL);
         if ((c = skiplist_compare_ptr(sa->package, sb->package)))
                 return c;
-        return strcmp(string_str(sa->string), string_str(sb->string));
+        return compare_strings(sa->string, sb->string);
+}
+
+/* Orders strings by their bytes, then by length. */
+int compare_strings (void *a, void *b)
+{
+        s_string *sa = (s_string*) a;
+        s_string *sb = (s_string*) b;
+        unsigned long len = sa->length < sb->length ? sa->length :
+                sb->length;
+        int c;
+        if (sa == sb)
+                return 0;
+        if ((c = memcmp(string_str(sa), string_str(sb), len)))
+                return c;
+        return (sa->length < sb->length ? -1 :
+                sa->length > sb->length ? 1 : 0);
 }
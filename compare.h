@@ -3,6 +3,7 @@
 
 int compare_equal (void *a, void *b);
 int compare_packages (void *a, void *b);
+int compare_strings (void *a, void *b);
 int compare_symbols (void *a, void *b);
 
 #endif
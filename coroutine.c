@@ -0,0 +1,302 @@
+#define _DEFAULT_SOURCE 1
+#include "config.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include "coroutine.h"
+#include "error.h"
+#include "eval.h"
+#include "pool.h"
+#include "profile.h"
+#include "symbols.h"
+
+/* Runnable coroutines, in the order they became so, and the
+   scheduler threads that run them, one per worker of the pool. */
+static pthread_mutex_t g_run_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_run_cond = PTHREAD_COND_INITIALIZER;
+static s_coroutine *g_run_head = NULL;
+static s_coroutine **g_run_tail = &g_run_head;
+static unsigned long g_schedulers = 0;
+static __thread s_coroutine *g_coroutine = NULL;
+
+static void run_queue_push (s_coroutine *co)
+{
+        pthread_mutex_lock(&g_run_mutex);
+        co->state = COROUTINE_RUNNABLE;
+        co->next = NULL;
+        *g_run_tail = co;
+        g_run_tail = &co->next;
+        pthread_cond_signal(&g_run_cond);
+        pthread_mutex_unlock(&g_run_mutex);
+}
+
+static s_coroutine * run_queue_pop (void)
+{
+        s_coroutine *co;
+        pthread_mutex_lock(&g_run_mutex);
+        while (!g_run_head)
+                pthread_cond_wait(&g_run_cond, &g_run_mutex);
+        co = g_run_head;
+        if (!(g_run_head = co->next))
+                g_run_tail = &g_run_head;
+        pthread_mutex_unlock(&g_run_mutex);
+        return co;
+}
+
+#ifdef HAVE_MMAP
+/* A stack as large as a thread's, committed as it is used, with an
+   inaccessible page below it so that an overflow faults instead of
+   writing over the heap. */
+static void * coroutine_stack_new (void)
+{
+        long page = sysconf(_SC_PAGESIZE);
+        char *stack = mmap(NULL, COROUTINE_STACK_SIZE + page,
+                           PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                           -1, 0);
+        if (stack == MAP_FAILED)
+                return NULL;
+        if (mprotect(stack, page, PROT_NONE)) {
+                munmap(stack, COROUTINE_STACK_SIZE + page);
+                return NULL;
+        }
+        return stack + page;
+}
+
+static void coroutine_stack_free (void *stack)
+{
+        long page = sysconf(_SC_PAGESIZE);
+        munmap((char*) stack - page, COROUTINE_STACK_SIZE + page);
+}
+#else
+static void * coroutine_stack_new (void)
+{
+        return malloc(COROUTINE_STACK_SIZE);
+}
+
+static void coroutine_stack_free (void *stack)
+{
+        free(stack);
+}
+#endif
+
+/* Switches from the running coroutine back to its scheduler. */
+static void coroutine_switch (s_coroutine *co, e_coroutine_state state,
+                              pthread_mutex_t *unlock)
+{
+        co->state = state;
+        co->unlock = unlock;
+        swapcontext(&co->context, co->scheduler);
+}
+
+static void coroutine_main (void)
+{
+        s_coroutine *co = g_coroutine;
+        s_error_handler eh;
+        if (setjmp(eh.buf))
+                print_error(&eh, stderr, &co->env);
+        else {
+                push_error_handler(&eh, &co->env);
+                funcall(co->function, co->args, &co->env);
+                pop_error_handler(&co->env);
+        }
+        coroutine_switch(co, COROUTINE_DONE, NULL);
+}
+
+static void * scheduler_main (void *arg)
+{
+        ucontext_t context;
+        (void) arg;
+        for (;;) {
+                s_coroutine *co = run_queue_pop();
+                e_coroutine_state state;
+                pthread_mutex_t *unlock;
+                co->scheduler = &context;
+                g_coroutine = co;
+                profile_set_env(&co->env);
+                swapcontext(&context, &co->context);
+                profile_set_env(NULL);
+                g_coroutine = NULL;
+                /* Once unlocked, a parked coroutine may be made
+                   runnable and resumed elsewhere: co is not read
+                   after that unless it is still ours. */
+                state = co->state;
+                unlock = co->unlock;
+                if (unlock)
+                        pthread_mutex_unlock(unlock);
+                switch (state) {
+                case COROUTINE_RUNNABLE:
+                        run_queue_push(co);
+                        break;
+                case COROUTINE_PARKED:
+                        break;
+                case COROUTINE_DONE:
+                        coroutine_stack_free(co->stack);
+                        co->stack = NULL;
+                        break;
+                }
+        }
+        return NULL;
+}
+
+static void start_schedulers (s_env *env)
+{
+        unsigned long n = pool_size();
+        pthread_mutex_lock(&g_run_mutex);
+        while (g_schedulers < n) {
+                pthread_t t;
+                if (pthread_create(&t, NULL, scheduler_main, NULL))
+                        break;
+                pthread_detach(t);
+                g_schedulers++;
+        }
+        n = g_schedulers;
+        pthread_mutex_unlock(&g_run_mutex);
+        if (!n)
+                error(env, "spawn: cannot create thread");
+}
+
+s_coroutine * spawn (u_form *function, u_form *args, s_env *env)
+{
+        s_coroutine *co;
+        if (!g_schedulers)
+                start_schedulers(env);
+        if (!(co = calloc(1, sizeof(s_coroutine))) ||
+            !(co->stack = coroutine_stack_new())) {
+                free(co);
+                error(env, "spawn: out of memory");
+                return NULL;
+        }
+        co->type = FORM_COROUTINE;
+        co->function = function_designator(function, env);
+        co->args = args;
+        env_init_thread(&co->env, env);
+        getcontext(&co->context);
+        co->context.uc_stack.ss_sp = co->stack;
+        co->context.uc_stack.ss_size = COROUTINE_STACK_SIZE;
+        co->context.uc_link = NULL;
+        makecontext(&co->context, coroutine_main, 0);
+        run_queue_push(co);
+        return co;
+}
+
+/* Lets the other runnable coroutines run. Outside a coroutine, lets
+   the other threads run. */
+void yield (void)
+{
+        s_coroutine *co = g_coroutine;
+        if (co)
+                coroutine_switch(co, COROUTINE_RUNNABLE, NULL);
+        else
+                sched_yield();
+}
+
+s_channel * new_channel (void)
+{
+        s_channel *ch = malloc(sizeof(s_channel));
+        if (ch) {
+                ch->type = FORM_CHANNEL;
+                pthread_mutex_init(&ch->mutex, NULL);
+                pthread_cond_init(&ch->cond, NULL);
+                ch->head = nil();
+                ch->tail = &ch->head;
+                ch->waiting = NULL;
+                ch->waiting_tail = &ch->waiting;
+        }
+        return ch;
+}
+
+void channel_send (s_channel *ch, u_form *x)
+{
+        s_coroutine *co;
+        pthread_mutex_lock(&ch->mutex);
+        *ch->tail = cons(x, nil());
+        ch->tail = &(*ch->tail)->cons.cdr;
+        if ((co = ch->waiting)) {
+                if (!(ch->waiting = co->next))
+                        ch->waiting_tail = &ch->waiting;
+                run_queue_push(co);
+        }
+        pthread_cond_signal(&ch->cond);
+        pthread_mutex_unlock(&ch->mutex);
+}
+
+/* Waits for a form on ch: a coroutine parks until a sender makes it
+   runnable again, its scheduler releasing the channel once it has
+   switched away. */
+u_form * channel_receive (s_channel *ch)
+{
+        s_coroutine *co = g_coroutine;
+        u_form *x;
+        pthread_mutex_lock(&ch->mutex);
+        while (ch->head == nil()) {
+                if (co) {
+                        co->next = NULL;
+                        *ch->waiting_tail = co;
+                        ch->waiting_tail = &co->next;
+                        coroutine_switch(co, COROUTINE_PARKED, &ch->mutex);
+                        pthread_mutex_lock(&ch->mutex);
+                } else
+                        pthread_cond_wait(&ch->cond, &ch->mutex);
+        }
+        x = ch->head->cons.car;
+        if ((ch->head = ch->head->cons.cdr) == nil())
+                ch->tail = &ch->head;
+        pthread_mutex_unlock(&ch->mutex);
+        return x;
+}
+
+/* (spawn function &rest args) */
+u_form * cfun_spawn (u_form *args, s_env *env)
+{
+        if (!consp(args))
+                return error(env, "invalid arguments for spawn");
+        return (u_form*) spawn(args->cons.car, args->cons.cdr, env);
+}
+
+u_form * cfun_yield (u_form *args, s_env *env)
+{
+        if (args != nil())
+                return error(env, "invalid arguments for yield");
+        yield();
+        return nil();
+}
+
+u_form * cfun_coroutinep (u_form *args, s_env *env)
+{
+        if (!consp(args) || args->cons.cdr != nil())
+                return error(env, "invalid arguments for coroutinep");
+        return coroutinep(args->cons.car) ? g_sym.t : nil();
+}
+
+u_form * cfun_make_channel (u_form *args, s_env *env)
+{
+        s_channel *ch;
+        if (args != nil())
+                return error(env, "invalid arguments for make-channel");
+        if (!(ch = new_channel()))
+                return error(env, "make-channel: out of memory");
+        return (u_form*) ch;
+}
+
+u_form * cfun_send (u_form *args, s_env *env)
+{
+        if (!consp(args) || !channelp(args->cons.car) ||
+            !consp(args->cons.cdr) || args->cons.cdr->cons.cdr != nil())
+                return error(env, "invalid arguments for send");
+        channel_send((s_channel*) args->cons.car,
+                     args->cons.cdr->cons.car);
+        return args->cons.cdr->cons.car;
+}
+
+u_form * cfun_receive (u_form *args, s_env *env)
+{
+        if (!consp(args) || !channelp(args->cons.car) ||
+            args->cons.cdr != nil())
+                return error(env, "invalid arguments for receive");
+        return channel_receive((s_channel*) args->cons.car);
+}
@@ -0,0 +1,63 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <pthread.h>
+#include <ucontext.h>
+#include "env.h"
+#include "form.h"
+
+#define COROUTINE_STACK_SIZE (8 * 1024 * 1024)
+
+typedef struct coroutine s_coroutine;
+typedef struct channel   s_channel;
+
+typedef enum {
+        COROUTINE_RUNNABLE,
+        COROUTINE_PARKED,
+        COROUTINE_DONE
+} e_coroutine_state;
+
+/* A function applied on a C stack of its own, with an env of its
+   own for its dynamic state, and run by whichever scheduler thread
+   takes it from the run queue. It runs until it returns, yields or
+   waits on a channel, then switches back to its scheduler, which
+   unlocks the mutex left in unlock. */
+struct coroutine {
+        e_form_type type;
+        e_coroutine_state state;
+        u_form *function;
+        u_form *args;
+        void *stack;
+        ucontext_t context;
+        ucontext_t *scheduler;
+        pthread_mutex_t *unlock;
+        s_coroutine *next;
+        s_env env;
+};
+
+/* An unbounded queue of forms. Coroutines waiting to receive are
+   parked on it; other threads wait on its condition. */
+struct channel {
+        e_form_type type;
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        u_form *head;
+        u_form **tail;
+        s_coroutine *waiting;
+        s_coroutine **waiting_tail;
+};
+
+s_coroutine * spawn (u_form *function, u_form *args, s_env *env);
+void          yield (void);
+s_channel *   new_channel (void);
+void          channel_send (s_channel *ch, u_form *x);
+u_form *      channel_receive (s_channel *ch);
+
+u_form * cfun_spawn (u_form *args, s_env *env);
+u_form * cfun_yield (u_form *args, s_env *env);
+u_form * cfun_coroutinep (u_form *args, s_env *env);
+u_form * cfun_make_channel (u_form *args, s_env *env);
+u_form * cfun_send (u_form *args, s_env *env);
+u_form * cfun_receive (u_form *args, s_env *env);
+
+#endif
@@ -1,15 +1,29 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include "alloc.h"
+#include "coroutine.h"
 #include "env.h"
 #include "error.h"
 #include "eval.h"
+#include "fasl.h"
+#include "form_string.h"
+#include "function_stats.h"
+#include "future.h"
 #include "hashtable.h"
 #include "lambda.h"
 #include "package.h"
+#include "pool.h"
+#include "print.h"
+#include "profile.h"
+#include "room.h"
+#include "sequence.h"
+#include "simd.h"
+#include "sort.h"
+#include "symbols.h"
+#include "thread.h"
 #include "unwind_protect.h"
 
-s_env g_env;
 
 u_form ** symbol_variable (s_symbol *sym, s_env *env)
 {
@@ -60,8 +74,6 @@ u_form * setq (s_symbol *name, u_form *value, s_env *env)
         u_form **f = symbol_variable(name, env);
         if (!f)
                 return error(env, "unbound symbol %s", string_str(name->string));
-        if (valuesp(value))
-                value = value_(value);
         *f = value;
         return value;
 }
@@ -71,26 +83,19 @@ u_form * defparameter (s_symbol *name, u_form *value, s_env *env)
         u_form **f = frame_variable(name, env->global_frame);
         if (!f)                
                 frame_new_variable(name, value, env->global_frame);
-        else {
-                if (valuesp(value))
-                        value = value_(value);
+        else
                 *f = value;
-        }
         return (u_form*) name;
 }
 
 u_form * makunbound (s_symbol *name, s_env *env)
 {
-        s_cons search;
-        search.type = FORM_CONS;
-        search.car = (u_form*) name;
-        search.cdr = NULL;
-        if (env->global_frame->variables)
-                skiplist_delete(env->global_frame->variables, &search);
+        frame_delete_variable(name, env->global_frame);
         return (u_form*) name;
 }
 
-u_form * let_star (u_form *bindings, u_form *body, s_env *env)
+u_form * let_star (u_form * volatile bindings, u_form *body,
+                   s_env *env)
 {
         s_frame *frame = env->frame;
         s_frame *f = new_frame(env->frame);
@@ -160,41 +165,60 @@ u_form * let (u_form *bindings, u_form *body, s_env *env)
         return r;
 }
 
-void cfun (const char *name, f_cfun *fun, s_env *env)
+/* multiple_values marks cfuns that set env->values_count
+   themselves, either because they return several values or because
+   they return the values of a form evaluated in tail position. */
+void cfun_ (const char *name, f_cfun *fun, int multiple_values,
+            s_env *env)
 {
         s_symbol *name_sym = sym(name, env);
-        u_form *cf = malloc(sizeof(s_cfun));
+        s_cfun *cf = alloc(sizeof(s_cfun));
+        alloc_track(FORM_CFUN, sizeof(s_cfun));
         if (cf) {
                 cf->type = FORM_CFUN;
-                cf->cfun.name = name_sym;
-                cf->cfun.fun = fun;
-                frame_new_function(name_sym, cf, env->global_frame);
+                cf->name = name_sym;
+                cf->fun = fun;
+                cf->multiple_values = multiple_values;
+                cf->stats = NULL;
+                frame_new_function(name_sym, (u_form*) cf,
+                                   env->global_frame);
         }
 }
 
-void cspecial (const char *name, f_cfun *fun, s_env *env)
+void cfun (const char *name, f_cfun *fun, s_env *env)
+{
+        cfun_(name, fun, 0, env);
+}
+
+void cspecial_ (const char *name, f_cfun *fun, int multiple_values,
+                s_env *env)
 {
         s_symbol *name_sym = sym(name, env);
-        u_form *cf = malloc(sizeof(s_cfun));
+        s_cfun *cf = alloc(sizeof(s_cfun));
+        alloc_track(FORM_CFUN, sizeof(s_cfun));
         if (cf) {
                 u_form *c;
                 cf->type = FORM_CFUN;
-                cf->cfun.name = name_sym;
-                cf->cfun.fun = fun;
-                c = cons((u_form*) name_sym, cf);
+                cf->name = name_sym;
+                cf->fun = fun;
+                cf->multiple_values = multiple_values;
+                cf->stats = NULL;
+                c = cons((u_form*) name_sym, (u_form*) cf);
                 skiplist_insert(env->specials, c);
         }
 }
 
+void cspecial (const char *name, f_cfun *fun, s_env *env)
+{
+        cspecial_(name, fun, 0, env);
+}
+
 u_form * defun (s_symbol *name, u_form *lambda_list, u_form *body,
                 s_env *env)
 {
-        static s_symbol *function_sym = NULL;
         u_form *lambda;
-        if (!function_sym)
-                function_sym = sym("function", NULL);
-        lambda = (u_form*) new_lambda(function_sym, name, lambda_list,
-                                      body, env);
+        lambda = (u_form*) new_lambda(&g_sym.function->symbol, name,
+                                      lambda_list, body, env);
         frame_new_function(name, lambda, env->global_frame);
         return (u_form*) name;
 }
@@ -210,12 +234,9 @@ u_form * function (s_symbol *name, s_env *env)
 u_form * defmacro (s_symbol *name, u_form *lambda_list, u_form *body,
                    s_env *env)
 {
-        static s_symbol *macro_sym = NULL;
         s_lambda *l;
-        if (!macro_sym)
-                macro_sym = sym("macro", NULL);
-        l = new_lambda(macro_sym, name, lambda_list,
-                                 body, env);
+        l = new_lambda(&g_sym.macro->symbol, name, lambda_list, body,
+                       env);
         frame_new_macro(name, l, env->global_frame);
         return (u_form*) name;
 }
@@ -223,25 +244,16 @@ u_form * defmacro (s_symbol *name, u_form *lambda_list, u_form *body,
 
 u_form * fmakunbound (s_symbol *name, s_env *env)
 {
-        s_cons search;
-        search.type = FORM_CONS;
-        search.car = (u_form*) name;
-        search.cdr = NULL;
-        if (env->global_frame->functions)
-                skiplist_delete(env->global_frame->functions, &search);
-        if (env->global_frame->macros)
-                skiplist_delete(env->global_frame->macros, &search);
+        frame_delete_function(name, env->global_frame);
+        frame_delete_macro(name, env->global_frame);
         return (u_form*) name;
 }
 
 u_form * labels (u_form *bindings, u_form *body, s_env *env)
 {
-        static s_symbol *labels_sym = NULL;
         s_frame *frame = env->frame;
         s_frame *f = new_frame(env->frame);
         u_form *r;
-        if (!labels_sym)
-                labels_sym = sym("labels", NULL);
         env->frame = f;
         while (consp(bindings)) {
                 u_form *first = bindings->cons.car;
@@ -256,7 +268,8 @@ u_form * labels (u_form *bindings, u_form *body, s_env *env)
                 body = first->cons.cdr->cons.cdr;
                 if (!symbolp(name))
                         return error(env, "invalid binding for labels");
-                lambda = (u_form*) new_lambda(labels_sym, &name->symbol,
+                lambda = (u_form*) new_lambda(&g_sym.labels->symbol,
+                                              &name->symbol,
                                               lambda_list, body, env);
                 frame_new_function(&name->symbol, lambda, f);
                 bindings = bindings->cons.cdr;
@@ -268,12 +281,9 @@ u_form * labels (u_form *bindings, u_form *body, s_env *env)
 
 u_form * flet (u_form *bindings, u_form *body, s_env *env)
 {
-        s_symbol *flet_sym = NULL;
         s_frame *frame = env->frame;
         s_frame *f = new_frame(env->frame);
         u_form *r;
-        if (!flet_sym)
-                flet_sym = sym("flet", NULL);
         while (consp(bindings)) {
                 u_form *first = bindings->cons.car;
                 u_form *name;
@@ -287,7 +297,8 @@ u_form * flet (u_form *bindings, u_form *body, s_env *env)
                 body = first->cons.cdr->cons.cdr;
                 if (!symbolp(name))
                         return error(env, "invalid binding for flet");
-                lambda = (u_form*) new_lambda(flet_sym, &name->symbol,
+                lambda = (u_form*) new_lambda(&g_sym.flet->symbol,
+                                              &name->symbol,
                                               lambda_list, body, env);
                 frame_new_function(&name->symbol, lambda, f);
                 bindings = bindings->cons.cdr;
@@ -298,17 +309,32 @@ u_form * flet (u_form *bindings, u_form *body, s_env *env)
         return r;
 }
 
-void env_init (s_env *env, s_stream *si)
+/* Registers the builtins without loading any Lisp. */
+void env_init_ (s_env *env, s_stream *si)
 {
         env->si = si;
         env->run = 1;
         env->frame = env->global_frame = new_frame(NULL);
+        env->package_frame = NULL;
         env->specials = new_skiplist(5, 4);
         env->specials->compare = compare_frame_bindings;
+        env->blocks = NULL;
+        env->error_handler = NULL;
         env->tags = NULL;
+        env->unwind_protect = NULL;
+        env->backtrace = NULL;
+        env->stats_call = NULL;
+        env->values_count = 1;
+        profile_set_env(env);
+        simd_init();
         init_packages(env);
-        defparameter(sym("*package*", NULL),
+        init_characters();
+        init_symbols();
+        defparameter(&g_sym.package_var->symbol,
                      (u_form*) common_lisp_package(), env);
+        defparameter(&g_sym.internal_time_units_per_second->symbol,
+                     (u_form*) new_long(INTERNAL_TIME_UNITS_PER_SECOND),
+                     env);
         cspecial("quote",          cspecial_quote,          env);
         cfun("atom",            cfun_atom,            env);
         cfun("eq",              cfun_eq,              env);
@@ -322,17 +348,17 @@ void env_init (s_env *env, s_stream *si)
         cfun("cdddr",           cfun_cdddr,           env);
         cfun("rplaca",          cfun_rplaca,          env);
         cfun("rplacd",          cfun_rplacd,          env);
-        cspecial("cond",           cspecial_cond,           env);
-        cspecial("case",           cspecial_case,           env);
-        cspecial("do",             cspecial_do,             env);
-        cspecial("when",           cspecial_when,           env);
-        cspecial("unless",         cspecial_unless,         env);
-        cspecial("if",             cspecial_if,             env);
-        cspecial("and",            cspecial_and,            env);
-        cspecial("or",             cspecial_or,             env);
+        cspecial_("cond",          cspecial_cond,           1, env);
+        cspecial_("case",          cspecial_case,           1, env);
+        cspecial_("do",            cspecial_do,             1, env);
+        cspecial_("when",          cspecial_when,           1, env);
+        cspecial_("unless",        cspecial_unless,         1, env);
+        cspecial_("if",            cspecial_if,             1, env);
+        cspecial_("and",           cspecial_and,            1, env);
+        cspecial_("or",            cspecial_or,             1, env);
         cfun("not",             cfun_not,             env);
         cspecial("prog1",          cspecial_prog1,          env);
-        cspecial("progn",          cspecial_progn,          env);
+        cspecial_("progn",         cspecial_progn,          1, env);
         cfun("make-symbol",     cfun_make_symbol,     env);
         cfun("list",            cfun_list,            env);
         cfun("list*",           cfun_list_star,       env);
@@ -347,17 +373,18 @@ void env_init (s_env *env, s_stream *si)
         cfun("every",           cfun_every,           env);
         cfun("mapcar",          cfun_mapcar,          env);
         cfun("sort",            cfun_sort,            env);
-        cspecial("let",            cspecial_let,            env);
-        cspecial("let*",           cspecial_let_star,       env);
+        cfun("stable-sort",     cfun_stable_sort,     env);
+        cspecial_("let",           cspecial_let,            1, env);
+        cspecial_("let*",          cspecial_let_star,       1, env);
         cspecial("defvar",         cspecial_defvar,         env);
         cspecial("defparameter",   cspecial_defparameter,   env);
         cfun("makunbound",      cfun_makunbound,      env);
-        cspecial("block",          cspecial_block,          env);
+        cspecial_("block",         cspecial_block,          1, env);
         cspecial("return-from",    cspecial_return_from,    env);
         cspecial("return",         cspecial_return,         env);
         cspecial("tagbody",        cspecial_tagbody,        env);
         cspecial("go",             cspecial_go,             env);
-        cspecial("unwind-protect", cspecial_unwind_protect, env);
+        cspecial_("unwind-protect", cspecial_unwind_protect, 1, env);
         cspecial("setq",           cspecial_setq,           env);
         cspecial("lambda",         cspecial_lambda,         env);
         cspecial("defun",          cspecial_defun,          env);
@@ -365,27 +392,40 @@ void env_init (s_env *env, s_stream *si)
         cfun("macro-function",  cfun_macro_function,  env);
         cspecial("defmacro",       cspecial_defmacro,       env);
         cfun("fmakunbound",     cfun_fmakunbound,     env);
-        cspecial("labels",         cspecial_labels,         env);
-        cspecial("flet",           cspecial_flet,           env);
+        cspecial_("labels",        cspecial_labels,         1, env);
+        cspecial_("flet",          cspecial_flet,           1, env);
         cfun("error",           cfun_error,           env);
         cfun("gensym",          cfun_gensym,          env);
-        cfun("eval",            cfun_eval,            env);
-        cfun("apply",           cfun_apply,           env);
-        cfun("funcall",         cfun_funcall,         env);
+        cfun_("eval",           cfun_eval,            1, env);
+        cfun_("apply",          cfun_apply,           1, env);
+        cfun_("funcall",        cfun_funcall,         1, env);
         cfun("prin1",           cfun_prin1,           env);
         cfun("print",           cfun_print,           env);
+        cfun("prin1-to-string", cfun_prin1_to_string, env);
         cfun("+",               cfun_plus,            env);
         cfun("-",               cfun_minus,           env);
         cfun("*",               cfun_mul,             env);
         cfun("/",               cfun_div,             env);
         cfun("load",            cfun_load,            env);
+        cfun("save-fasl",       cfun_save_fasl,       env);
+        cfun("load-fasl",       cfun_load_fasl,       env);
+        cfun("save-core",       cfun_save_core,       env);
+        cfun("get-internal-real-time", cfun_get_internal_real_time,
+             env);
         cfun("find-package",    cfun_find_package,    env);
         cfun("symbol-package",  cfun_symbol_package,  env);
-        cfun("find-symbol",     cfun_find_symbol,     env);
-        cfun("values",          cfun_values,          env);
+        cfun_("find-symbol",    cfun_find_symbol,     1, env);
+        cfun("make-package",    cfun_make_package,    env);
+        cspecial("in-package",     cspecial_in_package,     env);
+        cfun("export",          cfun_export,          env);
+        cfun("import",          cfun_import,          env);
+        cfun("use-package",     cfun_use_package,     env);
+        cfun("shadow",          cfun_shadow,          env);
+        cfun("delete-package",  cfun_delete_package,  env);
+        cfun_("values",         cfun_values,          1, env);
         cspecial("nth-value",      cspecial_nth_value,      env);
-        cspecial("multiple-value-bind", cspecial_multiple_value_bind,
-                 env);
+        cspecial_("multiple-value-bind", cspecial_multiple_value_bind,
+                  1, env);
         cspecial("multiple-value-list", cspecial_multiple_value_list,
                  env);
         cspecial("multiple-value-setq", cspecial_multiple_value_setq,
@@ -396,19 +436,102 @@ void env_init (s_env *env, s_stream *si)
 	cfun("hash-table-rehash-size", cfun_hash_table_rehash_size, env);
 	cfun("hash-table-rehash-threshold", cfun_hash_table_rehash_threshold, env);
 	cfun("hash-table-size", cfun_hash_table_size, env);
-	cfun("gethash",         cfun_gethash,         env);
+	cfun_("gethash",        cfun_gethash,         1, env);
 	cfun("sethash",         cfun_sethash,         env);
 	cfun("remhash",         cfun_remhash,         env);
 	cfun("maphash",         cfun_maphash,         env);
 	cfun("clrhash",         cfun_clrhash,         env);
 	cfun("sxhash",          cfun_sxhash,          env);
+        cfun("make-array",      cfun_make_array,      env);
+        cfun("vector",          cfun_vector,          env);
+        cfun("vectorp",         cfun_vectorp,         env);
+        cfun("aref",            cfun_aref,            env);
+        cfun("aset",            cfun_aset,            env);
+        cfun("vector-push-extend", cfun_vector_push_extend, env);
+        cfun("array-element-type", cfun_array_element_type, env);
         cfun("<",               cfun_lt,              env);
         cfun("<=",              cfun_lte,             env);
         cfun(">",               cfun_gt,              env);
         cfun(">=",              cfun_gte,             env);
+        cfun("=",               cfun_num_eq,          env);
+        cfun("min",             cfun_min,             env);
+        cfun("max",             cfun_max,             env);
+        cfun("reduce",          cfun_reduce,          env);
+        cfun("map-into",        cfun_map_into,        env);
+        cfun("dot-product",     cfun_dot_product,     env);
+        cfun("count",           cfun_count,           env);
+        cfun("count-if",        cfun_count_if,        env);
+        cfun("char",            cfun_char,            env);
+        cfun("char-code",       cfun_char_code,       env);
+        cfun("code-char",       cfun_code_char,       env);
+        cfun("string",          cfun_string,          env);
+        cfun("concatenate",     cfun_concatenate,     env);
+        cfun("subseq",          cfun_subseq,          env);
+        cfun("search",          cfun_search,          env);
+        cfun("string=",         cfun_string_eq,       env);
+        cfun("string<",         cfun_string_lt,       env);
+        cfun("string>",         cfun_string_gt,       env);
+        cfun("make-string-output-stream",
+             cfun_make_string_output_stream, env);
+        cfun("write-string",    cfun_write_string,    env);
+        cfun("write-char",      cfun_write_char,      env);
+        cfun("get-output-stream-string",
+             cfun_get_output_stream_string, env);
+        cfun("make-thread",     cfun_make_thread,     env);
+        cfun("join-thread",     cfun_join_thread,     env);
+        cfun("threadp",         cfun_threadp,         env);
+        cfun("pmapcar",         cfun_pmapcar,         env);
+        cfun("pevery",          cfun_pevery,          env);
+        cfun("preduce",         cfun_preduce,         env);
+        cfun("thread-pool-size", cfun_thread_pool_size, env);
+        cspecial("future",         cspecial_future,         env);
+        cfun("force",           cfun_force,           env);
+        cfun("future-done-p",   cfun_future_done_p,   env);
+        cfun("spawn",           cfun_spawn,           env);
+        cfun("yield",           cfun_yield,           env);
+        cfun("coroutinep",      cfun_coroutinep,      env);
+        cfun("make-channel",    cfun_make_channel,    env);
+        cfun("send",            cfun_send,            env);
+        cfun("receive",         cfun_receive,         env);
+        cfun("profile-start",   cfun_profile_start,   env);
+        cfun("profile-stop",    cfun_profile_stop,    env);
+        cfun("profile-report",  cfun_profile_report,  env);
+        cfun("function-stats-start", cfun_function_stats_start, env);
+        cfun("function-stats-stop", cfun_function_stats_stop, env);
+        cfun("function-stats",  cfun_function_stats,  env);
+        cfun("function-stats-dump", cfun_function_stats_dump, env);
+        cfun("alloc-tracking-start", cfun_alloc_tracking_start, env);
+        cfun("alloc-tracking-stop", cfun_alloc_tracking_stop, env);
+        cfun("room",            cfun_room,            env);
+        export_present_symbols(common_lisp_package());
+}
+
+/* An env for another thread, sharing the global frame, specials and
+   packages of parent but with stacks of its own. */
+void env_init_thread (s_env *env, s_env *parent)
+{
+        env->run = 1;
+        env->si = NULL;
+        env->frame = env->global_frame = parent->global_frame;
+        env->specials = parent->specials;
+        env->blocks = NULL;
+        env->error_handler = NULL;
+        env->tags = NULL;
+        env->unwind_protect = NULL;
+        env->backtrace = NULL;
+        env->stats_call = NULL;
+        env->packages = parent->packages;
+        env->package_frame = NULL;
+        env->values_count = 1;
+}
+
+void env_init (s_env *env, s_stream *si)
+{
+        env_init_(env, si);
         load_file("init.lisp", env);
         load_file("backquote.lisp", env);
-        defparameter(sym("*package*", NULL),
+        export_present_symbols(common_lisp_package());
+        defparameter(&g_sym.package_var->symbol,
                      (u_form*) cfacts_package(), env);
 }
 
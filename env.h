@@ -5,6 +5,14 @@
 #include "frame.h"
 #include "typedefs.h"
 
+#define MULTIPLE_VALUES_LIMIT 64
+
+/* Every evaluation leaves values_count set for its result. The
+   primary value is the C return value; values[1] up to
+   values[values_count - 1] hold the others and are only written
+   by forms returning more than one value. package_binding caches
+   the binding of *package* seen from package_frame while
+   g_package_bindings stays at package_bindings. */
 struct env
 {
         int run;
@@ -17,11 +25,15 @@ struct env
         s_tags *tags;
         s_unwind_protect *unwind_protect;
         s_backtrace_frame *backtrace;
+        s_stats_call *stats_call;
         s_skiplist *packages;
+        u_form **package_binding;
+        s_frame *package_frame;
+        unsigned long package_bindings;
+        unsigned long values_count;
+        u_form *values[MULTIPLE_VALUES_LIMIT];
 };
 
-s_env g_env;
-
 u_form ** symbol_variable (s_symbol *sym, s_env *env);
 u_form * symbol_function_ (s_symbol *sym, s_env *env);
 u_form ** symbol_function (s_symbol *sym, s_env *env);
@@ -35,9 +47,14 @@ u_form * defparameter (s_symbol *name, u_form *value, s_env *env);
 u_form * makunbound (s_symbol *name, s_env *env);
 u_form * let (u_form *bindings, u_form *body, s_env *env);
 u_form * let_star (u_form *bindings, u_form *body, s_env *env);
+void env_init_ (s_env *env, s_stream *si);
 void env_init (s_env *env, s_stream *si);
+void env_init_thread (s_env *env, s_env *parent);
 void cfun (const char *name, f_cfun *f, s_env *env);
+void cfun_ (const char *name, f_cfun *f, int multiple_values, s_env *env);
 void cspecial (const char *name, f_cfun *f, s_env *env);
+void cspecial_ (const char *name, f_cfun *f, int multiple_values,
+                s_env *env);
 u_form * defun (s_symbol *name, u_form *lambda_list, u_form *body,
                 s_env *env);
 u_form * function (s_symbol *name, s_env *env);
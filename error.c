@@ -28,7 +28,9 @@ u_form * error_ (s_string *str, s_env *env)
                 eh->backtrace = env->backtrace;
                 long_jump(&eh->buf, env);
         }
-        fprintf(stderr, "cfacts: %s\n", string_str(str));
+        fputs("cfacts: ", stderr);
+        fwrite(string_str(str), 1, str->length, stderr);
+        fputs("\n", stderr);
         return nil();
 }
 
@@ -62,13 +64,13 @@ void print_backtrace (s_backtrace_frame *bf, FILE *stream, s_env *env)
 void print_error (s_error_handler *eh, FILE *stream, s_env *env)
 {
         fputs("cfacts: ", stream);
-        fputs(string_str(eh->string), stream);
+        fwrite(string_str(eh->string), 1, eh->string->length, stream);
         fputs("\nBacktrace:", stream);
         print_backtrace(eh->backtrace, stream, env);
         fputs("\n", stream);
 }
 
-void backtrace ()
+void backtrace (s_env *env)
 {
-        print_backtrace(g_env.backtrace, stderr, &g_env);
+        print_backtrace(env->backtrace, stderr, env);
 }
@@ -1,35 +1,34 @@
 
+#define _POSIX_C_SOURCE 200112L
 #include <assert.h>
 #include <stdlib.h>
+#include <time.h>
 #include "block.h"
 #include "compare.h"
 #include "env.h"
 #include "error.h"
 #include "eval.h"
+#include "form_string.h"
+#include "function_stats.h"
 #include "lambda.h"
 #include "package.h"
 #include "print.h"
 #include "read.h"
+#include "symbols.h"
 #include "tags.h"
 #include "unwind_protect.h"
 
 u_form * eval_nil (u_form *form)
 {
-        static u_form *nil_sym = NULL;
-        if (!nil_sym)
-                nil_sym = (u_form*) sym("nil", NULL);
-        if (form == nil_sym)
+        if (form == g_sym.nil)
                 return nil();
         return NULL;
 }
 
 u_form * eval_t (u_form *form)
 {
-        static u_form *t_sym = NULL;
-        if (!t_sym)
-                t_sym = (u_form*) sym("t", NULL);
-        if (form == t_sym)
-                return t_sym;
+        if (form == g_sym.t)
+                return g_sym.t;
         return NULL;
 }
 
@@ -67,8 +66,6 @@ u_form * mapcar_eval (u_form *list, s_env *env)
         u_form **tail = &head;
         while (consp(list)) {
                 u_form *e = eval(list->cons.car, env);
-                if (valuesp(e))
-                        e = value_(e);
                 *tail = (u_form*) new_cons(e, nil());
                 tail = &(*tail)->cons.cdr;
                 list = list->cons.cdr;
@@ -78,10 +75,7 @@ u_form * mapcar_eval (u_form *list, s_env *env)
 
 u_form * eval_beta (u_form *form, s_env *env)
 {
-        u_form *lambda_sym = NULL;
-        if (!lambda_sym)
-                lambda_sym = (u_form*) sym("lambda", NULL);
-        if (caar(form) == lambda_sym) {
+        if (caar(form) == g_sym.lambda) {
                 u_form *f = eval(form->cons.car, env);
                 u_form *a = mapcar_eval(form->cons.cdr, env);
                 return apply(f, a, env);
@@ -113,6 +107,8 @@ u_form * eval_call_special (u_form *form, u_form **f, s_env *env)
         }
         push_unwind_protect(&up, env);
         result = (*f)->cfun.fun(form->cons.cdr, env);
+        if (!(*f)->cfun.multiple_values)
+                env->values_count = 1;
         pop_unwind_protect(env);
         pop_backtrace_frame(env);
         return result;
@@ -139,10 +135,7 @@ u_form * eval_call (u_form *form, s_env *env)
 
 u_form * cons_quote (u_form *x)
 {
-        static u_form *quote_sym = NULL;
-        if (!quote_sym)
-                quote_sym = (u_form*) sym("quote", NULL);
-        return (u_form*) new_cons(quote_sym,
+        return (u_form*) new_cons(g_sym.quote,
                                   (u_form*) new_cons(x, nil()));
 }
 
@@ -156,44 +149,29 @@ u_form * cspecial_quote (u_form *args, s_env *env)
 
 u_form * cons_backquote (u_form *x)
 {
-        static u_form *backquote_sym = NULL;
-        if (!backquote_sym)
-                backquote_sym = (u_form*) sym("backquote", NULL);
-        return cons(backquote_sym, cons(x, nil()));
+        return cons(g_sym.backquote, cons(x, nil()));
 }
 
 u_form * cons_comma_at (u_form *x, s_env *env)
 {
-        static u_form *s = NULL;
-        if (!s)
-                s = (u_form*) sym("*comma-atsign*", NULL);
-        return cons(eval(s, env), cons(x, nil()));
+        return cons(eval(g_sym.comma_atsign_var, env), cons(x, nil()));
 }
 
 u_form * cons_comma_dot (u_form *x, s_env *env)
 {
-        static u_form *s = NULL;
-        if (!s)
-                s = (u_form*) sym("*comma-dot*", NULL);
-        return cons(eval(s, env), cons(x, nil()));
+        return cons(eval(g_sym.comma_dot_var, env), cons(x, nil()));
 }
 
 u_form * cons_comma (u_form *x, s_env *env)
 {
-        static u_form *s = NULL;
-        if (!s)
-                s = (u_form*) sym("*comma*", NULL);
-        return cons(eval(s, env), cons(x, nil()));
+        return cons(eval(g_sym.comma_var, env), cons(x, nil()));
 }
 
 u_form * atom (u_form *form)
 {
-        static u_form *t = NULL;
-        if (!t)
-                t = (u_form*) sym("t", NULL);
         if (consp(form))
                 return nil();
-        return t;
+        return g_sym.t;
 }
 
 u_form * cfun_atom (u_form *args, s_env *env)
@@ -205,11 +183,8 @@ u_form * cfun_atom (u_form *args, s_env *env)
 }
 
 u_form * eq (u_form *a, u_form *b) {
-        static u_form *t = NULL;
-        if (!t)
-                t = (u_form*) sym("t", NULL);
         if (a == b)
-                return t;
+                return g_sym.t;
         return NULL;
 }
 
@@ -228,17 +203,17 @@ u_form * cfun_eq (u_form *args, s_env *env)
 }
 
 u_form * eql (u_form *a, u_form *b) {
-        static u_form *t = NULL;
-        if (!t)
-                t = (u_form*) sym("t", NULL);
         if (a == b)
-                return t;
+                return g_sym.t;
         if (integerp(a) && integerp(b) &&
             a->lng.lng == b->lng.lng)
-                return t;
+                return g_sym.t;
         if (floatp(a) && floatp(b) &&
             a->dbl.dbl == b->dbl.dbl)
-                return t;
+                return g_sym.t;
+        if (characterp(a) && characterp(b) &&
+            a->character.code == b->character.code)
+                return g_sym.t;
         return NULL;
 }
 
@@ -258,21 +233,24 @@ u_form * cfun_eql (u_form *args, s_env *env)
 
 
 u_form * equal (u_form *a, u_form *b) {
-        static u_form *t = NULL;
-        if (!t)
-                t = (u_form*) sym("t", NULL);
         if (a == b)
-                return t;
+                return g_sym.t;
         if (integerp(a) && integerp(b) &&
             a->lng.lng == b->lng.lng)
-                return t;
+                return g_sym.t;
         if (floatp(a) && floatp(b) &&
             a->dbl.dbl == b->dbl.dbl)
-                return t;
+                return g_sym.t;
         if (consp(a) && consp(b) &&
             equal(a->cons.car, b->cons.car) &&
             equal(a->cons.cdr, b->cons.cdr))
-                return t;
+                return g_sym.t;
+        if (characterp(a) && characterp(b) &&
+            a->character.code == b->character.code)
+                return g_sym.t;
+        if (((vectorp(a) && vectorp(b)) || (stringp(a) && stringp(b))) &&
+            !compare_equal(a, b))
+                return g_sym.t;
         return NULL;
 }
 
@@ -454,18 +432,13 @@ u_form * cspecial_cond (u_form *args, s_env *env)
         }
         if (args != nil())
                 return error(env, "invalid cond form");
+        env->values_count = 1;
         return nil();
 }
 
 u_form * cspecial_case (u_form *args, s_env *env)
 {
-        static u_form *t_sym = NULL;
-        static u_form *otherwise_sym = NULL;
         u_form *key;
-        if (!t_sym) {
-                t_sym = (u_form*) sym("t", NULL);
-                otherwise_sym = (u_form*) sym("otherwise", NULL);
-        }
         if (!consp(args))
                 return error(env, "invalid case form");
         key = eval(args->cons.car, env);
@@ -475,7 +448,7 @@ u_form * cspecial_case (u_form *args, s_env *env)
                 if (!consp(args->cons.car))
                         return error(env, "invalid case form");
                 keys = args->cons.car->cons.car;
-                if (keys == t_sym || keys == otherwise_sym) {
+                if (keys == g_sym.t || keys == g_sym.otherwise) {
                         if (consp(args->cons.cdr))
                                 return error(env, "case otherwise clause should be at end");
                         return cspecial_progn(args->cons.car->cons.cdr,
@@ -488,6 +461,7 @@ u_form * cspecial_case (u_form *args, s_env *env)
         }
         if (args != nil())
                 return error(env, "invalid case form");
+        env->values_count = 1;
         return nil();
 }
 
@@ -572,6 +546,7 @@ u_form * cspecial_when (u_form *args, s_env *env)
                 return error(env, "invalid when form");
         if (eval(args->cons.car, env) != nil())
                 return cspecial_progn(args->cons.cdr, env);
+        env->values_count = 1;
         return nil();
 }
 
@@ -581,6 +556,7 @@ u_form * cspecial_unless (u_form *args, s_env *env)
                 return error(env, "invalid unless form");
         if (eval(args->cons.car, env) == nil())
                 return cspecial_progn(args->cons.cdr, env);
+        env->values_count = 1;
         return nil();
 }
 
@@ -595,20 +571,20 @@ u_form * cspecial_if (u_form *args, s_env *env)
                 return eval(args->cons.cdr->cons.car, env);
         if (consp(args->cons.cdr->cons.cdr))
                 return eval(args->cons.cdr->cons.cdr->cons.car, env);
+        env->values_count = 1;
         return nil();
 }
 
 u_form * cspecial_and (u_form *args, s_env *env)
 {
-        static u_form *t_sym = NULL;
         u_form *test;
-        if (!t_sym)
-                t_sym = (u_form*) sym("t", NULL);
-        test = t_sym;
+        test = g_sym.t;
         while (consp(args) && test != nil()) {
                 test = eval(args->cons.car, env);
                 args = args->cons.cdr;
         }
+        if (consp(args))
+                env->values_count = 1;
         return test;
 }
 
@@ -620,78 +596,62 @@ u_form * cspecial_or (u_form *args, s_env *env)
                 test = eval(args->cons.car, env);
                 args = args->cons.cdr;
         }
+        if (consp(args))
+                env->values_count = 1;
         return test;
 }
 
 u_form * cfun_not (u_form *args, s_env *env)
 {
-        static u_form *t_sym = NULL;
-        if (!t_sym)
-                t_sym = (u_form*) sym("t", NULL);
         if (!consp(args) || args->cons.cdr != nil())
                 return error(env, "invalid arguments for not");
         if (args->cons.car == nil())
-                return t_sym;
+                return g_sym.t;
         return nil();
 }
 
 u_form * cfun_consp (u_form *args, s_env *env)
 {
-        static u_form *t_sym = NULL;
-        if (!t_sym)
-                t_sym = (u_form*) sym("t", NULL);
         if (!consp(args) || args->cons.cdr != nil())
                 return error(env, "invalid arguments for consp");
         if (consp(args->cons.car))
-                return t_sym;
+                return g_sym.t;
         return nil();
 }
 
 u_form * cfun_stringp (u_form *args, s_env *env)
 {
-        static u_form *t_sym = NULL;
-        if (!t_sym)
-                t_sym = (u_form*) sym("t", NULL);
         if (!consp(args) || args->cons.cdr != nil())
                 return error(env, "invalid arguments for stringp");
         if (stringp(args->cons.car))
-                return t_sym;
+                return g_sym.t;
         return nil();
 }
 
 u_form * cfun_symbolp (u_form *args, s_env *env)
 {
-        static u_form *t_sym = NULL;
-        if (!t_sym)
-                t_sym = (u_form*) sym("t", NULL);
         if (!consp(args) || args->cons.cdr != nil())
                 return error(env, "invalid arguments for symbolp");
         if (symbolp(args->cons.car))
-                return t_sym;
+                return g_sym.t;
         return nil();
 }
 
 u_form * cfun_packagep (u_form *args, s_env *env)
 {
-        static u_form *t_sym = NULL;
-        if (!t_sym)
-                t_sym = (u_form*) sym("t", NULL);
         if (!consp(args) || args->cons.cdr != nil())
                 return error(env, "invalid arguments for packagep");
         if (packagep(args->cons.car))
-                return t_sym;
+                return g_sym.t;
         return nil();
 }
 
 u_form * cfun_functionp (u_form *args, s_env *env)
 {
-        static u_form *t_sym = NULL;
-        if (!t_sym)
-                t_sym = (u_form*) sym("t", NULL);
         if (!consp(args) || args->cons.cdr != nil())
                 return error(env, "invalid arguments for functionp");
         if (functionp(args->cons.car))
-                return t_sym;
+                return g_sym.t;
         return nil();
 }
 
@@ -714,6 +674,7 @@ u_form * cspecial_prog1 (u_form *form, s_env *env)
 u_form * cspecial_progn (u_form *form, s_env *env)
 {
         u_form *f = nil();
+        env->values_count = 1;
         while (consp(form)) {
                 f = eval(form->cons.car, env);
                 form = form->cons.cdr;
@@ -842,8 +803,14 @@ long length (u_form *x)
 u_form * cfun_length (u_form *args, s_env *env)
 {
         (void) env;
-        if (!consp(args) || !listp(args->cons.car) ||
-            args->cons.cdr != nil())
+        if (!consp(args) || args->cons.cdr != nil())
+                return error(env, "invalid arguments for length");
+        if (vectorp(args->cons.car))
+                return (u_form*) new_long(args->cons.car->vector.length);
+        if (stringp(args->cons.car))
+                return (u_form*) new_long
+                        (string_char_count(&args->cons.car->string));
+        if (!listp(args->cons.car))
                 return error(env, "invalid arguments for length");
         return (u_form*) new_long(length(args->cons.car));
 }
@@ -919,45 +886,6 @@ u_form * cfun_nconc (u_form *args, s_env *env)
         return nconc(args);
 }
 
-u_form * sort_list (u_form *list)
-{
-        long len = length(list);
-        while (len--) {
-                long i = len;
-                u_form *a = list;
-                while (i--) {
-                        if (compare_equal(a->cons.car,
-                                          a->cons.cdr->cons.car) > 0) {
-                                u_form *tmp = a->cons.car;
-                                a->cons.car = a->cons.cdr->cons.car;
-                                a->cons.cdr->cons.car = tmp;
-                        }
-                        a = a->cons.cdr;
-                }
-        }
-        return list;
-}
-
-u_form * sort (u_form *arg, s_env *env)
-{
-        switch (arg->type) {
-        case FORM_CONS:
-                return sort_list(arg);
-        case FORM_SYMBOL:
-                return arg;
-        default:
-                break;
-        }
-        return error(env, "don't know how to sort argument");
-}
-
-u_form * cfun_sort (u_form *args, s_env *env)
-{
-        if (!consp(args) || args->cons.cdr != nil())
-                return error(env, "invalid arguments for sort");
-        return sort(args->cons.car, env);
-}
-
 u_form * cfun_notany (u_form *args, s_env *env)
 {
         u_form *pred;
@@ -978,7 +906,7 @@ u_form * cfun_notany (u_form *args, s_env *env)
                 if (funcall(pred, args, env) != nil())
                         return nil();
         }
-        return (u_form*) sym("t", NULL);
+        return g_sym.t;
 }
 
 u_form * cfun_every (u_form *args, s_env *env)
@@ -1001,7 +929,7 @@ u_form * cfun_every (u_form *args, s_env *env)
                 if (funcall(pred, args, env) == nil())
                         return nil();
         }
-        return (u_form*) sym("t", NULL);
+        return g_sym.t;
 }
 
 u_form * cfun_mapcar (u_form *args, s_env *env)
@@ -1179,7 +1107,7 @@ u_form * cspecial_lambda (u_form *args, s_env *env)
         s_lambda *l;
         if (!consp(args) || !consp(args->cons.cdr))
                 return error(env, "invalid lambda form");
-        l = new_lambda(sym("lambda", NULL), &nil()->symbol,
+        l = new_lambda(&g_sym.lambda->symbol, &nil()->symbol,
                                  args->cons.car, args->cons.cdr,
                                  env);
         return (u_form*) l;
@@ -1197,10 +1125,7 @@ u_form * cspecial_defun (u_form *args, s_env *env)
 
 u_form * cons_function (u_form *x)
 {
-        static u_form *function_sym = NULL;
-        if (!function_sym)
-                function_sym = (u_form*) sym("function", NULL);
-        return cons(function_sym, cons(x, nil()));
+        return cons(g_sym.function, cons(x, nil()));
 }
 
 u_form * cspecial_function (u_form *args, s_env *env)
@@ -1265,19 +1190,15 @@ u_form * cfun_error (u_form *args, s_env *env)
 
 u_form * cfun_gensym (u_form *args, s_env *env)
 {
-        static s_string *g = NULL;
-        s_string *s;
-        if (!g)
-                g = new_string(1, "g");
-        s = g;
         if (consp(args)) {
                 if (!stringp(args->cons.car) ||
                     args->cons.cdr != nil())
                         return error(env, "invalid arguments for "
                                      "gensym");
-                s = &args->cons.car->string;
+                return (u_form*) gensym(string_cstr(&args->cons.car->
+                                                    string));
         }
-        return (u_form*) gensym(string_str(s));
+        return (u_form*) gensym("g");
 }
 
 u_form * apply (u_form *fun, u_form *args, s_env *env)
@@ -1308,20 +1229,34 @@ u_form * funcall_cfun (u_form *fun, u_form *args, s_env *env)
         }
         push_unwind_protect(&up, env);
         result = fun->cfun.fun(args, env);
+        if (!fun->cfun.multiple_values)
+                env->values_count = 1;
         pop_unwind_protect(env);
         pop_backtrace_frame(env);
         return result;
 }
 
+/* Resolve a function designator once so that callers applying it
+   many times skip the symbol lookup, and can compare cfun pointers. */
+u_form * function_designator (u_form *fun, s_env *env)
+{
+        if (symbolp(fun) && !(fun = symbol_function_(&fun->symbol, env)))
+                return error(env, "not a function designator");
+        if (car(fun) == g_sym.lambda)
+                fun = eval(fun, env);
+        if (!functionp(fun))
+                return error(env, "not a function designator");
+        return fun;
+}
+
 u_form * funcall (u_form *fun, u_form *args, s_env *env)
 {
-        static u_form *lambda_sym = NULL;
-        if (!lambda_sym)
-                lambda_sym = (u_form*) sym("lambda", NULL);
         if (fun->type == FORM_SYMBOL)
                 fun = symbol_function_(&fun->symbol, env);
-        if (car(fun) == lambda_sym)
+        if (car(fun) == g_sym.lambda)
                 fun = eval(fun, env);
+        if (g_function_stats && functionp(fun))
+                return stats_funcall(fun, args, env);
         if (fun && fun->type == FORM_CFUN)
                 return funcall_cfun(fun, args, env);
         if (fun && fun->type == FORM_LAMBDA)
@@ -1339,6 +1274,7 @@ u_form * cfun_funcall (u_form *args, s_env *env)
 u_form * eval (u_form *form, s_env *env)
 {
         u_form *f;
+        env->values_count = 1;
         if ((f = eval_nil(form))) return f;
         if ((f = eval_t(form))) return f;
         if ((f = eval_keyword(form, env))) return f;
@@ -1373,34 +1309,35 @@ u_form * cfun_print (u_form *args, s_env *env)
         return nil();
 }
 
+/* Accumulate fixnums exactly until the first float, then switch to
+   a double accumulator : one pass and a single boxed result. */
 u_form * cfun_plus (u_form *args, s_env *env)
 {
-        int d = 0;
-        u_form *a = args;
-        while (consp(a)) {
-                if (floatp(a->cons.car))
-                        d = 1;
-                else if (!integerp(a->cons.car))
-                        return error(env, "invalid arguments for +");
-                a = a->cons.cdr;
-        }
-        if (d) {
-                a = (u_form*) new_double(0.0);
-                while (consp(args)) {
-                        if (floatp(args->cons.car))
-                                a->dbl.dbl += args->cons.car->dbl.dbl;
+        long l = 0;
+        double d = 0.0;
+        int dbl = 0;
+        while (consp(args)) {
+                u_form *x = args->cons.car;
+                if (integerp(x)) {
+                        if (dbl)
+                                d += x->lng.lng;
                         else
-                                a->dbl.dbl += args->cons.car->lng.lng;
-                        args = args->cons.cdr;
+                                l += x->lng.lng;
                 }
-                return a;
-        }
-        a = (u_form*) new_long(0);
-        while (consp(args)) {
-                a->lng.lng += args->cons.car->lng.lng;
+                else if (floatp(x)) {
+                        if (!dbl) {
+                                d = l;
+                                dbl = 1;
+                        }
+                        d += x->dbl.dbl;
+                }
+                else
+                        return error(env, "invalid arguments for +");
                 args = args->cons.cdr;
         }
-        return a;
+        if (dbl)
+                return (u_form*) new_double(d);
+        return (u_form*) new_long(l);
 }
 
 u_form * cfun_minus (u_form *args, s_env *env)
@@ -1443,32 +1380,31 @@ u_form * cfun_minus (u_form *args, s_env *env)
 
 u_form * cfun_mul (u_form *args, s_env *env)
 {
-        int d = 0;
-        u_form *a = args;
-        while (consp(a)) {
-                if (floatp(a->cons.car))
-                        d = 1;
-                else if (!integerp(a->cons.car))
-                        return error(env, "invalid arguments for *");
-                a = a->cons.cdr;
-        }
-        if (d) {
-                a = (u_form*) new_double(1.0);
-                while (consp(args)) {
-                        if (floatp(args->cons.car))
-                                a->dbl.dbl *= args->cons.car->dbl.dbl;
+        long l = 1;
+        double d = 1.0;
+        int dbl = 0;
+        while (consp(args)) {
+                u_form *x = args->cons.car;
+                if (integerp(x)) {
+                        if (dbl)
+                                d *= x->lng.lng;
                         else
-                                a->dbl.dbl *= args->cons.car->lng.lng;
-                        args = args->cons.cdr;
+                                l *= x->lng.lng;
                 }
-                return a;
-        }
-        a = (u_form*) new_long(1);
-        while (consp(args)) {
-                a->lng.lng *= args->cons.car->lng.lng;
+                else if (floatp(x)) {
+                        if (!dbl) {
+                                d = l;
+                                dbl = 1;
+                        }
+                        d *= x->dbl.dbl;
+                }
+                else
+                        return error(env, "invalid arguments for *");
                 args = args->cons.cdr;
         }
-        return a;
+        if (dbl)
+                return (u_form*) new_double(d);
+        return (u_form*) new_long(l);
 }
 
 u_form * cfun_div (u_form *args, s_env *env)
@@ -1514,21 +1450,42 @@ u_form * cfun_load (u_form *args, s_env *env)
         if (!consp(args) || !stringp(args->cons.car) ||
             args->cons.cdr != nil())
                 return error(env, "invalid arguments for load");
-        return load_file(string_str(&args->cons.car->string), env);
+        return load_file(string_cstr(&args->cons.car->string), env);
+}
+
+u_form * cfun_get_internal_real_time (u_form *args, s_env *env)
+{
+        struct timespec ts;
+        if (args != nil())
+                return error(env, "invalid arguments for "
+                             "get-internal-real-time");
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (u_form*) new_long(ts.tv_sec *
+                                  INTERNAL_TIME_UNITS_PER_SECOND +
+                                  ts.tv_nsec /
+                                  (1000000000 /
+                                   INTERNAL_TIME_UNITS_PER_SECOND));
 }
 
 u_form * cfun_find_package (u_form *args, s_env *env)
 {
         u_form *f;
+        s_symbol name;
         s_package *pkg;
         if (!consp(args) || args->cons.cdr != nil())
                 return error(env, "invalid arguments for find-package");
         f = args->cons.car;
+        if (packagep(f))
+                return f;
+        name.type = FORM_SYMBOL;
+        name.package = NULL;
         if (stringp(f))
-                f = (u_form*) new_symbol(&f->string);
-        if (!symbolp(f))
+                name.string = &f->string;
+        else if (symbolp(f))
+                name.string = f->symbol.string;
+        else
                 return error(env, "invalid arguments for find-package");
-        pkg = find_package(&f->symbol, env);
+        pkg = find_package(&name, env);
         if (pkg)
                 return (u_form*) pkg;
         return nil();
@@ -1543,58 +1500,49 @@ u_form * cfun_symbol_package (u_form *args, s_env *env)
         return (u_form*) args->cons.car->symbol.package;
 }
 
+/* (find-symbol name &optional package) returns the symbol and
+   :internal, :external or :inherited, or nil and nil. */
 u_form * cfun_find_symbol (u_form *args, s_env *env)
 {
-        s_package *pkg = NULL;
+        s_package *pkg;
         s_symbol *sym;
-        (void) env;
-        if (!consp(args) || !stringp(args->cons.car))
+        u_form *status = nil();
+        if (!consp(args) || !stringp(args->cons.car) ||
+            (args->cons.cdr != nil() &&
+             (!consp(args->cons.cdr) || cddr(args) != nil())))
                 return error(env, "invalid arguments for find-symbol");
-        if (consp(args->cons.cdr)) {
-                if ((args->cons.cdr->cons.car != nil() &&
-                     !packagep(args->cons.cdr->cons.car)) ||
-                    args->cons.cdr->cons.cdr != nil())
-                        return error(env, "invalid arguments for "
-                                     "find-symbol");
-                if (args->cons.cdr->cons.car == nil())
-                        pkg = package(env);
-                else
-                        pkg = &args->cons.cdr->cons.car->package;
-        }
-        if (!pkg)
+        if (args->cons.cdr == nil() || cadr(args) == nil())
                 pkg = package(env);
-        sym = find_symbol(&args->cons.car->string, pkg);
-        if (sym)
-                return (u_form*) sym;
-        return nil();
+        else
+                pkg = package_designator(cadr(args), "find-symbol", env);
+        sym = find_symbol_status(&args->cons.car->string, pkg, &status);
+        env->values_count = 2;
+        env->values[1] = status;
+        return sym ? (u_form*) sym : nil();
 }
 
 u_form * cfun_values (u_form *args, s_env *env)
 {
-        unsigned long count;
-        s_values *v;
-        unsigned long i;
+        unsigned long count = 0;
         u_form *a = args;
-        (void) env;
-        count = length(args);
-        v = new_values(count);
-        for (i = 0; i < count; i++) {
-                values_(v)[i] = a->cons.car;
+        while (consp(a)) {
+                if (count == MULTIPLE_VALUES_LIMIT)
+                        return error(env, "too many values");
+                env->values[count++] = a->cons.car;
                 a = a->cons.cdr;
         }
-        return (u_form*) v;
+        env->values_count = count;
+        return count ? env->values[0] : nil();
 }
 
-u_form * nth_value (unsigned long n, u_form *form)
+/* The n-th value of the form that just returned primary. */
+u_form * nth_value (unsigned long n, u_form *primary, s_env *env)
 {
-        if (valuesp(form)) {
-                if (n < form->values.count)
-                        return values_(form)[n];
+        if (n >= env->values_count)
                 return nil();
-        }
         if (n == 0)
-                return form;
-        return nil();
+                return primary;
+        return env->values[n];
 }
 
 u_form * cspecial_nth_value (u_form *args, s_env *env)
@@ -1608,46 +1556,54 @@ u_form * cspecial_nth_value (u_form *args, s_env *env)
         if (!integerp(n) || n->lng.lng < 0)
                 return error(env, "invalid N argument for nth-value");
         form = eval(args->cons.cdr->cons.car, env);
-        return nth_value((unsigned long) n->lng.lng, form);
+        return nth_value((unsigned long) n->lng.lng, form, env);
 }
 
 u_form * cspecial_multiple_value_bind (u_form *args, s_env *env)
 {
         u_form *vars;
         u_form *form;
-        u_form *body;
+        u_form *r;
         unsigned long i = 0;
-        u_form *bindings;
-        if (!consp(args) || !consp(args->cons.car) ||
+        s_frame *frame = env->frame;
+        s_frame *f;
+        s_unwind_protect up;
+        if (!consp(args) || !listp(args->cons.car) ||
             !consp(args->cons.cdr))
                 return error(env, "invalid multiple-value-bind form");
-        vars = args->cons.car;
         form = eval(args->cons.cdr->cons.car, env);
-        body = args->cons.cdr->cons.cdr;
-        while (consp(vars)) {
-                u_form *value = nth_value(i++, form);
-                push(bindings, cons(vars->cons.car,
-                                    cons(cons_quote(value),
-                                         nil())));
-                vars = vars->cons.cdr;
+        f = new_frame(env->frame);
+        for (vars = args->cons.car; consp(vars); vars = vars->cons.cdr) {
+                if (!symbolp(vars->cons.car))
+                        return error(env, "invalid multiple-value-bind "
+                                     "variable");
+                frame_new_variable(&vars->cons.car->symbol,
+                                   nth_value(i++, form, env), f);
+        }
+        env->frame = f;
+        if (setjmp(up.buf)) {
+                pop_unwind_protect(env);
+                env->frame = frame;
+                longjmp(*up.jmp, 1);
         }
-        return let(bindings, body, env);
+        push_unwind_protect(&up, env);
+        r = cspecial_progn(args->cons.cdr->cons.cdr, env);
+        pop_unwind_protect(env);
+        env->frame = frame;
+        return r;
 }
 
 u_form * cspecial_multiple_value_list (u_form *args, s_env *env)
 {
         u_form *f;
         u_form *list = nil();
+        unsigned long i;
         if (!consp(args) || args->cons.cdr != nil())
                 return error(env, "invalid multiple-value-list form");
         f = eval(args->cons.car, env);
-        if (valuesp(f)) {
-                unsigned long i = f->values.count;
-                while (i--)
-                        push(list, nth_value(i, f));
-        }
-        else
-                push(list, f);
+        i = env->values_count;
+        while (i--)
+                push(list, nth_value(i, f, env));
         return list;
 }
 
@@ -1655,23 +1611,19 @@ u_form * cspecial_multiple_value_setq (u_form *args, s_env *env)
 {
         u_form *vars;
         u_form *form;
-        u_form *result = NULL;
         unsigned long i = 0;
-        if (!consp(args) || !consp(args->cons.car) ||
+        if (!consp(args) || !listp(args->cons.car) ||
             !consp(args->cons.cdr) || args->cons.cdr->cons.cdr != nil())
                 return error(env, "invalid multiple-value-setq form");
-        vars = args->cons.car;
         form = eval(args->cons.cdr->cons.car, env);
-        while (consp(vars)) {
-                u_form *value = nth_value(i++, form);
-                if (!result)
-                        result = value;
+        for (vars = args->cons.car; consp(vars); vars = vars->cons.cdr) {
                 if (!symbolp(vars->cons.car))
-                        return error(env, "invalid multiple-value-setq variable");
-                setq(&vars->cons.car->symbol, value, env);
-                vars = vars->cons.cdr;
+                        return error(env, "invalid multiple-value-setq "
+                                     "variable");
+                setq(&vars->cons.car->symbol, nth_value(i++, form, env),
+                     env);
         }
-        return result;
+        return nth_value(0, form, env);
 }
 
 int lt (u_form *a, u_form *b, s_env *env)
@@ -1686,6 +1638,7 @@ int lt (u_form *a, u_form *b, s_env *env)
                 default:
                         break;
                 }
+                break;
         case FORM_DOUBLE:
                 switch (b->type) {
                 case FORM_LONG:
@@ -1714,6 +1667,7 @@ int lte (u_form *a, u_form *b, s_env *env)
                 default:
                         break;
                 }
+                break;
         case FORM_DOUBLE:
                 switch (b->type) {
                 case FORM_LONG:
@@ -1742,6 +1696,7 @@ int gt (u_form *a, u_form *b, s_env *env)
                 default:
                         break;
                 }
+                break;
         case FORM_DOUBLE:
                 switch (b->type) {
                 case FORM_LONG:
@@ -1770,6 +1725,7 @@ int gte (u_form *a, u_form *b, s_env *env)
                 default:
                         break;
                 }
+                break;
         case FORM_DOUBLE:
                 switch (b->type) {
                 case FORM_LONG:
@@ -1799,7 +1755,7 @@ u_form * cfun_lt (u_form *args, s_env *env)
                 cmp = args->cons.car;
                 args = args->cons.cdr;
         }
-        return (u_form*) sym("t", NULL);
+        return g_sym.t;
 }
 
 u_form * cfun_lte (u_form *args, s_env *env)
@@ -1815,7 +1771,7 @@ u_form * cfun_lte (u_form *args, s_env *env)
                 cmp = args->cons.car;
                 args = args->cons.cdr;
         }
-        return (u_form*) sym("t", NULL);
+        return g_sym.t;
 }
 
 u_form * cfun_gt (u_form *args, s_env *env)
@@ -1831,7 +1787,7 @@ u_form * cfun_gt (u_form *args, s_env *env)
                 cmp = args->cons.car;
                 args = args->cons.cdr;
         }
-        return (u_form*) sym("t", NULL);
+        return g_sym.t;
 }
 
 u_form * cfun_gte (u_form *args, s_env *env)
@@ -1847,5 +1803,65 @@ u_form * cfun_gte (u_form *args, s_env *env)
                 cmp = args->cons.car;
                 args = args->cons.cdr;
         }
-        return (u_form*) sym("t", NULL);
+        return g_sym.t;
+}
+
+int num_eq (u_form *a, u_form *b, s_env *env)
+{
+        if (integerp(a) && integerp(b))
+                return a->lng.lng == b->lng.lng;
+        if (integerp(a) && floatp(b))
+                return a->lng.lng == b->dbl.dbl;
+        if (floatp(a) && integerp(b))
+                return a->dbl.dbl == b->lng.lng;
+        if (floatp(a) && floatp(b))
+                return a->dbl.dbl == b->dbl.dbl;
+        error(env, "invalid arguments for =");
+        return 0;
+}
+
+u_form * cfun_num_eq (u_form *args, s_env *env)
+{
+        u_form *cmp;
+        int result = 1;
+        if (!consp(args) || !numberp(args->cons.car))
+                return error(env, "invalid arguments for =");
+        cmp = args->cons.car;
+        args = args->cons.cdr;
+        while (consp(args)) {
+                if (!num_eq(cmp, args->cons.car, env))
+                        result = 0;
+                args = args->cons.cdr;
+        }
+        return result ? g_sym.t : nil();
+}
+
+u_form * cfun_min (u_form *args, s_env *env)
+{
+        u_form *m;
+        if (!consp(args) || !numberp(args->cons.car))
+                return error(env, "invalid arguments for min");
+        m = args->cons.car;
+        args = args->cons.cdr;
+        while (consp(args)) {
+                if (lt(args->cons.car, m, env))
+                        m = args->cons.car;
+                args = args->cons.cdr;
+        }
+        return m;
+}
+
+u_form * cfun_max (u_form *args, s_env *env)
+{
+        u_form *m;
+        if (!consp(args) || !numberp(args->cons.car))
+                return error(env, "invalid arguments for max");
+        m = args->cons.car;
+        args = args->cons.cdr;
+        while (consp(args)) {
+                if (gt(args->cons.car, m, env))
+                        m = args->cons.car;
+                args = args->cons.cdr;
+        }
+        return m;
 }
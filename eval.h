@@ -4,6 +4,8 @@
 #include "env.h"
 #include "form.h"
 
+#define INTERNAL_TIME_UNITS_PER_SECOND 1000000
+
 u_form * cons_quote (u_form *form);
 u_form * atom (u_form *form);
 u_form * eq (u_form *a, u_form *b);
@@ -24,7 +26,6 @@ u_form * last (u_form *list);
 long length (u_form *list);
 u_form * reverse (u_form *list);
 u_form * getf (u_form *list, u_form *indicator, u_form *def);
-u_form * sort (u_form *list, s_env *env);
 
 u_form * cons_function (u_form *form);
 u_form * cons_backquote (u_form *form);
@@ -86,7 +87,6 @@ u_form * cfun_nconc (u_form *args, s_env *env);
 u_form * cfun_notany (u_form *args, s_env *env);
 u_form * cfun_every (u_form *args, s_env *env);
 u_form * cfun_mapcar (u_form *args, s_env *env);
-u_form * cfun_sort (u_form *args, s_env *env);
 
 u_form * cspecial_let (u_form *args, s_env *env);
 u_form * cspecial_let_star (u_form *args, s_env *env);
@@ -123,7 +123,9 @@ u_form * cfun_print (u_form *args, s_env *env);
 
 u_form * eval (u_form *form, s_env *env);
 u_form * apply (u_form *fun, u_form *args, s_env *env);
+u_form * funcall_cfun (u_form *fun, u_form *args, s_env *env);
 u_form * funcall (u_form *fun, u_form *args, s_env *env);
+u_form * function_designator (u_form *fun, s_env *env);
 
 u_form * cfun_plus (u_form *args, s_env *env);
 u_form * cfun_minus (u_form *args, s_env *env);
@@ -131,6 +133,7 @@ u_form * cfun_mul (u_form *args, s_env *env);
 u_form * cfun_div (u_form *args, s_env *env);
 
 u_form * cfun_load (u_form *args, s_env *env);
+u_form * cfun_get_internal_real_time (u_form *args, s_env *env);
 
 u_form * cfun_find_package (u_form *args, s_env *env);
 u_form * cfun_symbol_package (u_form *args, s_env *env);
@@ -142,9 +145,17 @@ u_form * cspecial_multiple_value_bind (u_form *args, s_env *env);
 u_form * cspecial_multiple_value_list (u_form *args, s_env *env);
 u_form * cspecial_multiple_value_setq (u_form *args, s_env *env);
 
+int lt (u_form *a, u_form *b, s_env *env);
+int lte (u_form *a, u_form *b, s_env *env);
+int gt (u_form *a, u_form *b, s_env *env);
+int gte (u_form *a, u_form *b, s_env *env);
 u_form * cfun_lt (u_form *args, s_env *env);
 u_form * cfun_lte (u_form *args, s_env *env);
 u_form * cfun_gt (u_form *args, s_env *env);
 u_form * cfun_gte (u_form *args, s_env *env);
+int num_eq (u_form *a, u_form *b, s_env *env);
+u_form * cfun_num_eq (u_form *args, s_env *env);
+u_form * cfun_min (u_form *args, s_env *env);
+u_form * cfun_max (u_form *args, s_env *env);
 
 #endif
@@ -0,0 +1,971 @@
+#define _POSIX_C_SOURCE 200809L
+#include "config.h"
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_MMAP
+#define __USE_MISC 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "alloc.h"
+#include "compare.h"
+#include "env.h"
+#include "error.h"
+#include "eval.h"
+#include "fasl.h"
+#include "frame.h"
+#include "hashtable.h"
+#include "package.h"
+#include "symbols.h"
+#include "unwind_protect.h"
+
+typedef enum fasl_tag {
+        FASL_CONS = 1,
+        FASL_STRING,
+        FASL_SYMBOL,
+        FASL_PACKAGE,
+        FASL_CFUN,
+        FASL_LAMBDA,
+        FASL_LONG,
+        FASL_DOUBLE,
+        FASL_SKIPLIST,
+        FASL_FRAME,
+        FASL_HASHTABLE,
+        FASL_VECTOR,
+        FASL_CHARACTER,
+        FASL_EXTERNAL_SYMBOL,
+        FASL_SYNCHRONIZED_HASHTABLE
+} e_fasl_tag;
+
+/* Reference to a NULL pointer and to the global frame. */
+#define FASL_NONE   0xffffffffUL
+#define FASL_GLOBAL 0xfffffffeUL
+#define FASL_MAX    0xfffffff0UL
+
+/* Identity map from pointers to indices, with open addressing. */
+typedef struct fasl_map {
+        const void **keys;
+        uint32_t *values;
+        unsigned long size;
+        unsigned long count;
+} s_fasl_map;
+
+static unsigned long fasl_map_slot (s_fasl_map *m, const void *key)
+{
+        unsigned long i = ((uintptr_t) key >> 4) * 0x9E3779B97F4A7C15ULL;
+        i &= m->size - 1;
+        while (m->keys[i] && m->keys[i] != key)
+                i = (i + 1) & (m->size - 1);
+        return i;
+}
+
+static void fasl_map_resize (s_fasl_map *m, unsigned long size)
+{
+        const void **keys = m->keys;
+        uint32_t *values = m->values;
+        unsigned long old = m->size;
+        unsigned long i;
+        m->keys = calloc(size, sizeof(void*));
+        m->values = malloc(size * sizeof(uint32_t));
+        assert(m->keys && m->values);
+        m->size = size;
+        for (i = 0; i < old; i++)
+                if (keys[i]) {
+                        unsigned long j = fasl_map_slot(m, keys[i]);
+                        m->keys[j] = keys[i];
+                        m->values[j] = values[i];
+                }
+        free(keys);
+        free(values);
+}
+
+/* Returns the index of key, or stores value for it and returns
+   FASL_NONE. */
+static uint32_t fasl_map_get (s_fasl_map *m, const void *key,
+                              uint32_t value)
+{
+        unsigned long i;
+        if (2 * (m->count + 1) > m->size)
+                fasl_map_resize(m, m->size ? m->size * 2 : 1024);
+        i = fasl_map_slot(m, key);
+        if (m->keys[i])
+                return m->values[i];
+        m->keys[i] = key;
+        m->values[i] = value;
+        m->count++;
+        return FASL_NONE;
+}
+
+static void fasl_map_free (s_fasl_map *m)
+{
+        free(m->keys);
+        free(m->values);
+}
+
+typedef struct fasl_writer {
+        FILE *fp;
+        s_env *env;
+        u_form **objects;
+        unsigned long count;
+        unsigned long size;
+        s_fasl_map object_map;
+        s_string **strings;
+        unsigned long string_count;
+        unsigned long string_size;
+        s_fasl_map string_map;
+} s_fasl_writer;
+
+static uint32_t fasl_string (s_fasl_writer *w, s_string *s)
+{
+        uint32_t i = fasl_map_get(&w->string_map, s, w->string_count);
+        if (i != FASL_NONE)
+                return i;
+        if (w->string_count == w->string_size) {
+                w->string_size = w->string_size ? w->string_size * 2 :
+                        256;
+                w->strings = realloc(w->strings, w->string_size *
+                                     sizeof(s_string*));
+                assert(w->strings);
+        }
+        w->strings[w->string_count] = s;
+        return w->string_count++;
+}
+
+/* Returns the index of x, queuing it for writing the first time. */
+static uint32_t fasl_ref (s_fasl_writer *w, const void *x)
+{
+        uint32_t i;
+        if (!x)
+                return FASL_NONE;
+        if (x == w->env->global_frame)
+                return FASL_GLOBAL;
+        if ((i = fasl_map_get(&w->object_map, x, w->count)) != FASL_NONE)
+                return i;
+        if (w->count == FASL_MAX)
+                error(w->env, "save-fasl: too many objects");
+        if (w->count == w->size) {
+                w->size = w->size ? w->size * 2 : 1024;
+                w->objects = realloc(w->objects,
+                                     w->size * sizeof(u_form*));
+                assert(w->objects);
+        }
+        w->objects[w->count] = (u_form*) x;
+        return w->count++;
+}
+
+static void write_u8 (s_fasl_writer *w, unsigned char x)
+{
+        fputc(x, w->fp);
+}
+
+static void write_u32 (s_fasl_writer *w, uint32_t x)
+{
+        unsigned char b[4];
+        b[0] = x;
+        b[1] = x >> 8;
+        b[2] = x >> 16;
+        b[3] = x >> 24;
+        fwrite(b, 4, 1, w->fp);
+}
+
+static void write_u64 (s_fasl_writer *w, uint64_t x)
+{
+        write_u32(w, x);
+        write_u32(w, x >> 32);
+}
+
+static void write_double (s_fasl_writer *w, double d)
+{
+        uint64_t x;
+        memcpy(&x, &d, sizeof(x));
+        write_u64(w, x);
+}
+
+static void write_ref (s_fasl_writer *w, const void *x)
+{
+        write_u32(w, fasl_ref(w, x));
+}
+
+static void write_bindings (s_fasl_writer *w, s_skiplist *sl)
+{
+        s_skiplist_node *n;
+        write_u64(w, sl ? sl->length : 0);
+        if (!sl)
+                return;
+        for (n = skiplist_node_next(sl->head, 0); n;
+             n = skiplist_node_next(n, 0)) {
+                s_cons *binding = n->value;
+                write_ref(w, binding->car);
+                write_ref(w, binding->cdr);
+        }
+}
+
+/* Writes the record of object i. References to objects not seen yet
+   append them to the table, so this runs until the table is
+   exhausted without recursing. */
+static void write_object (s_fasl_writer *w, u_form *x)
+{
+        unsigned long i;
+        switch (x->type) {
+        case FORM_CONS:
+                write_u8(w, FASL_CONS);
+                write_ref(w, x->cons.car);
+                write_ref(w, x->cons.cdr);
+                return;
+        case FORM_STRING:
+                write_u8(w, FASL_STRING);
+                write_u64(w, x->string.length);
+                fwrite(string_str(&x->string), 1, x->string.length,
+                       w->fp);
+                return;
+        case FORM_SYMBOL:
+                write_u8(w, x->symbol.package &&
+                         symbol_external_p(&x->symbol, x->symbol.package) ?
+                         FASL_EXTERNAL_SYMBOL : FASL_SYMBOL);
+                write_u32(w, x->symbol.package ?
+                          fasl_string(w, x->symbol.package->name->string) :
+                          FASL_NONE);
+                write_u32(w, fasl_string(w, x->symbol.string));
+                return;
+        case FORM_PACKAGE:
+                write_u8(w, FASL_PACKAGE);
+                write_u32(w, fasl_string(w, x->package.name->string));
+                return;
+        case FORM_CFUN:
+                write_u8(w, FASL_CFUN);
+                write_ref(w, x->cfun.name);
+                return;
+        case FORM_LAMBDA:
+                write_u8(w, FASL_LAMBDA);
+                write_ref(w, x->lambda.lambda_type);
+                write_ref(w, x->lambda.name);
+                write_ref(w, x->lambda.lambda_list);
+                write_ref(w, x->lambda.body);
+                write_ref(w, x->lambda.frame);
+                return;
+        case FORM_LONG:
+                write_u8(w, FASL_LONG);
+                write_u64(w, x->lng.lng);
+                return;
+        case FORM_DOUBLE:
+                write_u8(w, FASL_DOUBLE);
+                write_double(w, x->dbl.dbl);
+                return;
+        case FORM_CHARACTER:
+                write_u8(w, FASL_CHARACTER);
+                write_u32(w, x->character.code);
+                return;
+        case FORM_SKIPLIST: {
+                s_skiplist_node *n;
+                write_u8(w, FASL_SKIPLIST);
+                write_u64(w, x->skiplist.length);
+                for (n = skiplist_node_next(x->skiplist.head, 0); n;
+                     n = skiplist_node_next(n, 0))
+                        write_ref(w, n->value);
+                return;
+        }
+        case FORM_FRAME:
+                write_u8(w, FASL_FRAME);
+                write_ref(w, x->frame.parent);
+                write_bindings(w, x->frame.variables);
+                write_bindings(w, x->frame.functions);
+                write_bindings(w, x->frame.macros);
+                return;
+        case FORM_HASHTABLE: {
+                s_hashtable *h = &x->hashtable;
+                write_u8(w, h->array ? FASL_SYNCHRONIZED_HASHTABLE :
+                         FASL_HASHTABLE);
+                write_u64(w, h->size);
+                write_u64(w, h->rehash_size_long);
+                write_double(w, h->rehash_size_double);
+                write_double(w, h->rehash_threshold);
+                write_u64(w, h->count);
+                for (i = 0; i < (unsigned long) h->size; i++) {
+                        u_form *b;
+                        for (b = h->buckets[i]; consp(b);
+                             b = b->cons.cdr) {
+                                write_ref(w, caar(b));
+                                write_ref(w, cdar(b));
+                        }
+                }
+                return;
+        }
+        case FORM_VECTOR: {
+                s_vector *v = &x->vector;
+                write_u8(w, FASL_VECTOR);
+                write_u8(w, v->element_type);
+                write_u64(w, v->length);
+                switch (v->element_type) {
+                case VECTOR_T:
+                        for (i = 0; i < v->length; i++)
+                                write_ref(w, vector_t(v)[i]);
+                        return;
+                case VECTOR_U8:
+                        fwrite(vector_u8(v), 1, v->length, w->fp);
+                        return;
+                case VECTOR_FIXNUM:
+                        for (i = 0; i < v->length; i++)
+                                write_u64(w, vector_fixnum(v)[i]);
+                        return;
+                case VECTOR_DOUBLE:
+                        for (i = 0; i < v->length; i++)
+                                write_double(w, vector_double(v)[i]);
+                        return;
+                }
+                return;
+        }
+        default:
+                break;
+        }
+        error(w->env, "save-fasl: cannot save object of type %d",
+              x->type);
+}
+
+/* Objects are numbered breadth first from the roots. Strings only
+   become known while writing objects, so the object records are
+   written to a temporary file and appended after the string
+   table. */
+int fasl_write (FILE *fp, u_form *roots, s_env *env)
+{
+        s_fasl_writer w;
+        s_unwind_protect up;
+        FILE *tmp;
+        u_form *r;
+        unsigned long i;
+        long nroots = length(roots);
+        char buf[BUFSIZ];
+        size_t n;
+        memset(&w, 0, sizeof(w));
+        w.env = env;
+        if (!(tmp = tmpfile()))
+                error(env, "save-fasl: %s", strerror(errno));
+        w.fp = tmp;
+        if (setjmp(up.buf)) {
+                pop_unwind_protect(env);
+                fclose(tmp);
+                fasl_map_free(&w.object_map);
+                fasl_map_free(&w.string_map);
+                free(w.objects);
+                free(w.strings);
+                longjmp(*up.jmp, 1);
+        }
+        push_unwind_protect(&up, env);
+        for (r = roots; consp(r); r = r->cons.cdr)
+                fasl_ref(&w, r->cons.car);
+        for (i = 0; i < w.count; i++)
+                write_object(&w, w.objects[i]);
+        w.fp = fp;
+        fwrite(FASL_MAGIC, 1, strlen(FASL_MAGIC), fp);
+        write_u32(&w, FASL_VERSION);
+        write_u32(&w, w.string_count);
+        write_u32(&w, w.count);
+        write_u32(&w, nroots);
+        for (i = 0; i < w.string_count; i++) {
+                write_u32(&w, w.strings[i]->length);
+                fwrite(string_str(w.strings[i]), 1,
+                       w.strings[i]->length, fp);
+        }
+        rewind(tmp);
+        while ((n = fread(buf, 1, sizeof(buf), tmp)) > 0)
+                fwrite(buf, 1, n, fp);
+        for (r = roots; consp(r); r = r->cons.cdr)
+                write_ref(&w, r->cons.car);
+        pop_unwind_protect(env);
+        fclose(tmp);
+        fasl_map_free(&w.object_map);
+        fasl_map_free(&w.string_map);
+        free(w.objects);
+        free(w.strings);
+        return ferror(fp) ? -1 : 0;
+}
+
+typedef struct fasl_reader {
+        const unsigned char *p;
+        const unsigned char *end;
+        s_env *env;
+        const unsigned char **strings;
+        uint32_t *string_lengths;
+        unsigned long string_count;
+        u_form **objects;
+        const unsigned char **records;
+        unsigned long count;
+} s_fasl_reader;
+
+static void fasl_corrupt (s_fasl_reader *r)
+{
+        error(r->env, "load-fasl: corrupt file");
+}
+
+static const unsigned char * read_bytes (s_fasl_reader *r,
+                                         unsigned long n)
+{
+        const unsigned char *p = r->p;
+        if ((unsigned long) (r->end - r->p) < n)
+                fasl_corrupt(r);
+        r->p += n;
+        return p;
+}
+
+static unsigned char read_u8 (s_fasl_reader *r)
+{
+        return *read_bytes(r, 1);
+}
+
+static uint32_t read_u32 (s_fasl_reader *r)
+{
+        const unsigned char *b = read_bytes(r, 4);
+        return (uint32_t) b[0] | (uint32_t) b[1] << 8 |
+                (uint32_t) b[2] << 16 | (uint32_t) b[3] << 24;
+}
+
+static uint64_t read_u64 (s_fasl_reader *r)
+{
+        uint64_t lo = read_u32(r);
+        return lo | (uint64_t) read_u32(r) << 32;
+}
+
+static double read_double (s_fasl_reader *r)
+{
+        uint64_t x = read_u64(r);
+        double d;
+        memcpy(&d, &x, sizeof(d));
+        return d;
+}
+
+static u_form * read_ref (s_fasl_reader *r)
+{
+        uint32_t i = read_u32(r);
+        if (i == FASL_NONE)
+                return NULL;
+        if (i == FASL_GLOBAL)
+                return (u_form*) r->env->global_frame;
+        if (i >= r->count)
+                fasl_corrupt(r);
+        return r->objects[i];
+}
+
+static s_symbol * read_symbol_ref (s_fasl_reader *r)
+{
+        u_form *x = read_ref(r);
+        if (!symbolp(x))
+                fasl_corrupt(r);
+        return &x->symbol;
+}
+
+static const unsigned char * read_name (s_fasl_reader *r,
+                                        unsigned long *len)
+{
+        uint32_t i = read_u32(r);
+        if (i == FASL_NONE)
+                return NULL;
+        if (i >= r->string_count)
+                fasl_corrupt(r);
+        *len = r->string_lengths[i];
+        return r->strings[i];
+}
+
+static s_package * fasl_package (s_fasl_reader *r,
+                                 const unsigned char *name,
+                                 unsigned long len)
+{
+        s_symbol *name_sym = new_symbol(new_string(len, (const char*)
+                                                   name));
+        s_package *pkg = find_package(name_sym, r->env);
+        if (!pkg)
+                error(r->env, "load-fasl: no package named %s",
+                      string_str(name_sym->string));
+        return pkg;
+}
+
+/* Skips n fields of the given width. */
+static void skip (s_fasl_reader *r, uint64_t n, unsigned width)
+{
+        if (n > (uint64_t) (r->end - r->p) / width)
+                fasl_corrupt(r);
+        r->p += n * width;
+}
+
+/* Allocates object i from its record and skips its references. */
+static u_form * read_object (s_fasl_reader *r)
+{
+        unsigned char tag = read_u8(r);
+        uint64_t i, n;
+        unsigned long len;
+        const unsigned char *name;
+        u_form *x;
+        switch (tag) {
+        case FASL_CONS:
+                read_bytes(r, 8);
+                return (u_form*) new_cons(NULL, NULL);
+        case FASL_STRING:
+                n = read_u64(r);
+                return (u_form*) new_string(n, (const char*)
+                                            read_bytes(r, n));
+        case FASL_SYMBOL:
+        case FASL_EXTERNAL_SYMBOL: {
+                const unsigned char *pkg_name = read_name(r, &len);
+                s_package *pkg = pkg_name ?
+                        fasl_package(r, pkg_name, len) : NULL;
+                if (!(name = read_name(r, &len)))
+                        fasl_corrupt(r);
+                if (pkg) {
+                        x = (u_form*) intern_slice((const char*) name,
+                                                   len, pkg);
+                        if (tag == FASL_EXTERNAL_SYMBOL)
+                                export_symbol(&x->symbol, pkg, r->env);
+                        return x;
+                }
+                return (u_form*) new_symbol(new_string(len, (const char*)
+                                                       name));
+        }
+        case FASL_PACKAGE:
+                if (!(name = read_name(r, &len)))
+                        fasl_corrupt(r);
+                return (u_form*) fasl_package(r, name, len);
+        case FASL_CFUN:
+                read_bytes(r, 4);
+                return NULL;
+        case FASL_LAMBDA: {
+                s_lambda *l;
+                read_bytes(r, 20);
+                l = alloc(sizeof(s_lambda));
+                assert(l);
+                alloc_track(FORM_LAMBDA, sizeof(s_lambda));
+                l->type = FORM_LAMBDA;
+                l->stats = NULL;
+                return (u_form*) l;
+        }
+        case FASL_LONG:
+                return (u_form*) new_long((long) read_u64(r));
+        case FASL_DOUBLE:
+                return (u_form*) new_double(read_double(r));
+        case FASL_CHARACTER:
+                return (u_form*) new_character(read_u32(r));
+        case FASL_SKIPLIST: {
+                s_skiplist *sl = new_skiplist(5, 4);
+                sl->compare = compare_equal;
+                skip(r, read_u64(r), 4);
+                return (u_form*) sl;
+        }
+        case FASL_FRAME:
+                read_bytes(r, 4);
+                skip(r, read_u64(r), 8);
+                skip(r, read_u64(r), 8);
+                skip(r, read_u64(r), 8);
+                return (u_form*) new_frame(NULL);
+        case FASL_HASHTABLE:
+        case FASL_SYNCHRONIZED_HASHTABLE: {
+                long size = read_u64(r);
+                long rehash_size_long = read_u64(r);
+                double rehash_size_double = read_double(r);
+                double rehash_threshold = read_double(r);
+                s_hashtable *h;
+                if (size < 1)
+                        fasl_corrupt(r);
+                skip(r, read_u64(r), 8);
+                h = new_hashtable(size, rehash_size_long,
+                                  rehash_size_double, rehash_threshold);
+                if (tag == FASL_SYNCHRONIZED_HASHTABLE &&
+                    hashtable_synchronize(h))
+                        fasl_corrupt(r);
+                return (u_form*) h;
+        }
+        case FASL_VECTOR: {
+                unsigned char et = read_u8(r);
+                s_vector *v;
+                if (et > VECTOR_DOUBLE)
+                        fasl_corrupt(r);
+                n = read_u64(r);
+                if (n > (uint64_t) (r->end - r->p))
+                        fasl_corrupt(r);
+                v = new_vector(et, n);
+                switch (et) {
+                case VECTOR_T:
+                        skip(r, n, 4);
+                        break;
+                case VECTOR_U8:
+                        memcpy(vector_u8(v), read_bytes(r, n), n);
+                        break;
+                case VECTOR_FIXNUM:
+                        for (i = 0; i < n; i++)
+                                vector_fixnum(v)[i] = (long) read_u64(r);
+                        break;
+                case VECTOR_DOUBLE:
+                        for (i = 0; i < n; i++)
+                                vector_double(v)[i] = read_double(r);
+                        break;
+                }
+                return (u_form*) v;
+        }
+        }
+        fasl_corrupt(r);
+        return NULL;
+}
+
+static void read_bindings (s_fasl_reader *r, s_frame *f,
+                           void (*bind) (s_symbol*, u_form*, s_frame*))
+{
+        uint64_t n = read_u64(r);
+        while (n--) {
+                s_symbol *sym = read_symbol_ref(r);
+                bind(sym, read_ref(r), f);
+        }
+}
+
+static void bind_macro (s_symbol *sym, u_form *value, s_frame *f)
+{
+        frame_new_macro(sym, &value->lambda, f);
+}
+
+/* Second pass over record i : replaces indices with pointers. */
+static void relocate_object (s_fasl_reader *r, u_form *x)
+{
+        unsigned char tag = read_u8(r);
+        uint64_t n;
+        unsigned long i;
+        switch (tag) {
+        case FASL_CONS:
+                x->cons.car = read_ref(r);
+                x->cons.cdr = read_ref(r);
+                return;
+        case FASL_LAMBDA:
+                x->lambda.lambda_type = read_symbol_ref(r);
+                x->lambda.name = read_symbol_ref(r);
+                x->lambda.lambda_list = read_ref(r);
+                x->lambda.body = read_ref(r);
+                x->lambda.frame = (s_frame*) read_ref(r);
+                return;
+        case FASL_FRAME:
+                x->frame.parent = (s_frame*) read_ref(r);
+                read_bindings(r, &x->frame, frame_new_variable);
+                read_bindings(r, &x->frame, frame_new_function);
+                read_bindings(r, &x->frame, bind_macro);
+                return;
+        case FASL_VECTOR:
+                read_u8(r);
+                n = read_u64(r);
+                if (x->vector.element_type == VECTOR_T)
+                        for (i = 0; i < n; i++)
+                                vector_t(&x->vector)[i] = read_ref(r);
+                return;
+        }
+}
+
+/* Third pass : fills containers whose layout depends on the hash or
+   order of their now complete contents. */
+static void fill_object (s_fasl_reader *r, u_form *x)
+{
+        unsigned char tag = read_u8(r);
+        uint64_t n;
+        switch (tag) {
+        case FASL_SKIPLIST:
+                n = read_u64(r);
+                while (n--)
+                        skiplist_insert(&x->skiplist, read_ref(r));
+                return;
+        case FASL_HASHTABLE:
+        case FASL_SYNCHRONIZED_HASHTABLE:
+                read_bytes(r, 32);
+                n = read_u64(r);
+                while (n--) {
+                        u_form *k = read_ref(r);
+                        sethash(&x->hashtable, k, read_ref(r));
+                }
+                return;
+        }
+}
+
+static u_form * read_roots (s_fasl_reader *r, unsigned long n)
+{
+        u_form *roots = nil();
+        u_form **tail = &roots;
+        while (n--) {
+                *tail = (u_form*) new_cons(read_ref(r), nil());
+                tail = &(*tail)->cons.cdr;
+        }
+        return roots;
+}
+
+u_form * fasl_read (const unsigned char *buf, unsigned long size,
+                    s_env *env)
+{
+        s_fasl_reader r;
+        s_unwind_protect up;
+        unsigned long i;
+        unsigned long nroots;
+        u_form *roots;
+        memset(&r, 0, sizeof(r));
+        r.p = buf;
+        r.end = buf + size;
+        r.env = env;
+        if (size < strlen(FASL_MAGIC) ||
+            memcmp(buf, FASL_MAGIC, strlen(FASL_MAGIC)))
+                error(env, "load-fasl: not a fasl file");
+        r.p += strlen(FASL_MAGIC);
+        if (read_u32(&r) != FASL_VERSION)
+                error(env, "load-fasl: unsupported version");
+        r.string_count = read_u32(&r);
+        r.count = read_u32(&r);
+        nroots = read_u32(&r);
+        if (r.string_count > size || r.count > size)
+                fasl_corrupt(&r);
+        r.strings = malloc(r.string_count * sizeof(char*) + 1);
+        r.string_lengths = malloc(r.string_count * sizeof(uint32_t) + 1);
+        r.objects = malloc(r.count * sizeof(u_form*) + 1);
+        r.records = malloc(r.count * sizeof(char*) + 1);
+        assert(r.strings && r.string_lengths && r.objects && r.records);
+        if (setjmp(up.buf)) {
+                pop_unwind_protect(env);
+                free(r.strings);
+                free(r.string_lengths);
+                free(r.objects);
+                free(r.records);
+                longjmp(*up.jmp, 1);
+        }
+        push_unwind_protect(&up, env);
+        for (i = 0; i < r.string_count; i++) {
+                r.string_lengths[i] = read_u32(&r);
+                r.strings[i] = read_bytes(&r, r.string_lengths[i]);
+        }
+        for (i = 0; i < r.count; i++) {
+                r.records[i] = r.p;
+                r.objects[i] = read_object(&r);
+        }
+        for (i = 0; i < r.count; i++)
+                if (!r.objects[i]) {
+                        const unsigned char *p = r.p;
+                        s_symbol *name;
+                        u_form **f;
+                        r.p = r.records[i] + 1;
+                        name = read_symbol_ref(&r);
+                        f = frame_function(name, env->global_frame);
+                        if (!f)
+                                f = symbol_special(name, env);
+                        if (!f || (*f)->type != FORM_CFUN)
+                                error(env, "load-fasl: no cfun %s",
+                                      string_str(name->string));
+                        r.objects[i] = *f;
+                        r.p = p;
+                }
+        for (i = 0; i < r.count; i++) {
+                const unsigned char *p = r.p;
+                r.p = r.records[i];
+                relocate_object(&r, r.objects[i]);
+                r.p = p;
+        }
+        for (i = 0; i < r.count; i++) {
+                const unsigned char *p = r.p;
+                r.p = r.records[i];
+                fill_object(&r, r.objects[i]);
+                r.p = p;
+        }
+        roots = read_roots(&r, nroots);
+        pop_unwind_protect(env);
+        free(r.strings);
+        free(r.string_lengths);
+        free(r.objects);
+        free(r.records);
+        return roots;
+}
+
+u_form * save_fasl (const char *path, u_form *roots, s_env *env)
+{
+        FILE *fp = fopen(path, "wb");
+        s_unwind_protect up;
+        int r;
+        if (!fp)
+                return error(env, "save-fasl: %s: %s", path,
+                             strerror(errno));
+        if (setjmp(up.buf)) {
+                pop_unwind_protect(env);
+                fclose(fp);
+                remove(path);
+                longjmp(*up.jmp, 1);
+        }
+        push_unwind_protect(&up, env);
+        r = fasl_write(fp, roots, env);
+        pop_unwind_protect(env);
+        if (fclose(fp) || r)
+                return error(env, "save-fasl: %s: %s", path,
+                             strerror(errno));
+        return g_sym.t;
+}
+
+#ifdef HAVE_MMAP
+static u_form * read_fasl_map (int fd, s_env *env)
+{
+        struct stat st;
+        void *map;
+        u_form *roots;
+        s_unwind_protect up;
+        if (fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size <= 0)
+                return NULL;
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+                return NULL;
+        posix_madvise(map, st.st_size, POSIX_MADV_WILLNEED);
+        if (setjmp(up.buf)) {
+                pop_unwind_protect(env);
+                munmap(map, st.st_size);
+                longjmp(*up.jmp, 1);
+        }
+        push_unwind_protect(&up, env);
+        roots = fasl_read(map, st.st_size, env);
+        pop_unwind_protect(env);
+        munmap(map, st.st_size);
+        return roots;
+}
+#endif
+
+/* Returns the list of root forms stored in path. */
+u_form * read_fasl (const char *path, s_env *env)
+{
+        FILE *fp;
+        unsigned char *buf;
+        long size;
+        u_form *roots;
+        s_unwind_protect up;
+#ifdef HAVE_MMAP
+        int fd = open(path, O_RDONLY);
+        if (fd >= 0) {
+                if (setjmp(up.buf)) {
+                        pop_unwind_protect(env);
+                        close(fd);
+                        longjmp(*up.jmp, 1);
+                }
+                push_unwind_protect(&up, env);
+                roots = read_fasl_map(fd, env);
+                pop_unwind_protect(env);
+                close(fd);
+                if (roots)
+                        return roots;
+        }
+#endif
+        if (!(fp = fopen(path, "rb")))
+                return error(env, "load-fasl: %s: %s", path,
+                             strerror(errno));
+        if (fseek(fp, 0, SEEK_END) || (size = ftell(fp)) < 0 ||
+            fseek(fp, 0, SEEK_SET)) {
+                fclose(fp);
+                return error(env, "load-fasl: %s: %s", path,
+                             strerror(errno));
+        }
+        buf = malloc(size + 1);
+        assert(buf);
+        if (fread(buf, 1, size, fp) != (size_t) size) {
+                fclose(fp);
+                free(buf);
+                return error(env, "load-fasl: %s: read error", path);
+        }
+        fclose(fp);
+        if (setjmp(up.buf)) {
+                pop_unwind_protect(env);
+                free(buf);
+                longjmp(*up.jmp, 1);
+        }
+        push_unwind_protect(&up, env);
+        roots = fasl_read(buf, size, env);
+        pop_unwind_protect(env);
+        free(buf);
+        return roots;
+}
+
+/* Evaluates the root forms in order, as load does with source. */
+u_form * load_fasl (const char *path, s_env *env)
+{
+        u_form *roots = read_fasl(path, env);
+        while (consp(roots)) {
+                eval(roots->cons.car, env);
+                roots = roots->cons.cdr;
+        }
+        return g_sym.t;
+}
+
+static u_form * bindings_list (s_skiplist *sl)
+{
+        u_form *l = nil();
+        s_skiplist_node *n;
+        if (sl)
+                for (n = skiplist_node_next(sl->head, 0); n;
+                     n = skiplist_node_next(n, 0))
+                        push(l, n->value);
+        return l;
+}
+
+/* A core is a fasl of the variable, function and macro bindings of
+   the global frame. */
+u_form * save_core (const char *path, s_env *env)
+{
+        s_frame *g = env->global_frame;
+        u_form *roots = nil();
+        push(roots, bindings_list(g->macros));
+        push(roots, bindings_list(g->functions));
+        push(roots, bindings_list(g->variables));
+        return save_fasl(path, roots, env);
+}
+
+static void install_bindings (u_form *l, u_form ** (*find)
+                              (s_symbol*, s_frame*),
+                              void (*bind) (s_symbol*, u_form*, s_frame*),
+                              s_env *env)
+{
+        for (; consp(l); l = l->cons.cdr) {
+                u_form *b = l->cons.car;
+                u_form **f;
+                if (!consp(b) || !symbolp(b->cons.car))
+                        error(env, "load-core: corrupt core");
+                f = find(&b->cons.car->symbol, env->global_frame);
+                if (f)
+                        *f = b->cons.cdr;
+                else
+                        bind(&b->cons.car->symbol, b->cons.cdr,
+                             env->global_frame);
+        }
+}
+
+/* Restores the global bindings saved by save_core over those of a
+   fresh environment. */
+u_form * load_core (const char *path, s_env *env)
+{
+        u_form *roots = read_fasl(path, env);
+        if (!consp(roots) || !consp(roots->cons.cdr) ||
+            !consp(cddr(roots)) || cdr(cddr(roots)) != nil())
+                return error(env, "load-core: %s: not a core", path);
+        install_bindings(roots->cons.car, frame_variable,
+                         frame_new_variable, env);
+        install_bindings(cadr(roots), frame_function,
+                         frame_new_function, env);
+        install_bindings(caddr(roots), frame_macro, bind_macro, env);
+        return g_sym.t;
+}
+
+u_form * cfun_save_fasl (u_form *args, s_env *env)
+{
+        if (!consp(args) || !stringp(args->cons.car) ||
+            !consp(args->cons.cdr) || !listp(args->cons.cdr->cons.car) ||
+            args->cons.cdr->cons.cdr != nil())
+                return error(env, "invalid arguments for save-fasl");
+        return save_fasl(string_cstr(&args->cons.car->string),
+                         args->cons.cdr->cons.car, env);
+}
+
+u_form * cfun_load_fasl (u_form *args, s_env *env)
+{
+        if (!consp(args) || !stringp(args->cons.car) ||
+            args->cons.cdr != nil())
+                return error(env, "invalid arguments for load-fasl");
+        return load_fasl(string_cstr(&args->cons.car->string), env);
+}
+
+u_form * cfun_save_core (u_form *args, s_env *env)
+{
+        if (!consp(args) || !stringp(args->cons.car) ||
+            args->cons.cdr != nil())
+                return error(env, "invalid arguments for save-core");
+        return save_core(string_cstr(&args->cons.car->string), env);
+}
@@ -0,0 +1,35 @@
+#ifndef FASL_H
+#define FASL_H
+
+#include <stdio.h>
+#include "form.h"
+
+/* Binary images of forms.
+
+   A fasl file is a header, a table of the names of symbols and
+   packages, a table of objects and the indices of the root objects.
+   Objects refer to each other by index so that shared and circular
+   structure is preserved; loading allocates every object first, then
+   relocates the indices into pointers. Symbols and packages are
+   saved by name and found again on load, cfuns by the name of their
+   global function binding. Closures save the frames they capture up
+   to the global frame, which is not saved. */
+
+#define FASL_MAGIC   "cfasl\n"
+#define FASL_VERSION 1
+
+int      fasl_write (FILE *fp, u_form *roots, s_env *env);
+u_form * fasl_read (const unsigned char *buf, unsigned long size,
+                    s_env *env);
+
+u_form * save_fasl (const char *path, u_form *roots, s_env *env);
+u_form * read_fasl (const char *path, s_env *env);
+u_form * load_fasl (const char *path, s_env *env);
+u_form * save_core (const char *path, s_env *env);
+u_form * load_core (const char *path, s_env *env);
+
+u_form * cfun_save_fasl (u_form *args, s_env *env);
+u_form * cfun_load_fasl (u_form *args, s_env *env);
+u_form * cfun_save_core (u_form *args, s_env *env);
+
+#endif
@@ -1,10 +1,15 @@
 
+#include "config.h"
+#ifdef HAVE_ALLOCA_H
+#include <alloca.h>
+#endif
 #include <assert.h>
 #define __USE_MISC 1
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "alloc.h"
 #include "compare.h"
 #include "env.h"
 #include "eval.h"
@@ -24,25 +29,16 @@ u_form * pop (u_form **place)
 u_form * nil ()
 {
         static u_form *nil_sym = NULL;
+        /* Needed before init_symbols runs. */
         if (!nil_sym)
-                nil_sym = (u_form*) sym("nil", NULL);
+                nil_sym = (u_form*) intern_("nil", common_lisp_package());
         return nil_sym;
 }
 
-s_values * new_values (unsigned long count)
-{
-        s_values *values = malloc(sizeof(s_values) +
-                                  count * sizeof(u_form*));
-        if (values) {
-                values->type = FORM_VALUES;
-                values->count = count;
-        }
-        return values;
-}
-
 s_cons * new_cons (u_form *car, u_form *cdr)
 {
-        s_cons *cons = malloc(sizeof(s_cons));
+        s_cons *cons = alloc(sizeof(s_cons));
+        alloc_track(FORM_CONS, sizeof(s_cons));
         if (cons) {
                 cons->type = FORM_CONS;
                 cons->car = car;
@@ -51,27 +47,70 @@ s_cons * new_cons (u_form *car, u_form *cdr)
         return cons;
 }
 
-s_string * init_string (s_string *str, unsigned long length,
-                        const char *chars)
+/* Points str at length characters that it does not own. */
+s_string * init_string_ref (s_string *str, unsigned long length,
+                            const char *chars)
 {
         str->type = FORM_STRING;
         str->length = length;
-        strncpy(string_str(str), chars, length);
-        string_str(str)[length] = 0;
+        str->str = (char*) chars;
+        str->encoding = STRING_UNKNOWN;
+        str->char_count = 0;
+        str->index = NULL;
         return str;
 }
-        
+
+s_string * init_string (s_string *str, unsigned long length,
+                        const char *chars)
+{
+        init_string_ref(str, length, (char*) (str + 1));
+        memcpy(str->str, chars, length);
+        str->str[length] = 0;
+        return str;
+}
+
 s_string * new_string (unsigned long length, const char *chars)
 {
-        s_string *str = malloc(sizeof(s_string) + length + 1);
+        s_string *str = alloc(sizeof(s_string) + length + 1);
+        alloc_track(FORM_STRING, sizeof(s_string) + length + 1);
         if (str)
                 init_string(str, length, chars);
         return str;
 }
 
+/* Characters start to end of s, sharing its storage. */
+s_string * new_string_slice (s_string *s, unsigned long start,
+                             unsigned long end)
+{
+        s_string *str = alloc(sizeof(s_string));
+        alloc_track(FORM_STRING, sizeof(s_string));
+        assert(start <= end && end <= s->length);
+        if (str) {
+                init_string_ref(str, end - start, s->str + start);
+                if (__atomic_load_n(&s->encoding, __ATOMIC_ACQUIRE) ==
+                    STRING_ASCII) {
+                        str->encoding = STRING_ASCII;
+                        str->char_count = str->length;
+                }
+        }
+        return str;
+}
+
+/* The characters of s as a C string, copied if s is a slice that
+   does not end its storage. */
+const char * string_cstr (s_string *s)
+{
+        if (s->str[s->length])
+                return string_str(new_string(s->length, s->str));
+        return s->str;
+}
+
 s_symbol * new_symbol (s_string *string)
 {
         s_symbol *sym = malloc(sizeof(s_symbol));
+        alloc_track(FORM_SYMBOL, sizeof(s_symbol));
+        if (string->str[string->length])
+                string = new_string(string->length, string->str);
         if (sym) {
                 sym->type = FORM_SYMBOL;
                 sym->package = NULL;
@@ -83,29 +122,35 @@ s_symbol * new_symbol (s_string *string)
 s_symbol * gensym (const char *name)
 {
         static long counter = 0;
-        char c[20];
-        s_string *s = new_string(strlen(name), name);
-        snprintf(c, sizeof(c), "%ld", counter++);
-        string_append(s, c, strlen(c));
-        return new_symbol(s);
+        unsigned long len = strlen(name);
+        char *c = alloca(len + 24);
+        memcpy(c, name, len);
+        len += snprintf(c + len, 24, "%ld",
+                        __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED));
+        return new_symbol(new_string(len, c));
 }
 
 s_package * new_package (s_symbol *name)
 {
         s_package *pkg = malloc(sizeof(s_package));
+        alloc_track(FORM_PACKAGE, sizeof(s_package));
         if (pkg) {
                 pkg->type = FORM_PACKAGE;
                 pkg->name = name;
-                pkg->symbols = new_skiplist(10, M_E);
-                pkg->symbols->compare = compare_symbols;
+                symbol_table_init(&pkg->symbols);
+                symbol_table_init(&pkg->external);
+                symbol_table_init(&pkg->inherited);
+                pkg->generation = g_package_generation;
                 pkg->uses = NULL;
+                pkg->shadowing = NULL;
         }
         return pkg;
 }
 
 s_long * new_long (long lng)
 {
-        s_long *n = malloc(sizeof(s_long));
+        s_long *n = alloc(sizeof(s_long));
+        alloc_track(FORM_LONG, sizeof(s_long));
         if (n) {
                 n->type = FORM_LONG;
                 n->lng = lng;
@@ -115,10 +160,38 @@ s_long * new_long (long lng)
 
 s_double * new_double (double dbl)
 {
-        s_double *n = malloc(sizeof(s_double));
+        s_double *n = alloc(sizeof(s_double));
+        alloc_track(FORM_DOUBLE, sizeof(s_double));
         if (n) {
                 n->type = FORM_DOUBLE;
                 n->dbl = dbl;
         }
         return n;
 }
+
+static s_character g_characters[256];
+
+void init_characters ()
+{
+        unsigned long i;
+        for (i = 0; i < 256; i++) {
+                g_characters[i].type = FORM_CHARACTER;
+                g_characters[i].code = i;
+        }
+}
+
+/* Characters below 256 are shared, from a table filled once by
+   init_characters. */
+s_character * new_character (unsigned long code)
+{
+        s_character *c;
+        if (code < 256)
+                return g_characters + code;
+        c = alloc(sizeof(s_character));
+        alloc_track(FORM_CHARACTER, sizeof(s_character));
+        if (c) {
+                c->type = FORM_CHARACTER;
+                c->code = code;
+        }
+        return c;
+}
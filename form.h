@@ -6,7 +6,6 @@
 #include "frame.h"
 
 typedef enum form_type {
-        FORM_VALUES,
         FORM_CONS,
         FORM_STRING,
         FORM_SYMBOL,
@@ -18,29 +17,47 @@ typedef enum form_type {
         FORM_SKIPLIST,
         FORM_SKIPLIST_NODE,
         FORM_FRAME,
-	FORM_HASHTABLE
+	FORM_HASHTABLE,
+	FORM_VECTOR,
+        FORM_CHARACTER,
+        FORM_OSTREAM,
+        FORM_THREAD,
+        FORM_FUTURE,
+        FORM_COROUTINE,
+        FORM_CHANNEL
 } e_form_type;
 
-struct values {
-        e_form_type type;
-        unsigned long count;
-};
-
-#define values_(v) ((u_form**) (((s_values*) v) + 1))
-#define value_(v) (values_(v)[0])
-
 struct cons {
         e_form_type type;
         u_form *car;
         u_form *cdr;
 };
 
+typedef enum string_encoding {
+        STRING_UNKNOWN,
+        STRING_ASCII,
+        STRING_UTF8
+} e_string_encoding;
+
+/* Strings hold UTF-8 bytes and length counts bytes. The characters
+   follow the struct, NUL terminated, except for slices which point
+   into the characters of another string; use string_cstr where a C
+   string is needed. The encoding is found when characters are first
+   counted or indexed: ASCII strings index bytes directly, UTF-8
+   strings build an index of the byte offset of every
+   STRING_INDEX_STRIDE-th character. */
 struct string {
         e_form_type type;
         unsigned long length;
+        char *str;
+        e_string_encoding encoding;
+        unsigned long char_count;
+        unsigned long *index;
 };
 
-#define string_str(s) ((char*)(((s_string*) s) + 1))
+#define STRING_INDEX_STRIDE 32
+
+#define string_str(s) (((s_string*) (s))->str)
 
 struct symbol {
         e_form_type type;
@@ -48,17 +65,42 @@ struct symbol {
         s_string *string;
 };
 
+struct symbol_entry {
+        unsigned long hash;
+        s_symbol *symbol;
+};
+
+/* Symbols by name, with open addressing and linear probing. The
+   hash of each name is kept in its entry so that probes compare
+   names only when hashes match and growing does not rehash. */
+struct symbol_table {
+        unsigned long size;
+        unsigned long count;
+        s_symbol_entry *entries;
+};
+
+/* A package holds the symbols present in it, those of them it
+   exports, and a cache of the external symbols it found in the
+   packages it uses. The cache is dropped when g_package_generation
+   changes, that is when a symbol is uninterned, or when a package
+   starts or stops using another. */
 struct package {
         e_form_type type;
         s_symbol *name;
-        s_skiplist *symbols;
+        s_symbol_table symbols;
+        s_symbol_table external;
+        s_symbol_table inherited;
+        unsigned long generation;
         u_form *uses;
+        u_form *shadowing;
 };
 
 struct cfun {
         e_form_type type;
         s_symbol *name;
         f_cfun *fun;
+        int multiple_values;
+        s_function_stats *stats;
 };
 
 struct lambda {
@@ -68,6 +110,7 @@ struct lambda {
         u_form *lambda_list;
         u_form *body;
         s_frame *frame;
+        s_function_stats *stats;
 };
 
 struct lng {
@@ -80,11 +123,16 @@ struct dbl {
         double dbl;
 };
 
+struct character {
+        e_form_type type;
+        unsigned long code;
+};
+
 #include "hashtable.h"
+#include "vector.h"
 
 union form {
         e_form_type type;
-        s_values values;
         s_cons cons;
         s_string string;
         s_symbol symbol;
@@ -93,14 +141,15 @@ union form {
         s_lambda lambda;
         s_long lng;
         s_double dbl;
+        s_character character;
         s_skiplist skiplist;
         s_skiplist_node skiplist_node;
         s_frame frame;
         s_hashtable hashtable;
+        s_vector vector;
 };
 
 #define null(x)    ((x) == nil())
-#define valuesp(x) ((x) && (x)->type == FORM_VALUES)
 #define consp(x)   ((x) && (x)->type == FORM_CONS)
 #define listp(x)   ((x) && ((x)->type == FORM_CONS || x == nil()))
 #define stringp(x) ((x) && (x)->type == FORM_STRING)
@@ -112,18 +161,28 @@ union form {
 #define floatp(x) ((x) && (x)->type == FORM_DOUBLE)
 #define numberp(x) (integerp(x) || floatp(x))
 #define hashtablep(x) ((x) && (x)->type == FORM_HASHTABLE)
+#define vectorp(x) ((x) && (x)->type == FORM_VECTOR)
+#define characterp(x) ((x) && (x)->type == FORM_CHARACTER)
+#define ostreamp(x) ((x) && (x)->type == FORM_OSTREAM)
+#define threadp(x) ((x) && (x)->type == FORM_THREAD)
+#define futurep(x) ((x) && (x)->type == FORM_FUTURE)
+#define coroutinep(x) ((x) && (x)->type == FORM_COROUTINE)
+#define channelp(x) ((x) && (x)->type == FORM_CHANNEL)
 
-#define value(x) (valuesp(x) ? value_(x) : x)
 #define push(place, x) place = cons(x, place)
 u_form * pop (u_form **place);
 
 s_string *  init_string (s_string *s, unsigned long length,
                          const char *str);
+s_string *  init_string_ref (s_string *s, unsigned long length,
+                             const char *str);
 
 u_form *    nil ();
-s_values *  new_values (unsigned long count);
 s_cons *    new_cons (u_form *car, u_form *cdr);
 s_string *  new_string (unsigned long length, const char *str);
+s_string *  new_string_slice (s_string *s, unsigned long start,
+                              unsigned long end);
+const char * string_cstr (s_string *s);
 s_symbol *  new_symbol (s_string *string);
 s_symbol *  gensym (const char *name);
 s_package * new_package (s_symbol *name);
@@ -132,5 +191,7 @@ s_lambda *  new_lambda (s_symbol *type, s_symbol *name,
                         s_env *env);
 s_long *    new_long (long lng);
 s_double *  new_double (double dbl);
+void          init_characters ();
+s_character * new_character (unsigned long code);
 
 #endif
@@ -1,14 +1,472 @@
 
+#include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include "alloc.h"
+#include "compare.h"
+#include "error.h"
+#include "eval.h"
 #include "form_string.h"
+#include "ostream.h"
+#include "symbols.h"
 
-s_string * string_append (s_string *s, const char *str,
-                          unsigned long len)
+/* Decodes the character at p. Bytes that do not start a well formed
+   UTF-8 sequence decode to themselves, one at a time. */
+unsigned utf8_decode (const char *p, const char *end, unsigned long *code)
 {
-        s = realloc(s, sizeof(s_string) + s->length + len);
-        strncpy(string_str(s) + s->length, str, len);
-        string_str(s)[s->length + len] = 0;
-        s->length += len;
-        return s;
+        const unsigned char *u = (const unsigned char*) p;
+        unsigned long left = end - p;
+        unsigned char lo = 0x80;
+        unsigned char hi = 0xBF;
+        unsigned len;
+        unsigned long c;
+        unsigned i;
+        if (u[0] < 0xC2 || u[0] > 0xF4)
+                goto byte;
+        if (u[0] < 0xE0) {
+                len = 2;
+                c = u[0] & 0x1F;
+        }
+        else if (u[0] < 0xF0) {
+                len = 3;
+                c = u[0] & 0x0F;
+                if (u[0] == 0xE0)
+                        lo = 0xA0;
+                if (u[0] == 0xED)
+                        hi = 0x9F;
+        }
+        else {
+                len = 4;
+                c = u[0] & 0x07;
+                if (u[0] == 0xF0)
+                        lo = 0x90;
+                if (u[0] == 0xF4)
+                        hi = 0x8F;
+        }
+        if (left < len || u[1] < lo || u[1] > hi)
+                goto byte;
+        for (i = 1; i < len; i++) {
+                if (i > 1 && (u[i] & 0xC0) != 0x80)
+                        goto byte;
+                c = (c << 6) | (u[i] & 0x3F);
+        }
+        *code = c;
+        return len;
+ byte:
+        *code = u[0];
+        return 1;
+}
+
+unsigned utf8_encode (unsigned long code, char *buf)
+{
+        if (code < 0x80) {
+                buf[0] = code;
+                return 1;
+        }
+        if (code < 0x800) {
+                buf[0] = 0xC0 | (code >> 6);
+                buf[1] = 0x80 | (code & 0x3F);
+                return 2;
+        }
+        if (code < 0x10000) {
+                buf[0] = 0xE0 | (code >> 12);
+                buf[1] = 0x80 | ((code >> 6) & 0x3F);
+                buf[2] = 0x80 | (code & 0x3F);
+                return 3;
+        }
+        buf[0] = 0xF0 | (code >> 18);
+        buf[1] = 0x80 | ((code >> 12) & 0x3F);
+        buf[2] = 0x80 | ((code >> 6) & 0x3F);
+        buf[3] = 0x80 | (code & 0x3F);
+        return 4;
+}
+
+static int ascii_p (const char *p, unsigned long len)
+{
+        const char *end = p + len;
+        uint64_t w;
+        for (; end - p >= 8; p += 8) {
+                memcpy(&w, p, 8);
+                if (w & 0x8080808080808080ULL)
+                        return 0;
+        }
+        for (; p < end; p++)
+                if (*p & 0x80)
+                        return 0;
+        return 1;
+}
+
+/* Finds the encoding of s, and for UTF-8 counts its characters and
+   builds its index. Threads may race to do this for a shared string:
+   the first index published is kept and the encoding is stored last,
+   so a thread that sees it also sees the count and index. */
+static e_string_encoding string_index (s_string *s)
+{
+        const char *p = string_str(s);
+        const char *end = p + s->length;
+        unsigned long *index;
+        unsigned long *expected = NULL;
+        unsigned long count = 0;
+        unsigned long code;
+        if (ascii_p(p, s->length)) {
+                __atomic_store_n(&s->char_count, s->length,
+                                 __ATOMIC_RELAXED);
+                __atomic_store_n(&s->encoding, STRING_ASCII,
+                                 __ATOMIC_RELEASE);
+                return STRING_ASCII;
+        }
+        index = malloc((s->length / STRING_INDEX_STRIDE + 1) *
+                       sizeof(unsigned long));
+        assert(index);
+        while (p < end) {
+                if (count % STRING_INDEX_STRIDE == 0)
+                        index[count / STRING_INDEX_STRIDE] =
+                                p - string_str(s);
+                p += utf8_decode(p, end, &code);
+                count++;
+        }
+        __atomic_store_n(&s->char_count, count, __ATOMIC_RELAXED);
+        if (!__atomic_compare_exchange_n(&s->index, &expected, index, 0,
+                                         __ATOMIC_RELEASE,
+                                         __ATOMIC_ACQUIRE))
+                free(index);
+        __atomic_store_n(&s->encoding, STRING_UTF8, __ATOMIC_RELEASE);
+        return STRING_UTF8;
+}
+
+static e_string_encoding string_encoding (s_string *s)
+{
+        e_string_encoding encoding = __atomic_load_n(&s->encoding,
+                                                     __ATOMIC_ACQUIRE);
+        if (encoding == STRING_UNKNOWN)
+                return string_index(s);
+        return encoding;
+}
+
+unsigned long string_char_count (s_string *s)
+{
+        string_encoding(s);
+        return __atomic_load_n(&s->char_count, __ATOMIC_RELAXED);
+}
+
+/* Byte offset of character i, which may be the character count. */
+unsigned long string_char_offset (s_string *s, unsigned long i)
+{
+        const char *p;
+        const char *end;
+        unsigned long code;
+        unsigned long n;
+        e_string_encoding encoding = string_encoding(s);
+        if (i >= __atomic_load_n(&s->char_count, __ATOMIC_RELAXED))
+                return s->length;
+        if (encoding == STRING_ASCII)
+                return i;
+        p = string_str(s) + s->index[i / STRING_INDEX_STRIDE];
+        end = string_str(s) + s->length;
+        for (n = i % STRING_INDEX_STRIDE; n; n--)
+                p += utf8_decode(p, end, &code);
+        return p - string_str(s);
+}
+
+/* Index of the character starting at byte offset. */
+unsigned long string_char_index (s_string *s, unsigned long offset)
+{
+        const char *p = string_str(s);
+        const char *end = p + offset;
+        unsigned long code;
+        unsigned long i = 0;
+        if (string_char_count(s) == s->length)
+                return offset;
+        while (p < end) {
+                p += utf8_decode(p, end, &code);
+                i++;
+        }
+        return i;
+}
+
+unsigned long string_char (s_string *s, unsigned long i)
+{
+        unsigned long code;
+        unsigned long offset = string_char_offset(s, i);
+        utf8_decode(string_str(s) + offset, string_str(s) + s->length,
+                    &code);
+        return code;
+}
+
+/* Index of the first occurrence of needle in s at or after start, or
+   -1. Candidates are found with memchr on the first character. */
+long string_search (s_string *needle, s_string *s, unsigned long start)
+{
+        const char *p = string_str(s) + start;
+        const char *end = string_str(s) + s->length;
+        const char *n = string_str(needle);
+        unsigned long len = needle->length;
+        if (start > s->length || len > s->length - start)
+                return -1;
+        if (!len)
+                return start;
+        end -= len - 1;
+        while ((p = memchr(p, n[0], end - p))) {
+                if (!memcmp(p + 1, n + 1, len - 1))
+                        return p - string_str(s);
+                p++;
+        }
+        return -1;
+}
+
+static s_string * string_arg (u_form *x, const char *name, s_env *env)
+{
+        if (!stringp(x))
+                error(env, "%s: not a string", name);
+        return &x->string;
+}
+
+static unsigned long index_arg (u_form *x, unsigned long max,
+                                const char *name, s_env *env)
+{
+        if (!integerp(x) || x->lng.lng < 0 ||
+            (unsigned long) x->lng.lng > max)
+                error(env, "%s: index out of bounds", name);
+        return x->lng.lng;
+}
+
+u_form * cfun_char (u_form *args, s_env *env)
+{
+        s_string *s;
+        unsigned long i;
+        if (!consp(args) || !consp(args->cons.cdr) ||
+            args->cons.cdr->cons.cdr != nil())
+                return error(env, "invalid arguments for char");
+        s = string_arg(args->cons.car, "char", env);
+        i = index_arg(args->cons.cdr->cons.car, string_char_count(s),
+                      "char", env);
+        if (i == string_char_count(s))
+                return error(env, "char: index out of bounds");
+        return (u_form*) new_character(string_char(s, i));
+}
+
+u_form * cfun_char_code (u_form *args, s_env *env)
+{
+        if (!consp(args) || args->cons.cdr != nil() ||
+            !characterp(args->cons.car))
+                return error(env, "invalid arguments for char-code");
+        return (u_form*) new_long(args->cons.car->character.code);
+}
+
+u_form * cfun_code_char (u_form *args, s_env *env)
+{
+        u_form *x;
+        if (!consp(args) || args->cons.cdr != nil())
+                return error(env, "invalid arguments for code-char");
+        x = args->cons.car;
+        if (!integerp(x) || x->lng.lng < 0 || x->lng.lng > CHAR_CODE_LIMIT)
+                return error(env, "code-char: invalid code");
+        return (u_form*) new_character(x->lng.lng);
+}
+
+u_form * cfun_string (u_form *args, s_env *env)
+{
+        u_form *x;
+        char buf[4];
+        if (!consp(args) || args->cons.cdr != nil())
+                return error(env, "invalid arguments for string");
+        x = args->cons.car;
+        if (stringp(x))
+                return x;
+        if (symbolp(x))
+                return (u_form*) x->symbol.string;
+        if (characterp(x) && x->character.code <= CHAR_CODE_LIMIT)
+                return (u_form*) new_string(utf8_encode(x->character.code,
+                                                        buf), buf);
+        return error(env, "string: invalid argument");
+}
+
+/* (concatenate 'string &rest strings) */
+u_form * cfun_concatenate (u_form *args, s_env *env)
+{
+        unsigned long len = 0;
+        s_string *s;
+        char *p;
+        u_form *a;
+        if (!consp(args))
+                return error(env, "invalid arguments for concatenate");
+        if (args->cons.car != g_sym.string)
+                return error(env, "concatenate: unsupported result "
+                             "type");
+        for (a = args->cons.cdr; consp(a); a = a->cons.cdr)
+                len += string_arg(a->cons.car, "concatenate", env)->length;
+        if (!(s = alloc(sizeof(s_string) + len + 1)))
+                return error(env, "concatenate: out of memory");
+        alloc_track(FORM_STRING, sizeof(s_string) + len + 1);
+        init_string_ref(s, len, (char*) (s + 1));
+        p = s->str;
+        for (a = args->cons.cdr; consp(a); a = a->cons.cdr) {
+                memcpy(p, string_str(a->cons.car),
+                       a->cons.car->string.length);
+                p += a->cons.car->string.length;
+        }
+        *p = 0;
+        return (u_form*) s;
+}
+
+/* Subsequences of strings share the bytes of the string. */
+u_form * cfun_subseq (u_form *args, s_env *env)
+{
+        u_form *seq;
+        unsigned long start;
+        unsigned long end;
+        unsigned long len;
+        if (!consp(args) || !consp(args->cons.cdr) ||
+            (args->cons.cdr->cons.cdr != nil() &&
+             (!consp(args->cons.cdr->cons.cdr) ||
+              cdr(cddr(args)) != nil())))
+                return error(env, "invalid arguments for subseq");
+        seq = args->cons.car;
+        if (stringp(seq))
+                len = string_char_count(&seq->string);
+        else if (listp(seq))
+                len = length(seq);
+        else
+                return error(env, "subseq: not a sequence");
+        end = len;
+        start = index_arg(cadr(args), len, "subseq", env);
+        if (consp(cddr(args)) && caddr(args) != nil())
+                end = index_arg(caddr(args), len, "subseq", env);
+        if (start > end)
+                return error(env, "subseq: start after end");
+        if (stringp(seq))
+                return (u_form*) new_string_slice
+                        (&seq->string, string_char_offset(&seq->string, start),
+                         string_char_offset(&seq->string, end));
+        {
+                u_form *head = nil();
+                u_form **tail = &head;
+                unsigned long i;
+                for (i = 0; i < start; i++)
+                        seq = seq->cons.cdr;
+                for (; i < end; i++) {
+                        *tail = cons(seq->cons.car, nil());
+                        tail = &(*tail)->cons.cdr;
+                        seq = seq->cons.cdr;
+                }
+                return head;
+        }
+}
+
+/* (search needle string &optional start) */
+u_form * cfun_search (u_form *args, s_env *env)
+{
+        s_string *needle;
+        s_string *s;
+        unsigned long start = 0;
+        long i;
+        if (!consp(args) || !consp(args->cons.cdr) ||
+            (cddr(args) != nil() &&
+             (!consp(cddr(args)) || cdr(cddr(args)) != nil())))
+                return error(env, "invalid arguments for search");
+        needle = string_arg(args->cons.car, "search", env);
+        s = string_arg(cadr(args), "search", env);
+        if (consp(cddr(args)))
+                start = string_char_offset
+                        (s, index_arg(caddr(args), string_char_count(s),
+                                      "search", env));
+        if ((i = string_search(needle, s, start)) < 0)
+                return nil();
+        return (u_form*) new_long(string_char_index(s, i));
+}
+
+static int string_compare_args (u_form *args, const char *name,
+                                s_env *env)
+{
+        if (!consp(args) || !consp(args->cons.cdr) ||
+            args->cons.cdr->cons.cdr != nil())
+                error(env, "invalid arguments for %s", name);
+        return compare_strings(string_arg(args->cons.car, name, env),
+                               string_arg(cadr(args), name, env));
+}
+
+u_form * cfun_string_eq (u_form *args, s_env *env)
+{
+        return string_compare_args(args, "string=", env) ? nil() :
+                g_sym.t;
+}
+
+u_form * cfun_string_lt (u_form *args, s_env *env)
+{
+        return string_compare_args(args, "string<", env) < 0 ?
+                g_sym.t : nil();
+}
+
+u_form * cfun_string_gt (u_form *args, s_env *env)
+{
+        return string_compare_args(args, "string>", env) > 0 ?
+                g_sym.t : nil();
+}
+
+/* String output streams are the string builder of Lisp code : they
+   grow geometrically and get-output-stream-string takes their
+   buffer without copying. */
+u_form * cfun_make_string_output_stream (u_form *args, s_env *env)
+{
+        s_ostream *os;
+        if (args != nil())
+                return error(env, "invalid arguments for "
+                             "make-string-output-stream");
+        if (!(os = malloc(sizeof(s_ostream))))
+                return error(env, "make-string-output-stream: out of "
+                             "memory");
+        ostream_init_string(os);
+        return (u_form*) os;
+}
+
+static s_ostream * ostream_arg (u_form *x, const char *name, s_env *env)
+{
+        if (!ostreamp(x))
+                error(env, "%s: not an output stream", name);
+        return (s_ostream*) x;
+}
+
+u_form * cfun_write_string (u_form *args, s_env *env)
+{
+        s_string *s;
+        if (!consp(args) || !consp(args->cons.cdr) ||
+            args->cons.cdr->cons.cdr != nil())
+                return error(env, "invalid arguments for write-string");
+        s = string_arg(args->cons.car, "write-string", env);
+        ostream_write(ostream_arg(cadr(args), "write-string", env),
+                      string_str(s), s->length);
+        return (u_form*) s;
+}
+
+u_form * cfun_write_char (u_form *args, s_env *env)
+{
+        u_form *c;
+        s_ostream *os;
+        char buf[4];
+        if (!consp(args) || !consp(args->cons.cdr) ||
+            args->cons.cdr->cons.cdr != nil())
+                return error(env, "invalid arguments for write-char");
+        c = args->cons.car;
+        if (!characterp(c) || c->character.code > CHAR_CODE_LIMIT)
+                return error(env, "write-char: invalid character");
+        os = ostream_arg(cadr(args), "write-char", env);
+        ostream_write(os, buf, utf8_encode(c->character.code, buf));
+        return c;
+}
+
+u_form * cfun_get_output_stream_string (u_form *args, s_env *env)
+{
+        s_ostream *os;
+        s_string *s;
+        if (!consp(args) || args->cons.cdr != nil())
+                return error(env, "invalid arguments for "
+                             "get-output-stream-string");
+        os = ostream_arg(args->cons.car, "get-output-stream-string", env);
+        if (os->sink != OSTREAM_STRING)
+                return error(env, "get-output-stream-string: not a "
+                             "string output stream");
+        s = ostream_string(os);
+        ostream_init_string(os);
+        return (u_form*) s;
 }
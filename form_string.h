@@ -3,7 +3,33 @@
 
 #include "form.h"
 
-s_string * string_append (s_string *s, const char *str,
-                          unsigned long len);
+/* Characters are Unicode code points, strings hold them UTF-8
+   encoded. */
+#define CHAR_CODE_LIMIT 0x10FFFF
+
+unsigned      utf8_decode (const char *p, const char *end,
+                           unsigned long *code);
+unsigned      utf8_encode (unsigned long code, char *buf);
+unsigned long string_char_count (s_string *s);
+unsigned long string_char_offset (s_string *s, unsigned long i);
+unsigned long string_char_index (s_string *s, unsigned long offset);
+unsigned long string_char (s_string *s, unsigned long i);
+long          string_search (s_string *needle, s_string *s,
+                            unsigned long start);
+
+u_form * cfun_char (u_form *args, s_env *env);
+u_form * cfun_char_code (u_form *args, s_env *env);
+u_form * cfun_code_char (u_form *args, s_env *env);
+u_form * cfun_string (u_form *args, s_env *env);
+u_form * cfun_concatenate (u_form *args, s_env *env);
+u_form * cfun_subseq (u_form *args, s_env *env);
+u_form * cfun_search (u_form *args, s_env *env);
+u_form * cfun_string_eq (u_form *args, s_env *env);
+u_form * cfun_string_lt (u_form *args, s_env *env);
+u_form * cfun_string_gt (u_form *args, s_env *env);
+u_form * cfun_make_string_output_stream (u_form *args, s_env *env);
+u_form * cfun_write_string (u_form *args, s_env *env);
+u_form * cfun_write_char (u_form *args, s_env *env);
+u_form * cfun_get_output_stream_string (u_form *args, s_env *env);
 
 #endif
@@ -1,13 +1,36 @@
+#include <pthread.h>
 #include <stdlib.h>
+#include "alloc.h"
 #include "compare.h"
 #include "error.h"
 #include "eval.h"
 #include "frame.h"
 #include "package.h"
+#include "symbols.h"
+
+unsigned long g_package_bindings = 0;
+
+/* Threads share the global frame, the one without a parent: its
+   writers take this lock while readers walk its skiplists without
+   one, as skiplists publish their links with release stores. */
+static pthread_mutex_t g_global_frame_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void frame_lock (s_frame *frame)
+{
+        if (!frame->parent)
+                pthread_mutex_lock(&g_global_frame_mutex);
+}
+
+static void frame_unlock (s_frame *frame)
+{
+        if (!frame->parent)
+                pthread_mutex_unlock(&g_global_frame_mutex);
+}
 
 s_frame * new_frame (s_frame *parent)
 {
-        s_frame *f = malloc(sizeof(s_frame));
+        s_frame *f = alloc(sizeof(s_frame));
+        alloc_track(FORM_FRAME, sizeof(s_frame));
         if (f) {
                 f->type = FORM_FRAME;
                 f->variables = NULL;
@@ -18,39 +41,69 @@ s_frame * new_frame (s_frame *parent)
         return f;
 }
 
-void frame_new_variable (s_symbol *sym, u_form *value, s_frame *frame)
+static void frame_bind (s_skiplist **bindings, s_symbol *sym,
+                        u_form *value, s_frame *frame)
 {
-        s_cons *binding;
-        if (valuesp(value))
-                value = value_(value);
-        binding = new_cons((u_form*) sym, value);
-        if (!frame->variables) {
-                frame->variables = new_skiplist(5, 4);
-                frame->variables->compare = compare_frame_bindings;
+        s_cons *binding = new_cons((u_form*) sym, value);
+        s_skiplist *sl;
+        frame_lock(frame);
+        if (!*bindings) {
+                sl = new_skiplist(5, 4);
+                sl->compare = compare_frame_bindings;
+                __atomic_store_n(bindings, sl, __ATOMIC_RELEASE);
         }
-        skiplist_insert(frame->variables, binding);
+        skiplist_insert(*bindings, binding);
+        frame_unlock(frame);
+}
+
+static void frame_unbind (s_skiplist *bindings, s_symbol *sym,
+                          s_frame *frame)
+{
+        s_cons search;
+        search.type = FORM_CONS;
+        search.car = (u_form*) sym;
+        search.cdr = NULL;
+        if (!bindings)
+                return;
+        frame_lock(frame);
+        skiplist_delete(bindings, &search);
+        frame_unlock(frame);
+}
+
+void frame_new_variable (s_symbol *sym, u_form *value, s_frame *frame)
+{
+        frame_bind(&frame->variables, sym, value, frame);
+        if ((u_form*) sym == g_sym.package_var)
+                __atomic_add_fetch(&g_package_bindings, 1,
+                                   __ATOMIC_RELAXED);
 }
 
 void frame_new_function (s_symbol *sym, u_form *value, s_frame *frame)
 {
-        s_cons *binding;
-        binding = new_cons((u_form*) sym, value);
-        if (!frame->functions) {
-                frame->functions = new_skiplist(5, 4);
-                frame->functions->compare = compare_frame_bindings;
-        }
-        skiplist_insert(frame->functions, binding);
+        frame_bind(&frame->functions, sym, value, frame);
 }
 
 void frame_new_macro (s_symbol *sym, s_lambda *value, s_frame *frame)
 {
-        s_cons *binding;
-        binding = new_cons((u_form*) sym, (u_form*) value);
-        if (!frame->macros) {
-                frame->macros = new_skiplist(5, 4);
-                frame->macros->compare = compare_frame_bindings;
-        }
-        skiplist_insert(frame->macros, binding);
+        frame_bind(&frame->macros, sym, (u_form*) value, frame);
+}
+
+void frame_delete_variable (s_symbol *sym, s_frame *frame)
+{
+        frame_unbind(frame->variables, sym, frame);
+        if ((u_form*) sym == g_sym.package_var)
+                __atomic_add_fetch(&g_package_bindings, 1,
+                                   __ATOMIC_RELAXED);
+}
+
+void frame_delete_function (s_symbol *sym, s_frame *frame)
+{
+        frame_unbind(frame->functions, sym, frame);
+}
+
+void frame_delete_macro (s_symbol *sym, s_frame *frame)
+{
+        frame_unbind(frame->macros, sym, frame);
 }
 
 u_form ** frame_variable (s_symbol *sym, s_frame *frame)
@@ -151,26 +204,18 @@ void fdb_plist (u_form *lambda_term, u_form *plist, s_frame *frame,
 void frame_destructuring_bind (u_form *lambda_list, u_form *args,
                                s_frame *frame, s_env *env)
 {
-        static u_form *rest_sym = NULL;
-        static u_form *body_sym;
-        static u_form *key_sym;
         s_symbol *rest = NULL;
         u_form *plist = NULL;
-        if (!rest_sym) {
-                rest_sym = (u_form*) sym("&rest", NULL);
-                body_sym = (u_form*) sym("&body", NULL);
-                key_sym = (u_form*) sym("&key", NULL);
-        }
         while (consp(lambda_list) && consp(args)) {
                 u_form *lambda_term = lambda_list->cons.car;
                 if (rest)
                         fdb_rest(lambda_list, rest, &args, frame, env);
-                else if (lambda_term == rest_sym ||
-                         lambda_term == body_sym)
+                else if (lambda_term == g_sym.rest ||
+                         lambda_term == g_sym.body)
                         rest = &lambda_term->symbol;
                 else if (plist)
                         fdb_plist(lambda_term, plist, frame, env);
-                else if (lambda_term == key_sym)
+                else if (lambda_term == g_sym.key)
                         plist = args;
                 else if (consp(lambda_term)) {
                         frame_destructuring_bind(lambda_term,
@@ -12,6 +12,10 @@ struct frame
         struct frame *parent;
 };
 
+/* Counts the bindings of *package* made or removed, so that the
+   binding seen from a frame can be cached. */
+extern unsigned long g_package_bindings;
+
 int compare_frame_bindings (void *a, void *b);
 
 s_frame * new_frame (s_frame *parent);
@@ -21,6 +25,9 @@ void          frame_new_function (s_symbol *sym, u_form *value,
                                   s_frame *frame);
 void          frame_new_macro (s_symbol *sym, s_lambda *value,
                                s_frame *frame);
+void          frame_delete_variable (s_symbol *sym, s_frame *frame);
+void          frame_delete_function (s_symbol *sym, s_frame *frame);
+void          frame_delete_macro (s_symbol *sym, s_frame *frame);
 u_form **     frame_variable (s_symbol *sym, s_frame *frame);
 u_form **     frame_function (s_symbol *sym, s_frame *frame);
 u_form **     frame_macro (s_symbol *sym, s_frame *frame);
@@ -0,0 +1,238 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "alloc.h"
+#include "error.h"
+#include "eval.h"
+#include "function_stats.h"
+#include "lambda.h"
+#include "symbols.h"
+#include "unwind_protect.h"
+
+/* Checked by funcall before anything else is done for a call. */
+int g_function_stats = 0;
+
+/* Every function called while counting, most recent first. */
+static s_function_stats *g_function_stats_list = NULL;
+
+static const char *g_function_stats_path = NULL;
+
+static unsigned long stats_now (void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+static s_function_stats ** stats_slot (u_form *fun)
+{
+        if (fun->type == FORM_CFUN)
+                return &fun->cfun.stats;
+        return &fun->lambda.stats;
+}
+
+/* The stats of fun, created on its first call by whichever thread
+   makes it. */
+s_function_stats * function_stats (u_form *fun)
+{
+        s_function_stats **slot = stats_slot(fun);
+        s_function_stats *stats = __atomic_load_n(slot,
+                                                  __ATOMIC_ACQUIRE);
+        s_function_stats *expected = NULL;
+        if (stats || !(stats = calloc(1, sizeof(s_function_stats))))
+                return stats;
+        stats->fun = fun;
+        if (!__atomic_compare_exchange_n(slot, &expected, stats, 0,
+                                         __ATOMIC_ACQ_REL,
+                                         __ATOMIC_ACQUIRE)) {
+                free(stats);
+                return expected;
+        }
+        stats->next = __atomic_load_n(&g_function_stats_list,
+                                      __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&g_function_stats_list,
+                                            &stats->next, stats, 1,
+                                            __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED))
+                ;
+        return stats;
+}
+
+s_function_stats * function_stats_list (void)
+{
+        return __atomic_load_n(&g_function_stats_list, __ATOMIC_ACQUIRE);
+}
+
+static void stats_enter (s_stats_call *call, u_form *fun, s_env *env)
+{
+        call->stats = function_stats(fun);
+        call->child_time = 0;
+        call->parent = env->stats_call;
+        env->stats_call = call;
+        call->bytes = g_alloc_bytes;
+        call->start = stats_now();
+}
+
+static void stats_leave (s_stats_call *call, s_env *env)
+{
+        unsigned long time = stats_now() - call->start;
+        long bytes = g_alloc_bytes - call->bytes;
+        s_function_stats *stats = call->stats;
+        env->stats_call = call->parent;
+        if (call->parent)
+                call->parent->child_time += time;
+        if (!stats)
+                return;
+        __atomic_fetch_add(&stats->calls, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stats->time, time, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stats->self, time > call->child_time ?
+                           time - call->child_time : 0,
+                           __ATOMIC_RELAXED);
+        if (bytes > 0)
+                __atomic_fetch_add(&stats->bytes, bytes,
+                                   __ATOMIC_RELAXED);
+}
+
+/* funcall, counting the call to fun. A coroutine resumed on another
+   thread may count the bytes of that thread's other work. */
+u_form * stats_funcall (u_form *fun, u_form *args, s_env *env)
+{
+        s_stats_call call;
+        s_unwind_protect up;
+        u_form *result;
+        stats_enter(&call, fun, env);
+        if (setjmp(up.buf)) {
+                pop_unwind_protect(env);
+                stats_leave(&call, env);
+                longjmp(*up.jmp, 1);
+        }
+        push_unwind_protect(&up, env);
+        if (fun->type == FORM_CFUN)
+                result = funcall_cfun(fun, args, env);
+        else
+                result = funcall_lambda(&fun->lambda, args, env);
+        pop_unwind_protect(env);
+        stats_leave(&call, env);
+        return result;
+}
+
+s_string * function_stats_name (s_function_stats *stats)
+{
+        u_form *fun = stats->fun;
+        if (fun->type == FORM_CFUN)
+                return fun->cfun.name->string;
+        if ((u_form*) fun->lambda.name != nil())
+                return fun->lambda.name->string;
+        return g_sym.lambda->symbol.string;
+}
+
+static void write_quoted (FILE *fp, s_string *s, char escape)
+{
+        unsigned long i;
+        fputc('"', fp);
+        for (i = 0; i < s->length; i++) {
+                char c = string_str(s)[i];
+                if (c == '"' || c == escape)
+                        fputc(escape, fp);
+                fputc(c, fp);
+        }
+        fputc('"', fp);
+}
+
+/* Writes the stats of every function called so far, as JSON if path
+   ends in .json and as CSV otherwise. */
+int function_stats_dump (const char *path)
+{
+        s_function_stats *stats = function_stats_list();
+        unsigned long len = strlen(path);
+        int json = len >= 5 && !strcmp(path + len - 5, ".json");
+        FILE *fp = fopen(path, "w");
+        if (!fp)
+                return -1;
+        fputs(json ? "[" : "name,calls,time_ns,self_ns,bytes\n", fp);
+        for (; stats; stats = stats->next) {
+                s_string *name = function_stats_name(stats);
+                if (json) {
+                        fputs("\n  {\"name\": ", fp);
+                        write_quoted(fp, name, '\\');
+                        fprintf(fp, ", \"calls\": %lu, \"time_ns\": %lu,"
+                                " \"self_ns\": %lu, \"bytes\": %lu}%s",
+                                stats->calls, stats->time, stats->self,
+                                stats->bytes, stats->next ? "," : "\n");
+                }
+                else {
+                        write_quoted(fp, name, '"');
+                        fprintf(fp, ",%lu,%lu,%lu,%lu\n", stats->calls,
+                                stats->time, stats->self, stats->bytes);
+                }
+        }
+        if (json)
+                fputs("]\n", fp);
+        return fclose(fp) ? -1 : 0;
+}
+
+static void function_stats_exit (void)
+{
+        if (function_stats_dump(g_function_stats_path))
+                perror(g_function_stats_path);
+}
+
+/* Counts calls from now on and dumps them to path on exit. */
+void function_stats_at_exit (const char *path)
+{
+        g_function_stats_path = path;
+        g_function_stats = 1;
+        atexit(function_stats_exit);
+}
+
+u_form * cfun_function_stats_start (u_form *args, s_env *env)
+{
+        if (args != nil())
+                return error(env, "invalid arguments for "
+                             "function-stats-start");
+        g_function_stats = 1;
+        return g_sym.t;
+}
+
+u_form * cfun_function_stats_stop (u_form *args, s_env *env)
+{
+        if (args != nil())
+                return error(env, "invalid arguments for "
+                             "function-stats-stop");
+        g_function_stats = 0;
+        return nil();
+}
+
+/* (function-stats function) returns (:calls n :time ns :self ns
+   :bytes n), or nil if function was not called while counting. */
+u_form * cfun_function_stats (u_form *args, s_env *env)
+{
+        s_function_stats *stats;
+        u_form *fun;
+        if (!consp(args) || args->cons.cdr != nil())
+                return error(env, "invalid arguments for function-stats");
+        fun = function_designator(args->cons.car, env);
+        if (!(stats = __atomic_load_n(stats_slot(fun), __ATOMIC_ACQUIRE)))
+                return nil();
+        return cons(g_kw.calls, cons((u_form*) new_long(stats->calls),
+               cons(g_kw.time, cons((u_form*) new_long(stats->time),
+               cons(g_kw.self, cons((u_form*) new_long(stats->self),
+               cons(g_kw.bytes, cons((u_form*) new_long(stats->bytes),
+                                     nil()))))))));
+}
+
+u_form * cfun_function_stats_dump (u_form *args, s_env *env)
+{
+        const char *path;
+        if (!consp(args) || !stringp(args->cons.car) ||
+            args->cons.cdr != nil())
+                return error(env, "invalid arguments for "
+                             "function-stats-dump");
+        path = string_cstr(&args->cons.car->string);
+        if (function_stats_dump(path))
+                return error(env, "function-stats-dump: cannot write %s",
+                             path);
+        return g_sym.t;
+}
@@ -0,0 +1,47 @@
+#ifndef FUNCTION_STATS_H
+#define FUNCTION_STATS_H
+
+#include "env.h"
+#include "form.h"
+
+/* The calls to one function, with the nanoseconds spent in them,
+   self leaving out the time of the functions they call, and the
+   bytes they allocated. site_objects and site_bytes count the forms
+   made while allocations are tracked with the function innermost on
+   the backtrace. */
+struct function_stats {
+        u_form *fun;
+        unsigned long calls;
+        unsigned long time;
+        unsigned long self;
+        unsigned long bytes;
+        unsigned long site_objects;
+        unsigned long site_bytes;
+        s_function_stats *next;
+};
+
+/* A timed call, on the C stack: the calls it makes add their time
+   to child_time. */
+struct stats_call {
+        s_function_stats *stats;
+        unsigned long start;
+        unsigned long child_time;
+        unsigned long bytes;
+        s_stats_call *parent;
+};
+
+extern int g_function_stats;
+
+s_function_stats * function_stats (u_form *fun);
+s_function_stats * function_stats_list (void);
+s_string *         function_stats_name (s_function_stats *stats);
+u_form *           stats_funcall (u_form *fun, u_form *args, s_env *env);
+int                function_stats_dump (const char *path);
+void               function_stats_at_exit (const char *path);
+
+u_form * cfun_function_stats_start (u_form *args, s_env *env);
+u_form * cfun_function_stats_stop (u_form *args, s_env *env);
+u_form * cfun_function_stats (u_form *args, s_env *env);
+u_form * cfun_function_stats_dump (u_form *args, s_env *env);
+
+#endif
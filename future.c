@@ -0,0 +1,57 @@
+#include <stdlib.h>
+#include "error.h"
+#include "eval.h"
+#include "future.h"
+#include "symbols.h"
+
+s_future * make_future (u_form *function, s_env *env)
+{
+        s_future *f = malloc(sizeof(s_future));
+        if (!f) {
+                error(env, "future: out of memory");
+                return NULL;
+        }
+        f->type = FORM_FUTURE;
+        f->args = nil();
+        f->value = nil();
+        pool_job_init(&f->job, POOL_MAP, function, env);
+        f->job.items = &f->args;
+        f->job.results = &f->value;
+        f->job.count = 1;
+        pool_start_job(&f->job, env);
+        return f;
+}
+
+u_form * force (s_future *f, s_env *env)
+{
+        pool_wait_job(&f->job);
+        if (f->job.stop < f->job.count)
+                return error_(f->job.error, env);
+        return f->value;
+}
+
+/* (future &rest body) */
+u_form * cspecial_future (u_form *args, s_env *env)
+{
+        u_form *l = (u_form*) new_lambda(&g_sym.lambda->symbol,
+                                         &nil()->symbol, nil(), args, env);
+        return (u_form*) make_future(l, env);
+}
+
+u_form * cfun_force (u_form *args, s_env *env)
+{
+        if (!consp(args) || args->cons.cdr != nil())
+                return error(env, "invalid arguments for force");
+        if (!futurep(args->cons.car))
+                return args->cons.car;
+        return force((s_future*) args->cons.car, env);
+}
+
+u_form * cfun_future_done_p (u_form *args, s_env *env)
+{
+        if (!consp(args) || !futurep(args->cons.car) ||
+            args->cons.cdr != nil())
+                return error(env, "invalid arguments for future-done-p");
+        return pool_job_done_p(&((s_future*) args->cons.car)->job) ?
+                g_sym.t : nil();
+}
@@ -0,0 +1,24 @@
+#ifndef FUTURE_H
+#define FUTURE_H
+
+#include "pool.h"
+
+typedef struct future s_future;
+
+/* A closure run once by the thread pool. force waits for its value,
+   or signals again the error that ended it. */
+struct future {
+        e_form_type type;
+        s_pool_job job;
+        u_form *args;
+        u_form *value;
+};
+
+s_future * make_future (u_form *function, s_env *env);
+u_form *   force (s_future *f, s_env *env);
+
+u_form * cspecial_future (u_form *args, s_env *env);
+u_form * cfun_force (u_form *args, s_env *env);
+u_form * cfun_future_done_p (u_form *args, s_env *env);
+
+#endif
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include "alloc.h"
 #include "city.h"
 #include "env.h"
 #include "error.h"
@@ -6,6 +7,7 @@
 #include "form.h"
 #include "hashtable.h"
 #include "package.h"
+#include "symbols.h"
 
 void init_hashtable_buckets (s_hashtable *h)
 {
@@ -23,28 +25,132 @@ s_hashtable * new_hashtable (long size,
 {
         s_hashtable *h;
         h = malloc(sizeof(s_hashtable));
+        alloc_track(FORM_HASHTABLE, sizeof(s_hashtable) +
+                    size * sizeof(u_form*));
         if (h) {
                 h->type = FORM_HASHTABLE;
                 h->size = size;
                 h->rehash_size_long = rehash_size_long;
                 h->rehash_size_double = rehash_size_double;
                 h->rehash_threshold = rehash_threshold;
+                h->array = NULL;
+                h->locks = NULL;
                 init_hashtable_buckets(h);
                 return h;
         }
         return NULL;
 }
 
+long hashtable_index_ (long hash, long size);
+
+static long hashtable_grown_size (s_hashtable *h, long size)
+{
+        if (h->rehash_size_long)
+                return size + h->rehash_size_long;
+        return size * h->rehash_size_double;
+}
+
+static s_hashtable_array * new_hashtable_array (long size)
+{
+        s_hashtable_array *a = malloc(sizeof(s_hashtable_array));
+        long i;
+        if (!a)
+                return NULL;
+        if (!(a->buckets = malloc(size * sizeof(u_form*)))) {
+                free(a);
+                return NULL;
+        }
+        a->size = size;
+        for (i = 0; i < size; i++)
+                a->buckets[i] = nil();
+        return a;
+}
+
+static s_hashtable_array * hashtable_array (s_hashtable *h)
+{
+        return __atomic_load_n(&h->array, __ATOMIC_ACQUIRE);
+}
+
+/* Publishes a as the array of h: callers hold every stripe. */
+static void hashtable_publish (s_hashtable *h, s_hashtable_array *a)
+{
+        h->size = a->size;
+        h->buckets = a->buckets;
+        __atomic_store_n(&h->array, a, __ATOMIC_RELEASE);
+}
+
+static void lock_stripes (s_hashtable *h)
+{
+        long i;
+        for (i = 0; i < HASHTABLE_STRIPES; i++)
+                pthread_mutex_lock(&h->locks[i]);
+}
+
+static void unlock_stripes (s_hashtable *h)
+{
+        long i = HASHTABLE_STRIPES;
+        while (i--)
+                pthread_mutex_unlock(&h->locks[i]);
+}
+
+int hashtable_synchronize (s_hashtable *h)
+{
+        s_hashtable_array *a;
+        long i;
+        if (h->array)
+                return 0;
+        if (!(a = malloc(sizeof(s_hashtable_array))) ||
+            !(h->locks = malloc(HASHTABLE_STRIPES *
+                                sizeof(pthread_mutex_t)))) {
+                free(a);
+                return -1;
+        }
+        for (i = 0; i < HASHTABLE_STRIPES; i++)
+                pthread_mutex_init(&h->locks[i], NULL);
+        a->size = h->size;
+        a->buckets = h->buckets;
+        hashtable_publish(h, a);
+        return 0;
+}
+
+/* Grows a synchronized table into a new array. The entries are
+   shared with the old array, so that a value set through either is
+   seen through both, but the bucket lists are copied. */
+static void hashtable_resize (s_hashtable *h)
+{
+        s_hashtable_array *a;
+        s_hashtable_array *n;
+        long i;
+        lock_stripes(h);
+        a = h->array;
+        if (h->count / (double) a->size > h->rehash_threshold &&
+            (n = new_hashtable_array(hashtable_grown_size(h, a->size)))) {
+                for (i = 0; i < a->size; i++) {
+                        u_form *b;
+                        for (b = a->buckets[i]; consp(b);
+                             b = b->cons.cdr) {
+                                long j = hashtable_index_(sxhash(caar(b)),
+                                                          n->size);
+                                push(n->buckets[j], b->cons.car);
+                        }
+                }
+                hashtable_publish(h, n);
+        }
+        unlock_stripes(h);
+}
+
 int hashtable_rehash (s_hashtable *h)
 {
         double r = h->count / (double) h->size;
+        if (h->array) {
+                if (r > h->rehash_threshold)
+                        hashtable_resize(h);
+                return 0;
+        }
         if (r > h->rehash_threshold) {
                 long size = h->size;
                 u_form **buckets = h->buckets;
-                if (h->rehash_size_long)
-                        h->size += h->rehash_size_long;
-                else
-                        h->size *= h->rehash_size_double;
+                h->size = hashtable_grown_size(h, size);
                 init_hashtable_buckets(h);
                 while (size--) {
                         u_form *b = *buckets++;
@@ -59,19 +165,109 @@ int hashtable_rehash (s_hashtable *h)
         return 0;
 }
 
-long hashtable_index (s_hashtable *h, u_form *key)
+long hashtable_index_ (long hash, long size)
 {
-        long hash = sxhash(key);
-        long index = hash % h->size;
+        long index = hash % size;
         if (index < 0)
-                index += h->size;
+                index += size;
         return index;
 }
 
+long hashtable_index (s_hashtable *h, u_form *key)
+{
+        return hashtable_index_(sxhash(key), h->size);
+}
+
+/* Locks the stripe of the bucket of a key with this hash in the
+   current array, which cannot change until it is unlocked. */
+static s_hashtable_array * lock_bucket (s_hashtable *h, long hash,
+                                        long *index)
+{
+        for (;;) {
+                s_hashtable_array *a = hashtable_array(h);
+                long i = hashtable_index_(hash, a->size);
+                pthread_mutex_t *m = &h->locks[i % HASHTABLE_STRIPES];
+                pthread_mutex_lock(m);
+                if (a == hashtable_array(h)) {
+                        *index = i;
+                        return a;
+                }
+                pthread_mutex_unlock(m);
+        }
+}
+
+static void unlock_bucket (s_hashtable *h, long index)
+{
+        pthread_mutex_unlock(&h->locks[index % HASHTABLE_STRIPES]);
+}
+
+static u_form * gethash_synchronized (s_hashtable *h, u_form *key)
+{
+        s_hashtable_array *a = hashtable_array(h);
+        long index = hashtable_index_(sxhash(key), a->size);
+        u_form *b = __atomic_load_n(&a->buckets[index], __ATOMIC_ACQUIRE);
+        while (consp(b)) {
+                u_form *entry = b->cons.car;
+                if (equal(entry->cons.car, key))
+                        return __atomic_load_n(&entry->cons.cdr,
+                                               __ATOMIC_ACQUIRE);
+                b = __atomic_load_n(&b->cons.cdr, __ATOMIC_ACQUIRE);
+        }
+        return NULL;
+}
+
+static u_form * sethash_synchronized (s_hashtable *h, u_form *key,
+                                      u_form *value)
+{
+        long index;
+        s_hashtable_array *a = lock_bucket(h, sxhash(key), &index);
+        u_form *b;
+        long count;
+        for (b = a->buckets[index]; consp(b); b = b->cons.cdr)
+                if (equal(caar(b), key)) {
+                        __atomic_store_n(&b->cons.car->cons.cdr, value,
+                                         __ATOMIC_RELEASE);
+                        unlock_bucket(h, index);
+                        return value;
+                }
+        __atomic_store_n(&a->buckets[index],
+                         cons(cons(key, value), a->buckets[index]),
+                         __ATOMIC_RELEASE);
+        count = __atomic_add_fetch(&h->count, 1, __ATOMIC_RELAXED);
+        unlock_bucket(h, index);
+        if (count / (double) a->size > h->rehash_threshold)
+                hashtable_resize(h);
+        return value;
+}
+
+static int remhash_synchronized (s_hashtable *h, u_form *key)
+{
+        long index;
+        s_hashtable_array *a = lock_bucket(h, sxhash(key), &index);
+        u_form **b = &a->buckets[index];
+        while (consp(*b)) {
+                if (equal(caar(*b), key)) {
+                        __atomic_store_n(b, (*b)->cons.cdr,
+                                         __ATOMIC_RELEASE);
+                        __atomic_sub_fetch(&h->count, 1,
+                                           __ATOMIC_RELAXED);
+                        unlock_bucket(h, index);
+                        return 1;
+                }
+                b = &(*b)->cons.cdr;
+        }
+        unlock_bucket(h, index);
+        return 0;
+}
+
 u_form * gethash (s_hashtable *h, u_form *key)
 {
-        long index = hashtable_index(h, key);
-        u_form *a = h->buckets[index];
+        long index;
+        u_form *a;
+        if (h->array)
+                return gethash_synchronized(h, key);
+        index = hashtable_index(h, key);
+        a = h->buckets[index];
         while (consp(a)) {
                 if (equal(caar(a), key))
                         return cdar(a);
@@ -82,8 +278,12 @@ u_form * gethash (s_hashtable *h, u_form *key)
 
 u_form * sethash (s_hashtable *h, u_form *key, u_form *value)
 {
-        long index = hashtable_index(h, key);
-        u_form *a = h->buckets[index];
+        long index;
+        u_form *a;
+        if (h->array)
+                return sethash_synchronized(h, key, value);
+        index = hashtable_index(h, key);
+        a = h->buckets[index];
         while (consp(a) && consp(a->cons.car)) {
                 if (equal(a->cons.car->cons.car, key)) {
                         a->cons.car->cons.cdr = value;
@@ -99,8 +299,12 @@ u_form * sethash (s_hashtable *h, u_form *key, u_form *value)
 
 int remhash (s_hashtable *h, u_form *key)
 {
-        long index = hashtable_index(h, key);
-        u_form **a = &h->buckets[index];
+        long index;
+        u_form **a;
+        if (h->array)
+                return remhash_synchronized(h, key);
+        index = hashtable_index(h, key);
+        a = &h->buckets[index];
         while (consp(*a) && consp((*a)->cons.car)) {
                 if (equal((*a)->cons.car->cons.car, key)) {
                         *a = (*a)->cons.cdr;
@@ -112,17 +316,27 @@ int remhash (s_hashtable *h, u_form *key)
         return 0;
 }
 
+/* A synchronized table is walked through the array current when
+   maphash starts, without a lock. */
 void maphash (s_hashtable *h, u_form *fun, s_env *env)
 {
+        long size = h->size;
+        u_form **buckets = h->buckets;
         long i;
-        for (i = 0; i < h->size; i++) {
-                u_form *a = h->buckets[i];
+        if (h->array) {
+                s_hashtable_array *array = hashtable_array(h);
+                size = array->size;
+                buckets = array->buckets;
+        }
+        for (i = 0; i < size; i++) {
+                u_form *a = __atomic_load_n(&buckets[i], __ATOMIC_ACQUIRE);
                 while (consp(a) && consp(a->cons.car)) {
                         u_form *k = a->cons.car->cons.car;
                         u_form *v = a->cons.car->cons.cdr;
                         u_form *args = cons(k, cons(v, nil()));
                         funcall(fun, args, env);
-                        a = a->cons.cdr;
+                        a = __atomic_load_n(&a->cons.cdr,
+                                            __ATOMIC_ACQUIRE);
                 }
         }
 }
@@ -130,6 +344,16 @@ void maphash (s_hashtable *h, u_form *fun, s_env *env)
 void clrhash (s_hashtable *h)
 {
         long i;
+        if (h->array) {
+                s_hashtable_array *a;
+                lock_stripes(h);
+                if ((a = new_hashtable_array(h->array->size))) {
+                        hashtable_publish(h, a);
+                        h->count = 0;
+                }
+                unlock_stripes(h);
+                return;
+        }
         for (i = 0; i < h->size; i++)
                 h->buckets[i] = nil();
 }
@@ -146,12 +370,24 @@ long update_hash_string (uint64 *h, s_string *s)
         return (long) *h;
 }
 
+long update_hash (uint64 *h, u_form *x);
+
+long update_hash_vector (uint64 *h, s_vector *v)
+{
+        unsigned long i;
+        update_hash_(h, &v->element_type, sizeof(v->element_type));
+        if (v->element_type != VECTOR_T)
+                return update_hash_(h, v->data, v->length *
+                                    vector_element_size(v->element_type));
+        for (i = 0; i < v->length; i++)
+                update_hash(h, vector_t(v)[i]);
+        return update_hash_(h, &v->length, sizeof(v->length));
+}
+
 long update_hash (uint64 *h, u_form *x)
 {
         if (x)
                 switch (x->type) {
-                case FORM_VALUES:
-                        return update_hash(h, value_(x));
                 case FORM_CONS:
                         update_hash_(h, &x->type, sizeof(x->type));
                         update_hash(h, x->cons.car);
@@ -188,6 +424,20 @@ long update_hash (uint64 *h, u_form *x)
                         update_hash_(h, &x->type, sizeof(x->type));
                         return update_hash_(h, &x->dbl.dbl,
                                             sizeof(x->dbl.dbl));
+                case FORM_VECTOR:
+                        update_hash_(h, &x->type, sizeof(x->type));
+                        return update_hash_vector(h, &x->vector);
+                case FORM_CHARACTER:
+                        update_hash_(h, &x->type, sizeof(x->type));
+                        return update_hash_(h, &x->character.code,
+                                            sizeof(x->character.code));
+                case FORM_OSTREAM:
+                case FORM_THREAD:
+                case FORM_FUTURE:
+                case FORM_COROUTINE:
+                case FORM_CHANNEL:
+                        update_hash_(h, &x->type, sizeof(x->type));
+                        return update_hash_(h, &x, sizeof(u_form*));
                 default:
                         break;
                 }
@@ -204,15 +454,16 @@ long sxhash (u_form *x)
 u_form * cfun_make_hash_table (u_form *args, s_env *env)
 {
         s_long default_size = { FORM_LONG, 10 };
-        u_form *size = getf(args, (u_form*) kw("size"),
-                            (u_form*) &default_size);
+        u_form *size = getf(args, g_kw.size, (u_form*) &default_size);
         s_double default_rehash_size = { FORM_DOUBLE, 10.0 };
-        u_form *rehash_size = getf(args, (u_form*) kw("rehash-size"),
+        u_form *rehash_size = getf(args, g_kw.rehash_size,
                                    (u_form*) &default_rehash_size);
         s_double default_rehash_threshold = { FORM_DOUBLE, 1.5 };
-        u_form *rehash_threshold = getf
-                (args, (u_form*) kw("rehash-threshold"),
-                 (u_form*) &default_rehash_threshold);
+        u_form *rehash_threshold = getf(args, g_kw.rehash_threshold,
+                                        (u_form*)
+                                        &default_rehash_threshold);
+        u_form *synchronized = getf(args, g_kw.synchronized, nil());
+        s_hashtable *h;
         if (!integerp(size) || size->lng.lng < 2 ||
             !numberp(rehash_size) ||
             (integerp(rehash_size) && rehash_size->lng.lng < 1) ||
@@ -220,21 +471,20 @@ u_form * cfun_make_hash_table (u_form *args, s_env *env)
             !floatp(rehash_threshold) ||
             rehash_threshold->dbl.dbl <= 0.0)
                 error(env, "invalid arguments for make-hash-table");
-        return (u_form*) new_hashtable
-                (size->lng.lng,
-                 integerp(rehash_size) ? rehash_size->lng.lng : 0,
-                 floatp(rehash_size) ? rehash_size->dbl.dbl : 0.0,
-                 rehash_threshold->dbl.dbl);
+        h = new_hashtable(size->lng.lng,
+                          integerp(rehash_size) ? rehash_size->lng.lng : 0,
+                          floatp(rehash_size) ? rehash_size->dbl.dbl : 0.0,
+                          rehash_threshold->dbl.dbl);
+        if (synchronized != nil() && hashtable_synchronize(h))
+                return error(env, "make-hash-table: out of memory");
+        return (u_form*) h;
 }
 
 u_form * cfun_hash_table_p (u_form *args, s_env *env)
 {
-        static u_form *t_sym = NULL;
-        if (!t_sym)
-                t_sym = (u_form*) sym("t", NULL);
         if (!consp(args) || args->cons.cdr != nil())
                 error(env, "invalid arguments for hash-table-p");
-        return hashtablep(args->cons.car) ? t_sym : nil();
+        return hashtablep(args->cons.car) ? g_sym.t : nil();
 }
 
 u_form * cfun_hash_table_count (u_form *args, s_env *env)
@@ -283,21 +533,15 @@ u_form * cfun_gethash (u_form *args, s_env *env)
 {
         s_hashtable *h;
         u_form *f;
-        s_values *v = new_values(2);
         if (!consp(args) || !consp(args->cons.cdr) ||
             !hashtablep(args->cons.cdr->cons.car) ||
             args->cons.cdr->cons.cdr != nil())
                 error(env, "invalid arguments for gethash");
         h = &args->cons.cdr->cons.car->hashtable;
         f = gethash(h, args->cons.car);
-        if (!f) {
-                values_(v)[0] = nil();
-                values_(v)[1] = nil();
-        } else {
-                values_(v)[0] = f;
-                values_(v)[1] = (u_form*) sym("t", NULL);
-        }
-        return (u_form*) v;
+        env->values_count = 2;
+        env->values[1] = f ? g_sym.t : nil();
+        return f ? f : nil();
 }
 
 u_form * cfun_sethash (u_form *args, s_env *env)
@@ -314,16 +558,13 @@ u_form * cfun_sethash (u_form *args, s_env *env)
 
 u_form * cfun_remhash (u_form *args, s_env *env)
 {
-        static u_form *t_sym = NULL;
         s_hashtable *h;
-        if (!t_sym)
-                t_sym = (u_form*) sym("t", NULL);
         if (!consp(args) || !consp(args->cons.cdr) ||
             !hashtablep(args->cons.cdr->cons.car) ||
             args->cons.cdr->cons.cdr != nil())
                 error(env, "invalid arguments for remhash");
         h = &args->cons.cdr->cons.car->hashtable;
-        return remhash(h, args->cons.car) ? t_sym : nil();
+        return remhash(h, args->cons.car) ? g_sym.t : nil();
 }
 
 u_form * cfun_maphash (u_form *args, s_env *env)
@@ -1,8 +1,24 @@
 #ifndef HASHTABLE_H
 #define HASHTABLE_H
 
+#include <pthread.h>
 #include "typedefs.h"
 
+#define HASHTABLE_STRIPES 64
+
+/* The buckets of a synchronized table, replaced as a whole when it
+   grows so that a reader never sees a size that does not match its
+   buckets. */
+struct hashtable_array {
+  long        size;
+  u_form    **buckets;
+};
+
+/* A synchronized table has an array and locks: gethash takes no
+   lock, writers lock the stripe of their bucket and a resize takes
+   every stripe. Buckets are only changed by publishing a new cell
+   at their head or unlinking one, so a reader walking them always
+   sees a list. */
 struct hashtable {
   e_form_type type;
   long        count;
@@ -11,12 +27,15 @@ struct hashtable {
   double      rehash_size_double;
   double      rehash_threshold;
   u_form    **buckets;
+  s_hashtable_array *array;
+  pthread_mutex_t   *locks;
 };
 
 s_hashtable * new_hashtable (long size,
                              long rehash_size_long,
                              double rehash_size_double,
                              double rehash_threshold);
+int          hashtable_synchronize (s_hashtable *h);
 int               hashtable_rehash (s_hashtable *h);
 u_form *       gethash (s_hashtable *h, u_form *key);
 u_form *       sethash (s_hashtable *h, u_form *key, u_form *value);
@@ -41,6 +41,14 @@
   (prog1 (first place)
     (setq place (rest place))))
 
+(defmacro setf (place value)
+  (cond ((atom place) (list 'setq place value))
+        ((eq (first place) 'aref)
+         (list 'aset (second place) (third place) value))
+        ((eq (first place) 'gethash)
+         (list 'sethash (second place) (third place) value))
+        (t (error "setf: unsupported place"))))
+
 (defun nreconc (x y)
   (do ((first (cdr x) (if (endp first) first (cdr first)))
        (second x first)
@@ -1,5 +1,6 @@
 
 #include <stdlib.h>
+#include "alloc.h"
 #include "backtrace.h"
 #include "block.h"
 #include "env.h"
@@ -7,6 +8,7 @@
 #include "eval.h"
 #include "lambda.h"
 #include "package.h"
+#include "symbols.h"
 #include "unwind_protect.h"
 
 int check_lambda_list (u_form *lambda_list, s_env *env)
@@ -28,13 +30,15 @@ s_lambda * new_lambda (s_symbol *lambda_type, s_symbol *name,
         s_lambda *l;
         if (check_lambda_list(lambda_list, env))
                 return NULL;
-        if ((l = malloc(sizeof(s_lambda)))) {
+        alloc_track(FORM_LAMBDA, sizeof(s_lambda));
+        if ((l = alloc(sizeof(s_lambda)))) {
                 l->type = FORM_LAMBDA;
                 l->lambda_type = lambda_type;
                 l->name = name;
                 l->lambda_list = lambda_list;
                 l->body = body;
                 l->frame = env->frame;
+                l->stats = NULL;
         }
         return l;
 }
@@ -74,7 +78,7 @@ u_form * funcall_lambda (s_lambda *lambda, u_form *args, s_env *env)
                 s_symbol *s = &f->cons.car->symbol;
                 if (!symbolp(f->cons.car))
                         return error(env, "invalid lambda list");
-                if (s == sym("&rest", NULL))
+                if (f->cons.car == g_sym.rest)
                         rest = 1;
                 else if (rest) {
                         if (f->cons.cdr != nil())
@@ -0,0 +1,152 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "ostream.h"
+
+/* The string sink keeps room for the string header in front of the
+   characters so that ostream_string needs no copy. */
+#define OSTREAM_HEADER sizeof(s_string)
+
+void ostream_init_string (s_ostream *os)
+{
+        os->type = FORM_OSTREAM;
+        os->sink = OSTREAM_STRING;
+        os->size = OSTREAM_SIZE;
+        os->buf = malloc(OSTREAM_HEADER + os->size + 1);
+        assert(os->buf);
+        os->buf += OSTREAM_HEADER;
+        os->len = 0;
+        os->fp = NULL;
+        os->fd = -1;
+        os->error = 0;
+}
+
+void ostream_init_file (s_ostream *os, FILE *fp)
+{
+        os->type = FORM_OSTREAM;
+        os->sink = OSTREAM_FILE;
+        os->buf = os->inline_buf;
+        os->size = OSTREAM_SIZE;
+        os->len = 0;
+        os->fp = fp;
+        os->fd = -1;
+        os->error = 0;
+}
+
+void ostream_init_fd (s_ostream *os, int fd)
+{
+        ostream_init_file(os, NULL);
+        os->sink = OSTREAM_FD;
+        os->fd = fd;
+}
+
+static void ostream_out (s_ostream *os, const char *s, unsigned long len)
+{
+        if (os->sink == OSTREAM_FILE) {
+                if (fwrite(s, 1, len, os->fp) != len)
+                        os->error = 1;
+                return;
+        }
+        while (len) {
+                ssize_t r = write(os->fd, s, len);
+                if (r < 0 && errno == EINTR)
+                        continue;
+                if (r <= 0) {
+                        os->error = 1;
+                        return;
+                }
+                s += r;
+                len -= r;
+        }
+}
+
+/* Makes room for len more bytes, or flushes. */
+static void ostream_reserve (s_ostream *os, unsigned long len)
+{
+        if (os->sink == OSTREAM_STRING) {
+                unsigned long size = os->size;
+                char *buf;
+                while (os->len + len > size)
+                        size *= 2;
+                buf = realloc(os->buf - OSTREAM_HEADER,
+                              OSTREAM_HEADER + size + 1);
+                assert(buf);
+                os->buf = buf + OSTREAM_HEADER;
+                os->size = size;
+        }
+        else
+                ostream_flush(os);
+}
+
+void ostream_flush (s_ostream *os)
+{
+        if (os->sink == OSTREAM_STRING || !os->len)
+                return;
+        ostream_out(os, os->buf, os->len);
+        os->len = 0;
+}
+
+void ostream_write (s_ostream *os, const char *s, unsigned long len)
+{
+        if (os->len + len > os->size) {
+                ostream_reserve(os, len);
+                if (len > os->size) {
+                        ostream_out(os, s, len);
+                        return;
+                }
+        }
+        memcpy(os->buf + os->len, s, len);
+        os->len += len;
+}
+
+void ostream_putc_ (s_ostream *os, char c)
+{
+        ostream_reserve(os, 1);
+        os->buf[os->len++] = c;
+}
+
+void ostream_free (s_ostream *os)
+{
+        if (os->sink == OSTREAM_STRING && os->buf)
+                free(os->buf - OSTREAM_HEADER);
+        os->buf = NULL;
+        os->len = os->size = 0;
+}
+
+/* Returns the characters written to a string sink as a string,
+   which takes over the buffer. */
+s_string * ostream_string (s_ostream *os)
+{
+        s_string *s;
+        assert(os->sink == OSTREAM_STRING);
+        s = realloc(os->buf - OSTREAM_HEADER,
+                    OSTREAM_HEADER + os->len + 1);
+        assert(s);
+        init_string_ref(s, os->len, (char*) (s + 1));
+        s->str[os->len] = 0;
+        os->buf = NULL;
+        os->len = os->size = 0;
+        return s;
+}
+
+void ostream_long (s_ostream *os, long x)
+{
+        char buf[24];
+        char *p = buf + sizeof(buf);
+        unsigned long u = x < 0 ? -(unsigned long) x : (unsigned long) x;
+        do {
+                *--p = '0' + u % 10;
+                u /= 10;
+        } while (u);
+        if (x < 0)
+                *--p = '-';
+        ostream_write(os, p, buf + sizeof(buf) - p);
+}
+
+void ostream_double (s_ostream *os, double x)
+{
+        char buf[32];
+        int len = snprintf(buf, sizeof(buf), "%g", x);
+        ostream_write(os, buf, len);
+}
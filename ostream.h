@@ -0,0 +1,53 @@
+#ifndef OSTREAM_H
+#define OSTREAM_H
+
+#include <stdio.h>
+#include <string.h>
+#include "form.h"
+
+#define OSTREAM_SIZE 4096
+
+typedef enum ostream_sink {
+        OSTREAM_STRING,
+        OSTREAM_FILE,
+        OSTREAM_FD
+} e_ostream_sink;
+
+typedef struct ostream s_ostream;
+
+/* Buffered output. FILE and fd sinks write through the buffer inside
+   the struct, so an ostream on the stack prints without allocating;
+   the string sink grows a heap buffer that becomes the string. A
+   heap allocated string sink is also a Lisp string output stream. */
+struct ostream {
+        e_form_type type;
+        e_ostream_sink sink;
+        char *buf;
+        unsigned long len;
+        unsigned long size;
+        FILE *fp;
+        int fd;
+        int error;
+        char inline_buf[OSTREAM_SIZE];
+};
+
+void        ostream_init_string (s_ostream *os);
+void        ostream_init_file (s_ostream *os, FILE *fp);
+void        ostream_init_fd (s_ostream *os, int fd);
+void        ostream_flush (s_ostream *os);
+void        ostream_free (s_ostream *os);
+s_string *  ostream_string (s_ostream *os);
+void        ostream_write (s_ostream *os, const char *s,
+                           unsigned long len);
+void        ostream_putc_ (s_ostream *os, char c);
+void        ostream_long (s_ostream *os, long x);
+void        ostream_double (s_ostream *os, double x);
+
+#define ostream_putc(os, c)                                     \
+        ((os)->len < (os)->size ?                               \
+         (void) ((os)->buf[(os)->len++] = (c)) :                \
+         ostream_putc_((os), (c)))
+
+#define ostream_puts(os, s) ostream_write((os), (s), strlen(s))
+
+#endif
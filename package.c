@@ -3,15 +3,20 @@
 #ifdef HAVE_ALLOCA_H
 #include <alloca.h>
 #endif
+#include <assert.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #define __USE_MISC 1
 #include <math.h>
+#include "city.h"
 #include "compare.h"
 #include "env.h"
+#include "error.h"
 #include "eval.h"
 #include "form.h"
 #include "package.h"
+#include "symbols.h"
 
 s_package * common_lisp_package ()
 {
@@ -40,6 +45,7 @@ s_package * cfacts_package ()
                 s_symbol *sym = make_symbol("cfacts", NULL);
                 pkg = new_package(sym);
                 push(pkg->uses, (u_form*) common_lisp_package());
+                g_package_generation++;
         }
         return pkg;
 }
@@ -52,49 +58,210 @@ s_symbol * make_symbol (const char *name, s_package *pkg)
         return sym;
 }
 
-s_symbol * find_symbol (s_string *s, s_package *pkg)
+unsigned long g_package_generation = 0;
+
+/* Guards the symbol tables, use lists and registry of all packages.
+   Functions that signal errors release it first. */
+static pthread_mutex_t g_package_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void package_lock ()
 {
-        s_symbol sym;
-        s_skiplist_node *n;
+        pthread_mutex_lock(&g_package_mutex);
+}
+
+static void package_unlock ()
+{
+        pthread_mutex_unlock(&g_package_mutex);
+}
+
+#define SYMBOL_TABLE_MIN_SIZE 16
+
+void symbol_table_init (s_symbol_table *t)
+{
+        t->size = 0;
+        t->count = 0;
+        t->entries = NULL;
+}
+
+void symbol_table_clear (s_symbol_table *t)
+{
+        if (t->count) {
+                memset(t->entries, 0, t->size * sizeof(s_symbol_entry));
+                t->count = 0;
+        }
+}
+
+static unsigned long symbol_hash (s_string *s)
+{
+        return CityHash64(string_str(s), s->length);
+}
+
+s_symbol * symbol_table_find (s_symbol_table *t, s_string *s,
+                              unsigned long hash)
+{
+        unsigned long mask = t->size - 1;
+        unsigned long i;
+        s_symbol_entry *e;
+        if (!t->count)
+                return NULL;
+        for (i = hash & mask; (e = t->entries + i)->symbol;
+             i = (i + 1) & mask)
+                if (e->hash == hash &&
+                    e->symbol->string->length == s->length &&
+                    !memcmp(string_str(e->symbol->string), string_str(s),
+                            s->length))
+                        return e->symbol;
+        return NULL;
+}
+
+static void symbol_table_put (s_symbol_table *t, s_symbol *sym,
+                              unsigned long hash)
+{
+        unsigned long mask = t->size - 1;
+        unsigned long i = hash & mask;
+        while (t->entries[i].symbol)
+                i = (i + 1) & mask;
+        t->entries[i].hash = hash;
+        t->entries[i].symbol = sym;
+        t->count++;
+}
+
+/* Keeps the table at most half full. */
+void symbol_table_insert (s_symbol_table *t, s_symbol *sym,
+                          unsigned long hash)
+{
+        if ((t->count + 1) * 2 > t->size) {
+                s_symbol_entry *old = t->entries;
+                unsigned long old_size = t->size;
+                unsigned long i;
+                t->size = old_size ? old_size * 2 : SYMBOL_TABLE_MIN_SIZE;
+                t->entries = calloc(t->size, sizeof(s_symbol_entry));
+                assert(t->entries);
+                t->count = 0;
+                for (i = 0; i < old_size; i++)
+                        if (old[i].symbol)
+                                symbol_table_put(t, old[i].symbol,
+                                                 old[i].hash);
+                free(old);
+        }
+        symbol_table_put(t, sym, hash);
+}
+
+/* Removes by shifting back the entries that follow in the probe
+   sequence, so that lookups need no tombstones. */
+void symbol_table_remove (s_symbol_table *t, s_string *s,
+                          unsigned long hash)
+{
+        unsigned long mask = t->size - 1;
+        unsigned long i;
+        unsigned long j;
+        unsigned long home;
+        s_symbol *sym = symbol_table_find(t, s, hash);
+        if (!sym)
+                return;
+        for (i = hash & mask; t->entries[i].symbol != sym;
+             i = (i + 1) & mask)
+                ;
+        for (j = (i + 1) & mask; t->entries[j].symbol;
+             j = (j + 1) & mask) {
+                home = t->entries[j].hash & mask;
+                if (((j - home) & mask) >= ((j - i) & mask)) {
+                        t->entries[i] = t->entries[j];
+                        i = j;
+                }
+        }
+        t->entries[i].symbol = NULL;
+        t->count--;
+}
+
+/* Symbols present in pkg, then external symbols of the packages it
+   uses. */
+static s_symbol * find_symbol_hash (s_string *s, unsigned long hash,
+                                    s_package *pkg)
+{
+        s_symbol *sym;
         u_form *p;
-        sym.type = FORM_SYMBOL;
-        sym.package = pkg;
-        sym.string = s;
-        n = skiplist_find(pkg->symbols, &sym);
-        if (n)
-                return n->value;
-        p = pkg->uses;
-        while (consp(p)) {
-                s_symbol *found = find_symbol(s, &p->cons.car->package);
-                if (found)
-                        return found;
-                p = p->cons.cdr;
+        if ((sym = symbol_table_find(&pkg->symbols, s, hash)))
+                return sym;
+        if (!consp(pkg->uses))
+                return NULL;
+        if (pkg->generation != g_package_generation) {
+                symbol_table_clear(&pkg->inherited);
+                pkg->generation = g_package_generation;
         }
+        else if ((sym = symbol_table_find(&pkg->inherited, s, hash)))
+                return sym;
+        for (p = pkg->uses; consp(p); p = p->cons.cdr)
+                if ((sym = symbol_table_find(&p->cons.car->package.external,
+                                             s, hash))) {
+                        symbol_table_insert(&pkg->inherited, sym, hash);
+                        return sym;
+                }
         return NULL;
 }
 
+s_symbol * find_symbol (s_string *s, s_package *pkg)
+{
+        unsigned long hash = symbol_hash(s);
+        s_symbol *sym;
+        package_lock();
+        sym = find_symbol_hash(s, hash, pkg);
+        package_unlock();
+        return sym;
+}
+
+/* The symbol named s accessible in pkg, status telling whether it is
+   :internal or :external there or :inherited from a used package. */
+s_symbol * find_symbol_status (s_string *s, s_package *pkg,
+                               u_form **status)
+{
+        unsigned long hash = symbol_hash(s);
+        s_symbol *sym;
+        package_lock();
+        if ((sym = symbol_table_find(&pkg->symbols, s, hash)))
+                *status = symbol_table_find(&pkg->external, s, hash) ?
+                        g_kw.external : g_kw.internal;
+        else if ((sym = find_symbol_hash(s, hash, pkg)))
+                *status = g_kw.inherited;
+        package_unlock();
+        return sym;
+}
+
+s_symbol * find_external_symbol (s_string *s, s_package *pkg)
+{
+        unsigned long hash = symbol_hash(s);
+        s_symbol *sym;
+        package_lock();
+        sym = symbol_table_find(&pkg->external, s, hash);
+        package_unlock();
+        return sym;
+}
+
+int symbol_external_p (s_symbol *sym, s_package *pkg)
+{
+        return find_external_symbol(sym->string, pkg) == sym;
+}
+
 s_symbol * find_symbol_ (const char *s, s_package *pkg)
 {
-        unsigned long len = strlen(s);
-        s_string *str = alloca(sizeof(s_string) + len + 1);
-        init_string(str, len, s);
-        return find_symbol(str, pkg);
+        s_string str;
+        init_string_ref(&str, strlen(s), s);
+        return find_symbol(&str, pkg);
 }
 
 s_symbol * intern (s_string *s, s_package *pkg)
 {
         s_symbol *sym;
+        unsigned long hash = symbol_hash(s);
         if (!pkg)
                 pkg = cfacts_package();
-        if (pkg) {
-                sym = find_symbol(s, pkg);
-                if (sym)
-                        return sym;
+        package_lock();
+        if (!(sym = find_symbol_hash(s, hash, pkg))) {
+                sym = new_symbol(s);
+                sym->package = pkg;
+                symbol_table_insert(&pkg->symbols, sym, hash);
         }
-        sym = new_symbol(s);
-        sym->package = pkg;
-        if (pkg)
-                skiplist_insert(pkg->symbols, sym);
+        package_unlock();
         return sym;
 }
 
@@ -108,6 +275,26 @@ s_symbol * intern_ (const char *s, s_package *pkg)
         return intern(str, pkg);
 }
 
+/* Looks up a name that is not NUL-terminated, such as a token in the
+   reader's buffer, and only allocates a string to intern a new
+   symbol. */
+s_symbol * intern_slice (const char *s, unsigned long len, s_package *pkg)
+{
+        s_string str;
+        s_symbol *sym;
+        unsigned long hash;
+        init_string_ref(&str, len, s);
+        hash = symbol_hash(&str);
+        package_lock();
+        if (!(sym = find_symbol_hash(&str, hash, pkg))) {
+                sym = new_symbol(new_string(len, s));
+                sym->package = pkg;
+                symbol_table_insert(&pkg->symbols, sym, hash);
+        }
+        package_unlock();
+        return sym;
+}
+
 s_symbol * sym (const char *s, s_env *env)
 {
         s_package *pkg;
@@ -126,18 +313,184 @@ s_symbol * kw (const char *s)
 
 void unintern (s_string *s, s_package *pkg)
 {
-        s_symbol sym;
+        unsigned long hash = symbol_hash(s);
         if (!pkg)
                 pkg = cfacts_package();
-        sym.type = FORM_SYMBOL;
-        sym.package = pkg;
-        sym.string = s;
-        skiplist_delete(pkg->symbols, &sym);
+        package_lock();
+        symbol_table_remove(&pkg->symbols, s, hash);
+        symbol_table_remove(&pkg->external, s, hash);
+        g_package_generation++;
+        package_unlock();
 }
 
-void delete_package (s_package *pkg)
+/* Exporting an inherited symbol imports it first. */
+void export_symbol (s_symbol *sym, s_package *pkg, s_env *env)
 {
-        (void) pkg;
+        unsigned long hash = symbol_hash(sym->string);
+        package_lock();
+        if (find_symbol_hash(sym->string, hash, pkg) != sym) {
+                package_unlock();
+                error(env, "export: %s is not accessible in package %s",
+                      string_cstr(sym->string),
+                      string_cstr(pkg->name->string));
+        }
+        if (!symbol_table_find(&pkg->symbols, sym->string, hash))
+                symbol_table_insert(&pkg->symbols, sym, hash);
+        if (!symbol_table_find(&pkg->external, sym->string, hash))
+                symbol_table_insert(&pkg->external, sym, hash);
+        package_unlock();
+}
+
+/* Exports every symbol present in pkg, as common-lisp does with
+   the builtins and init.lisp. */
+void export_present_symbols (s_package *pkg)
+{
+        unsigned long i;
+        s_symbol_entry *e;
+        package_lock();
+        for (i = 0; i < pkg->symbols.size; i++) {
+                e = pkg->symbols.entries + i;
+                if (e->symbol &&
+                    !symbol_table_find(&pkg->external, e->symbol->string,
+                                       e->hash))
+                        symbol_table_insert(&pkg->external, e->symbol,
+                                            e->hash);
+        }
+        package_unlock();
+}
+
+void import_symbol (s_symbol *sym, s_package *pkg, s_env *env)
+{
+        unsigned long hash = symbol_hash(sym->string);
+        s_symbol *found;
+        package_lock();
+        found = find_symbol_hash(sym->string, hash, pkg);
+        if (found && found != sym) {
+                package_unlock();
+                error(env, "import: %s conflicts with a symbol accessible "
+                      "in package %s", string_cstr(sym->string),
+                      string_cstr(pkg->name->string));
+        }
+        if (!symbol_table_find(&pkg->symbols, sym->string, hash))
+                symbol_table_insert(&pkg->symbols, sym, hash);
+        if (!sym->package)
+                sym->package = pkg;
+        package_unlock();
+}
+
+static int shadowed_p (s_symbol *sym, s_package *pkg)
+{
+        u_form *s;
+        for (s = pkg->shadowing; consp(s); s = s->cons.cdr)
+                if (s->cons.car == (u_form*) sym)
+                        return 1;
+        return 0;
+}
+
+/* Makes name denote a symbol present in pkg, hiding any symbol of
+   that name it inherits. */
+s_symbol * shadow (s_string *name, s_package *pkg)
+{
+        unsigned long hash = symbol_hash(name);
+        s_symbol *sym;
+        package_lock();
+        if (!(sym = symbol_table_find(&pkg->symbols, name, hash))) {
+                sym = new_symbol(new_string(name->length,
+                                            string_str(name)));
+                sym->package = pkg;
+                symbol_table_insert(&pkg->symbols, sym, hash);
+        }
+        if (!shadowed_p(sym, pkg))
+                push(pkg->shadowing, (u_form*) sym);
+        package_unlock();
+        return sym;
+}
+
+/* Fails if an external symbol of used has the name of another
+   symbol accessible in pkg that is not shadowing it. */
+void use_package (s_package *used, s_package *pkg, s_env *env)
+{
+        u_form **tail = &pkg->uses;
+        unsigned long i;
+        s_symbol_entry *e;
+        s_symbol *found;
+        package_lock();
+        while (consp(*tail)) {
+                if (&(*tail)->cons.car->package == used) {
+                        package_unlock();
+                        return;
+                }
+                tail = &(*tail)->cons.cdr;
+        }
+        for (i = 0; i < used->external.size; i++) {
+                e = used->external.entries + i;
+                if (!e->symbol)
+                        continue;
+                found = find_symbol_hash(e->symbol->string, e->hash, pkg);
+                if (found && found != e->symbol &&
+                    !shadowed_p(found, pkg)) {
+                        package_unlock();
+                        error(env, "use-package: %s of package %s "
+                              "conflicts with %s accessible in package %s",
+                              string_cstr(e->symbol->string),
+                              string_cstr(used->name->string),
+                              string_cstr(found->string),
+                              string_cstr(pkg->name->string));
+                }
+        }
+        *tail = cons((u_form*) used, nil());
+        g_package_generation++;
+        package_unlock();
+}
+
+s_package * make_package (s_string *name, u_form *uses, s_env *env)
+{
+        s_symbol search;
+        s_package *pkg;
+        search.type = FORM_SYMBOL;
+        search.package = NULL;
+        search.string = name;
+        pkg = new_package(make_symbol(string_cstr(name), NULL));
+        for (; consp(uses); uses = uses->cons.cdr)
+                use_package(&uses->cons.car->package, pkg, env);
+        package_lock();
+        if (find_package(&search, env)) {
+                package_unlock();
+                error(env, "make-package: a package named %s exists",
+                      string_cstr(name));
+        }
+        skiplist_insert(env->packages, pkg);
+        package_unlock();
+        return pkg;
+}
+
+/* Removes pkg from the registry and from the use lists of the other
+   packages, and leaves the symbols it owns without a home. */
+void delete_package (s_package *pkg, s_env *env)
+{
+        s_skiplist_node *n;
+        u_form **p;
+        unsigned long i;
+        s_symbol *sym;
+        if (pkg == common_lisp_package() || pkg == cfacts_package() ||
+            pkg == keyword_package())
+                error(env, "delete-package: cannot delete package %s",
+                      string_cstr(pkg->name->string));
+        package_lock();
+        for (n = skiplist_node_next(env->packages->head, 0); n;
+             n = skiplist_node_next(n, 0))
+                for (p = &((s_package*) n->value)->uses; consp(*p); )
+                        if (&(*p)->cons.car->package == pkg)
+                                *p = (*p)->cons.cdr;
+                        else
+                                p = &(*p)->cons.cdr;
+        skiplist_delete(env->packages, pkg);
+        for (i = 0; i < pkg->symbols.size; i++)
+                if ((sym = pkg->symbols.entries[i].symbol) &&
+                    sym->package == pkg)
+                        sym->package = NULL;
+        g_package_generation++;
+        package_unlock();
 }
 
 s_package * find_package (s_symbol *name, s_env *env)
@@ -160,16 +513,159 @@ void init_packages (s_env *env)
         skiplist_insert(env->packages, keyword_package());
 }
 
+/* The value of *package*, through the binding cached in env. */
 s_package * package (s_env *env)
 {
-        static s_symbol *package_sym = NULL;
-        u_form *f;
-        if (!package_sym)
-                package_sym = sym("*package*", NULL);
-        f = eval((u_form*) package_sym, env);
-        if (f->type != FORM_PACKAGE) {
-                f = (u_form*) cfacts_package();
-                setq(package_sym, f, env);
+        u_form **f;
+        unsigned long bindings = __atomic_load_n(&g_package_bindings,
+                                                 __ATOMIC_RELAXED);
+        if (env->package_frame != env->frame ||
+            env->package_bindings != bindings) {
+                env->package_binding =
+                        symbol_variable(&g_sym.package_var->symbol, env);
+                env->package_frame = env->frame;
+                env->package_bindings = bindings;
         }
-        return &f->package;
+        if (!(f = env->package_binding))
+                error(env, "symbol not bound: *package*");
+        if ((*f)->type != FORM_PACKAGE)
+                *f = (u_form*) cfacts_package();
+        return &(*f)->package;
+}
+
+/* A package, or the symbol or string naming one. */
+s_package * package_designator (u_form *x, const char *fname,
+                                s_env *env)
+{
+        s_symbol search;
+        s_package *pkg;
+        if (packagep(x))
+                return &x->package;
+        search.type = FORM_SYMBOL;
+        search.package = NULL;
+        if (symbolp(x))
+                search.string = x->symbol.string;
+        else if (stringp(x))
+                search.string = &x->string;
+        else
+                error(env, "%s: not a package designator", fname);
+        if (!(pkg = find_package(&search, env)))
+                error(env, "%s: no package named %s", fname,
+                      string_cstr(search.string));
+        return pkg;
+}
+
+static s_string * string_designator (u_form *x, const char *fname,
+                                     s_env *env)
+{
+        if (symbolp(x))
+                return x->symbol.string;
+        if (stringp(x))
+                return &x->string;
+        error(env, "%s: not a string designator", fname);
+        return NULL;
+}
+
+/* The list of designators, or a single one as a list. */
+static u_form * designator_list (u_form *x)
+{
+        if (listp(x))
+                return x;
+        return cons(x, nil());
+}
+
+/* The optional package argument after the first one. */
+static s_package * package_arg (u_form *args, const char *fname,
+                                s_env *env)
+{
+        if (!consp(args) ||
+            (args->cons.cdr != nil() &&
+             (!consp(args->cons.cdr) || cddr(args) != nil())))
+                error(env, "invalid arguments for %s", fname);
+        if (consp(args->cons.cdr))
+                return package_designator(cadr(args), fname, env);
+        return package(env);
+}
+
+/* (make-package name &key use) uses common-lisp by default. */
+u_form * cfun_make_package (u_form *args, s_env *env)
+{
+        u_form *uses;
+        u_form *u;
+        u_form *pkgs = nil();
+        if (!consp(args))
+                return error(env, "invalid arguments for make-package");
+        uses = getf(args->cons.cdr, g_kw.use,
+                    cons((u_form*) common_lisp_package(), nil()));
+        for (u = designator_list(uses); consp(u); u = u->cons.cdr)
+                pkgs = cons((u_form*) package_designator
+                            (u->cons.car, "make-package", env), pkgs);
+        return (u_form*) make_package
+                (string_designator(args->cons.car, "make-package", env),
+                 reverse(pkgs), env);
+}
+
+u_form * cspecial_in_package (u_form *args, s_env *env)
+{
+        s_package *pkg;
+        if (!consp(args) || args->cons.cdr != nil())
+                return error(env, "invalid arguments for in-package");
+        pkg = package_designator(args->cons.car, "in-package", env);
+        return setq(&g_sym.package_var->symbol, (u_form*) pkg, env);
+}
+
+u_form * cfun_export (u_form *args, s_env *env)
+{
+        s_package *pkg = package_arg(args, "export", env);
+        u_form *s;
+        for (s = designator_list(args->cons.car); consp(s);
+             s = s->cons.cdr) {
+                if (!symbolp(s->cons.car))
+                        return error(env, "export: not a symbol");
+                export_symbol(&s->cons.car->symbol, pkg, env);
+        }
+        return g_sym.t;
+}
+
+u_form * cfun_import (u_form *args, s_env *env)
+{
+        s_package *pkg = package_arg(args, "import", env);
+        u_form *s;
+        for (s = designator_list(args->cons.car); consp(s);
+             s = s->cons.cdr) {
+                if (!symbolp(s->cons.car))
+                        return error(env, "import: not a symbol");
+                import_symbol(&s->cons.car->symbol, pkg, env);
+        }
+        return g_sym.t;
+}
+
+u_form * cfun_use_package (u_form *args, s_env *env)
+{
+        s_package *pkg = package_arg(args, "use-package", env);
+        u_form *p;
+        for (p = designator_list(args->cons.car); consp(p);
+             p = p->cons.cdr)
+                use_package(package_designator(p->cons.car, "use-package",
+                                               env), pkg, env);
+        return g_sym.t;
+}
+
+u_form * cfun_shadow (u_form *args, s_env *env)
+{
+        s_package *pkg = package_arg(args, "shadow", env);
+        u_form *s;
+        for (s = designator_list(args->cons.car); consp(s);
+             s = s->cons.cdr)
+                shadow(string_designator(s->cons.car, "shadow", env), pkg);
+        return g_sym.t;
+}
+
+u_form * cfun_delete_package (u_form *args, s_env *env)
+{
+        if (!consp(args) || args->cons.cdr != nil())
+                return error(env, "invalid arguments for delete-package");
+        delete_package(package_designator(args->cons.car,
+                                          "delete-package", env), env);
+        return g_sym.t;
 }
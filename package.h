@@ -3,6 +3,17 @@
 
 #include "form.h"
 
+extern unsigned long g_package_generation;
+
+void       symbol_table_init (s_symbol_table *t);
+void       symbol_table_clear (s_symbol_table *t);
+s_symbol * symbol_table_find (s_symbol_table *t, s_string *s,
+                              unsigned long hash);
+void       symbol_table_insert (s_symbol_table *t, s_symbol *sym,
+                                unsigned long hash);
+void       symbol_table_remove (s_symbol_table *t, s_string *s,
+                                unsigned long hash);
+
 s_package * common_lisp_package ();
 s_package *     keyword_package ();
 s_package *      cfacts_package ();
@@ -10,14 +21,37 @@ s_package *      cfacts_package ();
 s_symbol * make_symbol (const char *name, s_package *pkg);
 s_symbol * find_symbol (s_string *s, s_package *pkg);
 s_symbol * find_symbol_ (const char *s, s_package *pkg);
+s_symbol * find_symbol_status (s_string *s, s_package *pkg,
+                               u_form **status);
+s_symbol * find_external_symbol (s_string *s, s_package *pkg);
+int        symbol_external_p (s_symbol *sym, s_package *pkg);
 s_symbol * intern (s_string *s, s_package *pkg);
 s_symbol * intern_ (const char *s, s_package *pkg);
+s_symbol * intern_slice (const char *s, unsigned long len,
+                         s_package *pkg);
 s_symbol * sym (const char *s, s_env *env);
 s_symbol * kw (const char *s);
 void unintern (s_string *s, s_package *pkg);
+void export_symbol (s_symbol *sym, s_package *pkg, s_env *env);
+void export_present_symbols (s_package *pkg);
+void import_symbol (s_symbol *sym, s_package *pkg, s_env *env);
+s_symbol * shadow (s_string *name, s_package *pkg);
+void use_package (s_package *used, s_package *pkg, s_env *env);
 
 void          init_packages (s_env *env);
 s_package *   find_package (s_symbol *name, s_env *env);
 s_package *        package (s_env *env);
+s_package * package_designator (u_form *x, const char *fname,
+                                s_env *env);
+s_package *   make_package (s_string *name, u_form *uses, s_env *env);
+void        delete_package (s_package *pkg, s_env *env);
+
+u_form * cfun_make_package (u_form *args, s_env *env);
+u_form * cspecial_in_package (u_form *args, s_env *env);
+u_form * cfun_export (u_form *args, s_env *env);
+u_form * cfun_import (u_form *args, s_env *env);
+u_form * cfun_use_package (u_form *args, s_env *env);
+u_form * cfun_shadow (u_form *args, s_env *env);
+u_form * cfun_delete_package (u_form *args, s_env *env);
 
 #endif
@@ -0,0 +1,541 @@
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "alloc.h"
+#include "error.h"
+#include "eval.h"
+#include "pool.h"
+#include "profile.h"
+#include "sequence.h"
+#include "symbols.h"
+
+#define POOL_DEQUE_MASK (POOL_DEQUE_SIZE - 1)
+
+/* Workers started, the first g_pool_size of which take work. Idle
+   workers sleep on g_pool_wake, the others on g_pool_resize;
+   g_pool_work counts the tasks made available so that a worker
+   about to sleep can tell it missed some. */
+static pthread_mutex_t g_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_pool_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t g_pool_resize = PTHREAD_COND_INITIALIZER;
+static s_pool_worker *g_pool_workers[POOL_MAX_WORKERS];
+static unsigned long g_pool_started = 0;
+static unsigned long g_pool_size = 0;
+static unsigned long g_pool_work = 0;
+static unsigned long g_pool_sleepers = 0;
+static s_pool_task *g_pool_injected = NULL;
+static __thread s_pool_worker *g_pool_self = NULL;
+
+static int deque_push (s_pool_deque *d, s_pool_task *task)
+{
+        long b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+        long t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+        if (b - t >= POOL_DEQUE_SIZE)
+                return -1;
+        __atomic_store_n(&d->tasks[b & POOL_DEQUE_MASK], task,
+                         __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+        return 0;
+}
+
+static s_pool_task * deque_pop (s_pool_deque *d)
+{
+        long b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+        long t;
+        s_pool_task *task = NULL;
+        __atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        t = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+        if (t > b) {
+                __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+                return NULL;
+        }
+        task = __atomic_load_n(&d->tasks[b & POOL_DEQUE_MASK],
+                               __ATOMIC_RELAXED);
+        if (t == b) {
+                if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, 0,
+                                                 __ATOMIC_SEQ_CST,
+                                                 __ATOMIC_RELAXED))
+                        task = NULL;
+                __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+        }
+        return task;
+}
+
+static s_pool_task * deque_steal (s_pool_deque *d)
+{
+        long t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+        long b;
+        s_pool_task *task;
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+        if (t >= b)
+                return NULL;
+        task = __atomic_load_n(&d->tasks[t & POOL_DEQUE_MASK],
+                               __ATOMIC_RELAXED);
+        if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, 0,
+                                         __ATOMIC_SEQ_CST,
+                                         __ATOMIC_RELAXED))
+                return NULL;
+        return task;
+}
+
+static s_pool_task * new_pool_task (s_pool_job *job, unsigned long start,
+                                    unsigned long end)
+{
+        s_pool_task *task = alloc(sizeof(s_pool_task));
+        if (task) {
+                task->job = job;
+                task->start = start;
+                task->end = end;
+                task->next = NULL;
+        }
+        return task;
+}
+
+static void pool_notify (void)
+{
+        __atomic_add_fetch(&g_pool_work, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&g_pool_sleepers, __ATOMIC_SEQ_CST)) {
+                pthread_mutex_lock(&g_pool_mutex);
+                pthread_cond_signal(&g_pool_wake);
+                pthread_mutex_unlock(&g_pool_mutex);
+        }
+}
+
+static void pool_push (s_pool_worker *w, s_pool_task *task)
+{
+        if (w && !deque_push(&w->deque, task)) {
+                pool_notify();
+                return;
+        }
+        pthread_mutex_lock(&g_pool_mutex);
+        task->next = g_pool_injected;
+        __atomic_store_n(&g_pool_injected, task, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&g_pool_mutex);
+        pool_notify();
+}
+
+/* Pops from the deque of w, then steals from the other workers and
+   last takes a task pushed by a thread outside the pool. Workers
+   beyond the pool size only drain their own deque. */
+static s_pool_task * pool_find_task (s_pool_worker *w)
+{
+        s_pool_task *task;
+        unsigned long started;
+        unsigned long i;
+        if ((task = deque_pop(&w->deque)))
+                return task;
+        if (w->id >= __atomic_load_n(&g_pool_size, __ATOMIC_RELAXED))
+                return NULL;
+        started = __atomic_load_n(&g_pool_started, __ATOMIC_ACQUIRE);
+        for (i = 1; i < started; i++) {
+                s_pool_worker *victim = g_pool_workers[(w->id + i) %
+                                                       started];
+                if ((task = deque_steal(&victim->deque)))
+                        return task;
+        }
+        if (!__atomic_load_n(&g_pool_injected, __ATOMIC_RELAXED))
+                return NULL;
+        pthread_mutex_lock(&g_pool_mutex);
+        if ((task = g_pool_injected))
+                __atomic_store_n(&g_pool_injected, task->next,
+                                 __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&g_pool_mutex);
+        return task;
+}
+
+static unsigned long pool_stop (s_pool_job *job)
+{
+        return __atomic_load_n(&job->stop, __ATOMIC_RELAXED);
+}
+
+static void pool_fail (s_pool_job *job, unsigned long i, s_string *error)
+{
+        pthread_mutex_lock(&job->mutex);
+        if (i < job->stop) {
+                job->error = error;
+                __atomic_store_n(&job->stop, i, __ATOMIC_RELAXED);
+        }
+        pthread_mutex_unlock(&job->mutex);
+}
+
+static void pool_done (s_pool_job *job, unsigned long n)
+{
+        pthread_mutex_lock(&job->mutex);
+        if (!__atomic_sub_fetch(&job->pending, n, __ATOMIC_RELEASE))
+                pthread_cond_broadcast(&job->done);
+        pthread_mutex_unlock(&job->mutex);
+}
+
+static u_form * list2 (u_form *a, u_form *b)
+{
+        return cons(a, cons(b, nil()));
+}
+
+static void pool_run_range (s_pool_job *job, unsigned long start,
+                            unsigned long end, s_env *env)
+{
+        s_error_handler eh;
+        s_frame *frame = env->frame;
+        s_block *blocks = env->blocks;
+        s_tags *tags = env->tags;
+        s_unwind_protect *unwind_protect = env->unwind_protect;
+        s_backtrace_frame *backtrace = env->backtrace;
+        s_error_handler *error_handler = env->error_handler;
+        volatile unsigned long i = start;
+        if (setjmp(eh.buf)) {
+                env->frame = frame;
+                env->blocks = blocks;
+                env->tags = tags;
+                env->unwind_protect = unwind_protect;
+                env->backtrace = backtrace;
+                env->error_handler = error_handler;
+                pool_fail(job, i, eh.string);
+                pool_done(job, end - start);
+                return;
+        }
+        push_error_handler(&eh, env);
+        for (; i < end && i < pool_stop(job); i++) {
+                u_form *x = job->items[i];
+                switch (job->op) {
+                case POOL_MAP:
+                        job->results[i] = funcall(job->function, x, env);
+                        break;
+                case POOL_EVERY:
+                        if (funcall(job->function, x, env) == nil())
+                                pool_fail(job, i, NULL);
+                        break;
+                case POOL_REDUCE:
+                        if (job->key)
+                                x = funcall(job->key, cons(x, nil()), env);
+                        if (i % job->grain)
+                                x = funcall(job->function,
+                                            list2(job->results[i /
+                                                               job->grain],
+                                                  x),
+                                            env);
+                        job->results[i / job->grain] = x;
+                        break;
+                }
+        }
+        pop_error_handler(env);
+        pool_done(job, end - start);
+}
+
+/* Splits off the upper half of the task while it spans more than
+   one chunk, for idle workers to steal, and runs what is left. */
+static void pool_run (s_pool_task *task, s_pool_worker *w)
+{
+        s_pool_job *job = task->job;
+        unsigned long start = task->start;
+        unsigned long end = task->end;
+        alloc_free(task, sizeof(s_pool_task));
+        while (end - start > job->grain) {
+                unsigned long chunks = (end - start + job->grain - 1) /
+                        job->grain;
+                unsigned long mid = start + chunks / 2 * job->grain;
+                s_pool_task *upper = new_pool_task(job, mid, end);
+                if (!upper || deque_push(&w->deque, upper)) {
+                        alloc_free(upper, sizeof(s_pool_task));
+                        break;
+                }
+                pool_notify();
+                end = mid;
+        }
+        pool_run_range(job, start, end, &w->env);
+}
+
+static void pool_sleep (s_pool_worker *w, unsigned long work)
+{
+        pthread_mutex_lock(&g_pool_mutex);
+        if (w->id >= g_pool_size)
+                pthread_cond_wait(&g_pool_resize, &g_pool_mutex);
+        else {
+                __atomic_add_fetch(&g_pool_sleepers, 1, __ATOMIC_SEQ_CST);
+                if (__atomic_load_n(&g_pool_work, __ATOMIC_SEQ_CST) ==
+                    work)
+                        pthread_cond_wait(&g_pool_wake, &g_pool_mutex);
+                __atomic_sub_fetch(&g_pool_sleepers, 1, __ATOMIC_SEQ_CST);
+        }
+        pthread_mutex_unlock(&g_pool_mutex);
+}
+
+static void * pool_worker_main (void *arg)
+{
+        s_pool_worker *w = arg;
+        g_pool_self = w;
+        profile_set_env(&w->env);
+        for (;;) {
+                unsigned long work = __atomic_load_n(&g_pool_work,
+                                                     __ATOMIC_SEQ_CST);
+                s_pool_task *task = pool_find_task(w);
+                if (task)
+                        pool_run(task, w);
+                else
+                        pool_sleep(w, work);
+        }
+        return NULL;
+}
+
+unsigned long pool_size (void)
+{
+        long n;
+        if (g_pool_size)
+                return g_pool_size;
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+        if (n < 1)
+                n = 1;
+        if (n > POOL_MAX_WORKERS)
+                n = POOL_MAX_WORKERS;
+        return n;
+}
+
+void set_pool_size (unsigned long size, s_env *env)
+{
+        if (size < 1 || size > POOL_MAX_WORKERS) {
+                error(env, "thread-pool-size: size must be between 1 "
+                      "and %d", POOL_MAX_WORKERS);
+                return;
+        }
+        pthread_mutex_lock(&g_pool_mutex);
+        while (g_pool_started < size) {
+                s_pool_worker *w = calloc(1, sizeof(s_pool_worker));
+                if (!w)
+                        break;
+                w->id = g_pool_started;
+                env_init_thread(&w->env, env);
+                g_pool_workers[w->id] = w;
+                if (pthread_create(&w->pthread, NULL, pool_worker_main,
+                                   w)) {
+                        free(w);
+                        break;
+                }
+                __atomic_store_n(&g_pool_started, w->id + 1,
+                                 __ATOMIC_RELEASE);
+        }
+        if (g_pool_started < size) {
+                pthread_mutex_unlock(&g_pool_mutex);
+                error(env, "thread-pool-size: cannot create thread");
+                return;
+        }
+        __atomic_store_n(&g_pool_size, size, __ATOMIC_RELAXED);
+        pthread_cond_broadcast(&g_pool_wake);
+        pthread_cond_broadcast(&g_pool_resize);
+        pthread_mutex_unlock(&g_pool_mutex);
+}
+
+/* Hands job over to the pool and returns without waiting. */
+void pool_start_job (s_pool_job *job, s_env *env)
+{
+        s_pool_task *task;
+        unsigned long chunks;
+        if (!g_pool_size)
+                set_pool_size(pool_size(), env);
+        job->grain = job->count / (g_pool_size * POOL_CHUNKS_PER_WORKER);
+        if (!job->grain)
+                job->grain = 1;
+        chunks = (job->count + job->grain - 1) / job->grain;
+        job->stop = job->count;
+        job->error = NULL;
+        job->pending = job->count;
+        if (!job->count)
+                return;
+        if (job->op == POOL_REDUCE &&
+            !(job->results = calloc(chunks, sizeof(u_form*)))) {
+                job->pending = 0;
+                error(env, "preduce: out of memory");
+                return;
+        }
+        if (!(task = new_pool_task(job, 0, job->count))) {
+                job->pending = 0;
+                error(env, "out of memory");
+                return;
+        }
+        pthread_mutex_init(&job->mutex, NULL);
+        pthread_cond_init(&job->done, NULL);
+        pool_push(g_pool_self, task);
+}
+
+int pool_job_done_p (s_pool_job *job)
+{
+        return !__atomic_load_n(&job->pending, __ATOMIC_ACQUIRE);
+}
+
+/* Waits for a started job. A worker keeps taking tasks while it
+   waits, so that the pool cannot run out of workers. */
+void pool_wait_job (s_pool_job *job)
+{
+        s_pool_worker *w = g_pool_self;
+        s_pool_task *task;
+        if (!job->count)
+                return;
+        if (w)
+                while (!pool_job_done_p(job)) {
+                        if ((task = pool_find_task(w)))
+                                pool_run(task, w);
+                        else
+                                sched_yield();
+                }
+        pthread_mutex_lock(&job->mutex);
+        while (job->pending)
+                pthread_cond_wait(&job->done, &job->mutex);
+        pthread_mutex_unlock(&job->mutex);
+}
+
+void pool_run_job (s_pool_job *job, s_env *env)
+{
+        pool_start_job(job, env);
+        pool_wait_job(job);
+        if (job->count) {
+                pthread_mutex_destroy(&job->mutex);
+                pthread_cond_destroy(&job->done);
+        }
+}
+
+/* The argument lists of a function mapped over seqs, as many as
+   there are elements in the shortest. */
+static unsigned long pool_arguments (u_form *seqs, u_form ***items,
+                                     const char *name, s_env *env)
+{
+        unsigned long n = 0;
+        unsigned long i;
+        u_form *s;
+        for (s = seqs; consp(s); s = s->cons.cdr) {
+                s_seq_iter it;
+                if (seq_iter_init(&it, s->cons.car)) {
+                        error(env, "%s: not a sequence", name);
+                        return 0;
+                }
+                if (s == seqs || (unsigned long) seq_length(s->cons.car) < n)
+                        n = seq_length(s->cons.car);
+        }
+        if (!(*items = calloc(n ? n : 1, sizeof(u_form*)))) {
+                error(env, "%s: out of memory", name);
+                return 0;
+        }
+        for (i = 0; i < n; i++)
+                (*items)[i] = nil();
+        for (s = reverse(seqs); consp(s); s = s->cons.cdr) {
+                s_seq_iter it;
+                u_form *x;
+                seq_iter_init(&it, s->cons.car);
+                for (i = 0; i < n && seq_iter_next(&it, &x); i++)
+                        (*items)[i] = cons(x, (*items)[i]);
+        }
+        return n;
+}
+
+void pool_job_init (s_pool_job *job, e_pool_op op, u_form *function,
+                    s_env *env)
+{
+        job->op = op;
+        job->function = function_designator(function, env);
+        job->key = NULL;
+        job->items = NULL;
+        job->results = NULL;
+        job->count = 0;
+}
+
+static void pool_job_clean (s_pool_job *job)
+{
+        free(job->items);
+        free(job->results);
+}
+
+/* (pmapcar function sequence &rest sequences) */
+u_form * cfun_pmapcar (u_form *args, s_env *env)
+{
+        s_pool_job job;
+        u_form *head = nil();
+        unsigned long i;
+        if (!consp(args) || !consp(args->cons.cdr))
+                return error(env, "invalid arguments for pmapcar");
+        pool_job_init(&job, POOL_MAP, args->cons.car, env);
+        job.count = pool_arguments(args->cons.cdr, &job.items, "pmapcar",
+                                   env);
+        if (!(job.results = calloc(job.count ? job.count : 1,
+                                   sizeof(u_form*)))) {
+                pool_job_clean(&job);
+                return error(env, "pmapcar: out of memory");
+        }
+        pool_run_job(&job, env);
+        if (job.stop < job.count) {
+                pool_job_clean(&job);
+                return error_(job.error, env);
+        }
+        for (i = job.count; i > 0; i--)
+                head = cons(job.results[i - 1], head);
+        pool_job_clean(&job);
+        return head;
+}
+
+/* (pevery predicate sequence &rest sequences) */
+u_form * cfun_pevery (u_form *args, s_env *env)
+{
+        s_pool_job job;
+        if (!consp(args) || !consp(args->cons.cdr))
+                return error(env, "invalid arguments for pevery");
+        pool_job_init(&job, POOL_EVERY, args->cons.car, env);
+        job.count = pool_arguments(args->cons.cdr, &job.items, "pevery",
+                                   env);
+        pool_run_job(&job, env);
+        pool_job_clean(&job);
+        if (job.stop < job.count && job.error)
+                return error_(job.error, env);
+        return job.stop < job.count ? nil() : g_sym.t;
+}
+
+/* (preduce function sequence &key key initial-value) reduces chunks
+   in parallel then their results in order, so function must be
+   associative. */
+u_form * cfun_preduce (u_form *args, s_env *env)
+{
+        s_pool_job job;
+        u_form *acc;
+        u_form *x;
+        s_seq_iter it;
+        unsigned long i;
+        if (!consp(args) || !consp(args->cons.cdr))
+                return error(env, "invalid arguments for preduce");
+        pool_job_init(&job, POOL_REDUCE, args->cons.car, env);
+        acc = getf(cddr(args), g_kw.initial_value, NULL);
+        x = getf(cddr(args), g_kw.key, nil());
+        job.key = x == nil() ? NULL : function_designator(x, env);
+        if (seq_iter_init(&it, args->cons.cdr->cons.car))
+                return error(env, "preduce: not a sequence");
+        job.count = seq_length(args->cons.cdr->cons.car);
+        if (!job.count)
+                return acc ? acc : funcall(job.function, nil(), env);
+        if (!(job.items = calloc(job.count, sizeof(u_form*))))
+                return error(env, "preduce: out of memory");
+        for (i = 0; seq_iter_next(&it, &x); i++)
+                job.items[i] = x;
+        pool_run_job(&job, env);
+        if (job.stop < job.count) {
+                pool_job_clean(&job);
+                return error_(job.error, env);
+        }
+        i = 0;
+        if (!acc)
+                acc = job.results[i++];
+        for (; i < (job.count + job.grain - 1) / job.grain; i++)
+                acc = funcall(job.function, list2(acc, job.results[i]),
+                              env);
+        pool_job_clean(&job);
+        return acc;
+}
+
+/* (thread-pool-size &optional size) */
+u_form * cfun_thread_pool_size (u_form *args, s_env *env)
+{
+        if (args == nil())
+                return (u_form*) new_long(pool_size());
+        if (!consp(args) || !integerp(args->cons.car) ||
+            args->cons.car->lng.lng < 1 || args->cons.cdr != nil())
+                return error(env, "invalid arguments for "
+                             "thread-pool-size");
+        set_pool_size(args->cons.car->lng.lng, env);
+        return args->cons.car;
+}
@@ -0,0 +1,81 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+#include "env.h"
+#include "form.h"
+
+#define POOL_MAX_WORKERS       64
+#define POOL_DEQUE_SIZE        256
+#define POOL_CHUNKS_PER_WORKER 8
+
+typedef struct pool_job    s_pool_job;
+typedef struct pool_task   s_pool_task;
+typedef struct pool_deque  s_pool_deque;
+typedef struct pool_worker s_pool_worker;
+
+typedef enum {
+        POOL_MAP,
+        POOL_EVERY,
+        POOL_REDUCE
+} e_pool_op;
+
+/* A function applied to count items in chunks of grain items.
+   stop is the index of the first item that failed, an error or a
+   false predicate, and count while none did: items after it are
+   skipped, so the error signalled is the one the sequential version
+   would signal. A reduction leaves one result per chunk. */
+struct pool_job {
+        e_pool_op op;
+        u_form *function;
+        u_form *key;
+        u_form **items;
+        u_form **results;
+        unsigned long count;
+        unsigned long grain;
+        unsigned long stop;
+        s_string *error;
+        unsigned long pending;
+        pthread_mutex_t mutex;
+        pthread_cond_t done;
+};
+
+/* The items start to end of a job, split in halves by the worker
+   that runs it. */
+struct pool_task {
+        s_pool_job *job;
+        unsigned long start;
+        unsigned long end;
+        s_pool_task *next;
+};
+
+/* A Chase-Lev deque: its worker pushes and pops at the bottom while
+   idle workers steal from the top. */
+struct pool_deque {
+        long top;
+        long bottom;
+        s_pool_task *tasks[POOL_DEQUE_SIZE];
+};
+
+struct pool_worker {
+        unsigned long id;
+        pthread_t pthread;
+        s_pool_deque deque;
+        s_env env;
+};
+
+unsigned long pool_size (void);
+void          set_pool_size (unsigned long size, s_env *env);
+void          pool_job_init (s_pool_job *job, e_pool_op op,
+                             u_form *function, s_env *env);
+void          pool_start_job (s_pool_job *job, s_env *env);
+int           pool_job_done_p (s_pool_job *job);
+void          pool_wait_job (s_pool_job *job);
+void          pool_run_job (s_pool_job *job, s_env *env);
+
+u_form * cfun_pmapcar (u_form *args, s_env *env);
+u_form * cfun_pevery (u_form *args, s_env *env);
+u_form * cfun_preduce (u_form *args, s_env *env);
+u_form * cfun_thread_pool_size (u_form *args, s_env *env);
+
+#endif
@@ -1,220 +1,319 @@
 
 #include <stdio.h>
+#include <string.h>
 #include "error.h"
 #include "eval.h"
+#include "form_string.h"
 #include "lambda.h"
 #include "package.h"
 #include "print.h"
+#include "symbols.h"
 
-void prin1_cons (s_cons *cons, FILE *stream, s_env *env)
-{
-        static u_form *quote_sym = NULL;
-        static u_form *backquote_sym;
-        static u_form *comma_sym;
-        static u_form *comma_atsign_sym;
-        static u_form *comma_dot_sym;
-        if (!quote_sym) {
-                quote_sym = (u_form*) sym("quote", NULL);
-                backquote_sym = (u_form*) sym("backquote", NULL);
-                comma_sym = (u_form*) sym("comma", NULL);
-                comma_atsign_sym = (u_form*) sym("comma-atsign", NULL);
-                comma_dot_sym = (u_form*) sym("comma-dot", NULL);
-        }
+void prin1_cons (s_cons *cons, s_ostream *os, s_env *env)
+{
         if (symbolp(cons->car) && consp(cons->cdr) &&
             cons->cdr->cons.cdr == nil()) {
-                if (cons->car == quote_sym) {
-                        fputc('\'', stream);
-                        prin1(cons->cdr->cons.car, stream, env);
+                if (cons->car == g_sym.quote) {
+                        ostream_putc(os, '\'');
+                        prin1_(cons->cdr->cons.car, os, env);
                         return;
                 }
-                if (cons->car == backquote_sym) {
-                        fputc('`', stream);
-                        prin1(cons->cdr->cons.car, stream, env);
+                if (cons->car == g_sym.backquote) {
+                        ostream_putc(os, '`');
+                        prin1_(cons->cdr->cons.car, os, env);
                         return;
                 }
-                if (cons->car == comma_sym) {
-                        fputc(',', stream);
-                        prin1(cons->cdr->cons.car, stream, env);
+                if (cons->car == g_sym.comma) {
+                        ostream_putc(os, ',');
+                        prin1_(cons->cdr->cons.car, os, env);
                         return;
                 }
-                if (cons->car == comma_atsign_sym) {
-                        fputs(",@", stream);
-                        prin1(cons->cdr->cons.car, stream, env);
+                if (cons->car == g_sym.comma_atsign) {
+                        ostream_puts(os, ",@");
+                        prin1_(cons->cdr->cons.car, os, env);
                         return;
                 }
-                if (cons->car == comma_dot_sym) {
-                        fputs(",.", stream);
-                        prin1(cons->cdr->cons.car, stream, env);
+                if (cons->car == g_sym.comma_dot) {
+                        ostream_puts(os, ",.");
+                        prin1_(cons->cdr->cons.car, os, env);
                         return;
                 }
         }
-        fputc('(', stream);
-        prin1(cons->car, stream, env);
+        ostream_putc(os, '(');
+        prin1_(cons->car, os, env);
         while (consp(cons->cdr)) {
-                fputc(' ', stream);
+                ostream_putc(os, ' ');
                 cons = &cons->cdr->cons;
-                prin1(cons->car, stream, env);
+                prin1_(cons->car, os, env);
         }
         if (cons->cdr != nil()) {
-                fputs(" . ", stream);
-                prin1(cons->cdr, stream, env);
+                ostream_puts(os, " . ");
+                prin1_(cons->cdr, os, env);
         }
-        fputc(')', stream);
+        ostream_putc(os, ')');
 }
 
-void prin1_string (s_string *s, FILE *stream)
+/* Copies the runs between double quotes whole. */
+void prin1_string (s_string *s, s_ostream *os)
 {
-        unsigned long len = s->length;
-        char *c = string_str(s);
-        fputc('"', stream);
-        while (len--) {
-                if (*c == '"')
-                        fputc('\\', stream);
-                fputc(*c++, stream);
+        const char *c = string_str(s);
+        const char *end = c + s->length;
+        const char *q;
+        ostream_putc(os, '"');
+        while ((q = memchr(c, '"', end - c))) {
+                ostream_write(os, c, q - c);
+                ostream_write(os, "\\\"", 2);
+                c = q + 1;
         }
-        fputs("\"", stream);
+        ostream_write(os, c, end - c);
+        ostream_putc(os, '"');
 }
 
-void prin1_symbol (s_symbol *sym, FILE *stream)
+void prin1_symbol (s_symbol *sym, s_ostream *os)
 {
         if (!sym->package)
-                fputs("#:", stream);
+                ostream_puts(os, "#:");
         if (sym->package == keyword_package())
-                fputc(':', stream);
-        fputs(string_str(sym->string), stream);
+                ostream_putc(os, ':');
+        ostream_write(os, string_str(sym->string), sym->string->length);
+}
+
+/* Prefixes symbols that the current package does not find by their
+   name with the name of their package. */
+void prin1_qualified_symbol (s_symbol *sym, s_ostream *os, s_env *env)
+{
+        s_package *pkg = sym->package;
+        if (env && pkg && pkg != keyword_package() &&
+            find_symbol(sym->string, package(env)) != sym) {
+                ostream_write(os, string_str(pkg->name->string),
+                              pkg->name->string->length);
+                if (symbol_external_p(sym, pkg))
+                        ostream_putc(os, ':');
+                else
+                        ostream_write(os, "::", 2);
+        }
+        prin1_symbol(sym, os);
+}
+
+void prin1_package (s_package *pkg, s_ostream *os)
+{
+        ostream_puts(os, "#<package ");
+        prin1_symbol(pkg->name, os);
+        ostream_puts(os, ">");
 }
 
-void prin1_package (s_package *pkg, FILE *stream)
+void prin1_cfun (s_cfun *cf, s_ostream *os)
 {
-        fputs("#<package ", stream);
-        fputs(string_str(pkg->name->string), stream);
-        fputs(">", stream);
+        ostream_puts(os, "#<cfun ");
+        prin1_symbol(cf->name, os);
+        ostream_puts(os, ">");
 }
 
-void prin1_cfun (s_cfun *cf, FILE *stream)
+void prin1_lambda (s_lambda *lambda, s_ostream *os)
 {
-        fputs("#<cfun ", stream);
-        fputs(string_str(cf->name->string), stream);
-        fputs(">", stream);
+        ostream_puts(os, "#<");
+        prin1_symbol(lambda->lambda_type, os);
+        ostream_puts(os, " ");
+        prin1_symbol(lambda->name, os);
+        ostream_puts(os, ">");
 }
 
-void prin1_lambda (s_lambda *lambda, FILE *stream)
+void prin1_long (s_long *lng, s_ostream *os)
 {
-        fputs("#<", stream);
-        prin1_symbol(lambda->lambda_type, stream);
-        fputs(" ", stream);
-        prin1_symbol(lambda->name, stream);
-        fputs(">", stream);
+        ostream_long(os, lng->lng);
 }
 
-void prin1_long (s_long *lng, FILE *stream)
+void prin1_double (s_double *dbl, s_ostream *os)
 {
-        fprintf(stream, "%li", lng->lng);
+        ostream_double(os, dbl->dbl);
 }
 
-void prin1_double (s_double *dbl, FILE *stream)
+void prin1_character (s_character *c, s_ostream *os)
 {
-        fprintf(stream, "%g", dbl->dbl);
+        static const char *names[33] = {
+                "Nul", NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                "Backspace", "Tab", "Newline", NULL, "Page", "Return",
+                NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                "Space"
+        };
+        char buf[4];
+        ostream_write(os, "#\\", 2);
+        if (c->code <= ' ' && names[c->code])
+                ostream_puts(os, names[c->code]);
+        else if (c->code == 127)
+                ostream_puts(os, "Rubout");
+        else
+                ostream_write(os, buf, utf8_encode(c->code, buf));
 }
 
-void prin1_skiplist (s_skiplist *sl, FILE *stream, s_env *env)
+void prin1_skiplist (s_skiplist *sl, s_ostream *os, s_env *env)
 {
         s_skiplist_node *n = skiplist_node_next(sl->head, 0);
-        fputc('[', stream);
+        ostream_putc(os, '[');
         while (n) {
-                prin1((u_form*) n->value, stream, env);
+                prin1_((u_form*) n->value, os, env);
                 n = skiplist_node_next(n, 0);
                 if (n)
-                        fputc(' ', stream);
+                        ostream_putc(os, ' ');
         }
-        fputc(']', stream);
+        ostream_putc(os, ']');
 }
 
-void prin1_skiplist_node (s_skiplist_node *n, FILE *stream, s_env *env)
+void prin1_skiplist_node (s_skiplist_node *n, s_ostream *os, s_env *env)
 {
         unsigned long level;
-        fputs("#[", stream);
-        prin1(n->value, stream, env);
+        ostream_puts(os, "#[");
+        prin1_(n->value, os, env);
         for (level = 0; level < n->height; level++) {
                 s_skiplist_node *next = skiplist_node_next(n, level);
-                fputc(' ', stream);
-                prin1(next->value, stream, env);
+                ostream_putc(os, ' ');
+                prin1_(next->value, os, env);
         }
-        fputc(']', stream);
+        ostream_putc(os, ']');
 }
 
-void prin1_frame (s_frame *f, FILE *stream, s_env *env)
+void prin1_frame (s_frame *f, s_ostream *os, s_env *env)
 {
         (void) f;
         (void) env;
-        fputs("#<frame>", stream);
+        ostream_puts(os, "#<frame>");
 }
 
-void prin1_hashtable (s_hashtable *h, FILE *stream, s_env *env)
+void prin1_hashtable (s_hashtable *h, s_ostream *os, s_env *env)
 {
         (void) env;
-        fprintf(stream, "#<hashtable %li entries>", h->count);
+        ostream_puts(os, "#<hashtable ");
+        ostream_long(os, h->count);
+        ostream_puts(os, " entries>");
 }
 
-void prin1 (u_form *f, FILE *stream, s_env *env)
+void prin1_vector (s_vector *v, s_ostream *os, s_env *env)
+{
+        unsigned long i;
+        ostream_puts(os, "#(");
+        for (i = 0; i < v->length; i++) {
+                if (i)
+                        ostream_putc(os, ' ');
+                switch (v->element_type) {
+                case VECTOR_T:
+                        prin1_(vector_t(v)[i], os, env);
+                        break;
+                case VECTOR_U8:
+                        ostream_long(os, vector_u8(v)[i]);
+                        break;
+                case VECTOR_FIXNUM:
+                        ostream_long(os, vector_fixnum(v)[i]);
+                        break;
+                case VECTOR_DOUBLE:
+                        ostream_double(os, vector_double(v)[i]);
+                        break;
+                }
+        }
+        ostream_putc(os, ')');
+}
+
+void prin1_ (u_form *f, s_ostream *os, s_env *env)
 {
         if (!f) {
                 return;
         }
-        if (!stream)
-                stream = stdout;
-        if (!env)
-                env = &g_env;
         switch (f->type) {
-        case FORM_VALUES:
-                prin1(value_(f), stream, env);
-                break;
         case FORM_CONS:
-                prin1_cons(&f->cons, stream, env);
+                prin1_cons(&f->cons, os, env);
                 break;
         case FORM_STRING:
-                prin1_string(&f->string, stream);
+                prin1_string(&f->string, os);
                 break;
         case FORM_SYMBOL:
-                prin1_symbol(&f->symbol, stream);
+                prin1_qualified_symbol(&f->symbol, os, env);
                 break;
         case FORM_PACKAGE:
-                prin1_package(&f->package, stream);
+                prin1_package(&f->package, os);
                 break;
         case FORM_CFUN:
-                prin1_cfun(&f->cfun, stream);
+                prin1_cfun(&f->cfun, os);
                 break;
         case FORM_LAMBDA:
-                prin1_lambda(&f->lambda, stream);
+                prin1_lambda(&f->lambda, os);
                 break;
         case FORM_LONG:
-                prin1_long(&f->lng, stream);
+                prin1_long(&f->lng, os);
                 break;
         case FORM_DOUBLE:
-                prin1_double(&f->dbl, stream);
+                prin1_double(&f->dbl, os);
                 break;
         case FORM_SKIPLIST:
-                prin1_skiplist(&f->skiplist, stream, env);
+                prin1_skiplist(&f->skiplist, os, env);
                 break;
         case FORM_SKIPLIST_NODE:
-                prin1_skiplist_node(&f->skiplist_node, stream, env);
+                prin1_skiplist_node(&f->skiplist_node, os, env);
                 break;
         case FORM_FRAME:
-                prin1_frame(&f->frame, stream, env);
+                prin1_frame(&f->frame, os, env);
                 break;
         case FORM_HASHTABLE:
-                prin1_hashtable(&f->hashtable, stream, env);
+                prin1_hashtable(&f->hashtable, os, env);
+                break;
+        case FORM_VECTOR:
+                prin1_vector(&f->vector, os, env);
+                break;
+        case FORM_CHARACTER:
+                prin1_character(&f->character, os);
+                break;
+        case FORM_OSTREAM:
+                ostream_puts(os, "#<string-output-stream>");
+                break;
+        case FORM_THREAD:
+                ostream_puts(os, "#<thread>");
+                break;
+        case FORM_FUTURE:
+                ostream_puts(os, "#<future>");
+                break;
+        case FORM_COROUTINE:
+                ostream_puts(os, "#<coroutine>");
+                break;
+        case FORM_CHANNEL:
+                ostream_puts(os, "#<channel>");
                 break;
         }
 }
 
+void print_ (u_form *f, s_ostream *os, s_env *env)
+{
+        ostream_putc(os, '\n');
+        prin1_(f, os, env);
+        ostream_putc(os, ' ');
+}
+
+void prin1 (u_form *f, FILE *stream, s_env *env)
+{
+        s_ostream os;
+        ostream_init_file(&os, stream ? stream : stdout);
+        prin1_(f, &os, env);
+        ostream_flush(&os);
+}
+
 void print (u_form *f, FILE *stream, s_env *env)
 {
-        if (!stream)
-                stream = stdout;
-        if (!env)
-                env = &g_env;
-        fputs("\n", stream);
-        prin1(f, stream, env);
-        fputc(' ', stream);
+        s_ostream os;
+        ostream_init_file(&os, stream ? stream : stdout);
+        print_(f, &os, env);
+        ostream_flush(&os);
+}
+
+s_string * prin1_to_string (u_form *f, s_env *env)
+{
+        s_ostream os;
+        ostream_init_string(&os);
+        prin1_(f, &os, env);
+        return ostream_string(&os);
+}
+
+u_form * cfun_prin1_to_string (u_form *args, s_env *env)
+{
+        if (!consp(args) || args->cons.cdr != nil())
+                return error(env, "invalid arguments for "
+                             "prin1-to-string");
+        return (u_form*) prin1_to_string(args->cons.car, env);
 }
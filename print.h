@@ -3,8 +3,14 @@
 
 #include <stdio.h>
 #include "form.h"
+#include "ostream.h"
 
+void prin1_ (u_form *f, s_ostream *os, s_env *env);
+void print_ (u_form *f, s_ostream *os, s_env *env);
 void prin1 (u_form *f, FILE *stream, s_env *env);
 void print (u_form *f, FILE *stream, s_env *env);
+s_string * prin1_to_string (u_form *f, s_env *env);
+
+u_form * cfun_prin1_to_string (u_form *args, s_env *env);
 
 #endif
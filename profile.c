@@ -0,0 +1,249 @@
+#define _DEFAULT_SOURCE 1
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "backtrace.h"
+#include "error.h"
+#include "eval.h"
+#include "hashtable.h"
+#include "ostream.h"
+#include "profile.h"
+#include "symbols.h"
+
+/* Samples taken by the SIGPROF handler of whichever thread the
+   signal interrupts, g_profile_next counting them all: the ring
+   keeps the last PROFILE_SAMPLES. */
+static s_profile_sample *g_profile_samples = NULL;
+static unsigned long g_profile_next = 0;
+static int g_profile_running = 0;
+static __thread s_env *g_profile_env = NULL;
+
+/* Names env as the one whose backtrace is sampled in this thread. */
+void profile_set_env (s_env *env)
+{
+        g_profile_env = env;
+}
+
+s_env * profile_env (void)
+{
+        return g_profile_env;
+}
+
+static void profile_signal (int sig)
+{
+        s_env *env = g_profile_env;
+        s_profile_sample *s;
+        s_backtrace_frame *bf;
+        unsigned long depth = 0;
+        unsigned long i;
+        (void) sig;
+        if (!env || !g_profile_samples)
+                return;
+        i = __atomic_fetch_add(&g_profile_next, 1, __ATOMIC_RELAXED);
+        s = &g_profile_samples[i % PROFILE_SAMPLES];
+        __atomic_store_n(&s->depth, 0, __ATOMIC_RELAXED);
+        for (bf = env->backtrace; bf && depth < PROFILE_DEPTH;
+             bf = bf->next)
+                s->funs[depth++] = bf->fun;
+        __atomic_store_n(&s->depth, depth, __ATOMIC_RELEASE);
+}
+
+static int profile_timer (long usec)
+{
+        struct itimerval it;
+        it.it_interval.tv_sec = 0;
+        it.it_interval.tv_usec = usec;
+        it.it_value = it.it_interval;
+        return setitimer(ITIMER_PROF, &it, NULL);
+}
+
+int profile_start (void)
+{
+        struct sigaction sa;
+        if (g_profile_running)
+                return 0;
+        if (!g_profile_samples &&
+            !(g_profile_samples = calloc(PROFILE_SAMPLES,
+                                         sizeof(s_profile_sample))))
+                return -1;
+        g_profile_next = 0;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = profile_signal;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        if (sigaction(SIGPROF, &sa, NULL) ||
+            profile_timer(1000000 / PROFILE_HZ))
+                return -1;
+        g_profile_running = 1;
+        return 0;
+}
+
+void profile_stop (void)
+{
+        if (g_profile_running) {
+                profile_timer(0);
+                g_profile_running = 0;
+        }
+}
+
+static u_form * profile_name (u_form *fun)
+{
+        if (fun->type == FORM_CFUN)
+                return (u_form*) fun->cfun.name;
+        if (fun->type == FORM_LAMBDA &&
+            (u_form*) fun->lambda.name != nil())
+                return (u_form*) fun->lambda.name;
+        return g_sym.lambda;
+}
+
+/* Adds a sample to the self and total counts of its functions,
+   counting a function once however deep it recurses. */
+static void profile_count (s_hashtable *h, s_profile_sample *s)
+{
+        unsigned long i;
+        unsigned long j;
+        for (i = 0; i < s->depth; i++) {
+                u_form *name = profile_name(s->funs[i]);
+                u_form *counts;
+                for (j = 0; j < i; j++)
+                        if (profile_name(s->funs[j]) == name)
+                                break;
+                if (j < i)
+                        continue;
+                if (!(counts = gethash(h, name)))
+                        counts = sethash(h, name,
+                                         cons((u_form*) new_long(0),
+                                              (u_form*) new_long(0)));
+                if (!i)
+                        counts->cons.car->lng.lng++;
+                counts->cons.cdr->lng.lng++;
+        }
+}
+
+static void profile_fold (s_hashtable *h, s_profile_sample *s)
+{
+        s_ostream os;
+        s_string *stack;
+        u_form *count;
+        unsigned long i = s->depth;
+        ostream_init_string(&os);
+        while (i--) {
+                s_symbol *name = &profile_name(s->funs[i])->symbol;
+                ostream_write(&os, string_str(name->string),
+                              name->string->length);
+                if (i)
+                        ostream_putc(&os, ';');
+        }
+        stack = ostream_string(&os);
+        if ((count = gethash(h, (u_form*) stack)))
+                count->lng.lng++;
+        else
+                sethash(h, (u_form*) stack, (u_form*) new_long(1));
+}
+
+/* Writes one line per distinct stack, outermost function first,
+   followed by its sample count: the folded format of flamegraph
+   tools. */
+static int profile_write_folded (s_hashtable *h, const char *path)
+{
+        FILE *fp = fopen(path, "w");
+        s_ostream os;
+        long i;
+        if (!fp)
+                return -1;
+        ostream_init_file(&os, fp);
+        for (i = 0; i < h->size; i++) {
+                u_form *b;
+                for (b = h->buckets[i]; consp(b); b = b->cons.cdr) {
+                        s_string *stack = &caar(b)->string;
+                        ostream_write(&os, string_str(stack),
+                                      stack->length);
+                        ostream_putc(&os, ' ');
+                        ostream_long(&os, cdar(b)->lng.lng);
+                        ostream_putc(&os, '\n');
+                }
+        }
+        ostream_flush(&os);
+        return fclose(fp) || os.error ? -1 : 0;
+}
+
+static int profile_compare (const void *a, const void *b)
+{
+        u_form *x = *(u_form* const*) a;
+        u_form *y = *(u_form* const*) b;
+        long d = cadr(y)->lng.lng - cadr(x)->lng.lng;
+        if (!d)
+                d = caddr(y)->lng.lng - caddr(x)->lng.lng;
+        return d < 0 ? -1 : d > 0;
+}
+
+u_form * cfun_profile_start (u_form *args, s_env *env)
+{
+        if (args != nil())
+                return error(env, "invalid arguments for profile-start");
+        profile_set_env(env);
+        if (profile_start())
+                return error(env, "profile-start: cannot start timer");
+        return g_sym.t;
+}
+
+u_form * cfun_profile_stop (u_form *args, s_env *env)
+{
+        if (args != nil())
+                return error(env, "invalid arguments for profile-stop");
+        profile_stop();
+        return (u_form*) new_long(g_profile_next);
+}
+
+/* (profile-report &optional folded-path) stops the profiler and
+   returns a list of (function self total) sample counts, most self
+   samples first. */
+u_form * cfun_profile_report (u_form *args, s_env *env)
+{
+        s_hashtable *counts = new_hashtable(64, 0, 2.0, 1.0);
+        s_hashtable *stacks = NULL;
+        u_form **rows;
+        u_form *report = nil();
+        unsigned long n;
+        unsigned long i;
+        long j;
+        if (args != nil() && (!consp(args) ||
+                              !stringp(args->cons.car) ||
+                              args->cons.cdr != nil()))
+                return error(env, "invalid arguments for profile-report");
+        profile_stop();
+        if (args != nil())
+                stacks = new_hashtable(64, 0, 2.0, 1.0);
+        n = g_profile_next < PROFILE_SAMPLES ? g_profile_next :
+                PROFILE_SAMPLES;
+        for (i = 0; g_profile_samples && i < n; i++) {
+                s_profile_sample *s = &g_profile_samples[i];
+                if (!__atomic_load_n(&s->depth, __ATOMIC_ACQUIRE))
+                        continue;
+                profile_count(counts, s);
+                if (stacks)
+                        profile_fold(stacks, s);
+        }
+        if (stacks && profile_write_folded(stacks, string_cstr
+                                           (&args->cons.car->string)))
+                return error(env, "profile-report: cannot write %s",
+                             string_cstr(&args->cons.car->string));
+        if (!(rows = malloc((counts->count + 1) * sizeof(u_form*))))
+                return error(env, "profile-report: out of memory");
+        n = 0;
+        for (j = 0; j < counts->size; j++) {
+                u_form *b;
+                for (b = counts->buckets[j]; consp(b); b = b->cons.cdr)
+                        rows[n++] = cons(caar(b),
+                                         cons(cdar(b)->cons.car,
+                                              cons(cdar(b)->cons.cdr,
+                                                   nil())));
+        }
+        qsort(rows, n, sizeof(u_form*), profile_compare);
+        while (n--)
+                report = cons(rows[n], report);
+        free(rows);
+        return report;
+}
@@ -0,0 +1,30 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "env.h"
+#include "form.h"
+
+#define PROFILE_HZ      1000
+#define PROFILE_DEPTH   32
+#define PROFILE_SAMPLES 65536
+
+typedef struct profile_sample s_profile_sample;
+
+/* The functions on the backtrace of one thread, innermost first.
+   depth is written last, so that a sample is complete once it is
+   not zero. */
+struct profile_sample {
+        unsigned long depth;
+        u_form *funs[PROFILE_DEPTH];
+};
+
+void    profile_set_env (s_env *env);
+s_env * profile_env (void);
+int  profile_start (void);
+void profile_stop (void);
+
+u_form * cfun_profile_start (u_form *args, s_env *env);
+u_form * cfun_profile_stop (u_form *args, s_env *env);
+u_form * cfun_profile_report (u_form *args, s_env *env);
+
+#endif
@@ -1,9 +1,20 @@
-
+#define _POSIX_C_SOURCE 200809L
+#include "config.h"
+#include <assert.h>
+#include <limits.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
-#define __USE_XOPEN2K8 1
+#include <fcntl.h>
+#include <unistd.h>
 #include <stdio.h>
+#ifdef HAVE_MMAP
+#define __USE_MISC 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include <readline/readline.h>
 #include <readline/history.h>
 
@@ -12,85 +23,405 @@
 #include "error.h"
 #include "eval.h"
 #include "form.h"
+#include "form_string.h"
 #include "package.h"
 #include "read.h"
-#include "form_string.h"
+#include "symbols.h"
+#include "ostream.h"
 #include "unwind_protect.h"
 
-s_stream * stream_readline (const char *prompt)
+static s_stream * new_stream (const char *file_name)
 {
         s_stream *stream = malloc(sizeof(s_stream));
         if (stream) {
                 stream->s = NULL;
                 stream->n = 0;
-                stream->start = stream->end = 0;
+                stream->start = stream->end = stream->fill = 0;
                 stream->in_cons = 0;
-                stream->fp = NULL;
-                stream->prompt = prompt;
-                stream->file_name = "readline";
-                stream->line = 0;
+                stream->chunked = 0;
+                stream->fd = -1;
+                stream->eof = 0;
+                stream->scan.pos = 0;
+                stream->scan.depth = 0;
+                stream->scan.state = 0;
+                stream->map_size = 0;
+                stream->prompt = NULL;
+                stream->file_name = file_name;
+                stream->line = 1;
         }
         return stream;
 }
 
-s_stream * stream_stdin ()
+s_stream * stream_readline (const char *prompt)
 {
-        s_stream *stream = malloc(sizeof(s_stream));
+        s_stream *stream = new_stream("readline");
         if (stream) {
-                stream->s = NULL;
-                stream->n = 0;
-                stream->start = stream->end = 0;
-                stream->in_cons = 0;
-                stream->fp = stdin;
-                stream->prompt = NULL;
-                stream->file_name = "stdin";
+                stream->prompt = prompt;
                 stream->line = 0;
         }
         return stream;
 }
 
+/* A chunked stream fed by stream_feed. */
+s_stream * stream_chunks (const char *file_name)
+{
+        s_stream *stream = new_stream(file_name);
+        if (stream)
+                stream->chunked = 1;
+        return stream;
+}
+
+/* A chunked stream reading fd, which it closes with the stream. fd
+   may be non-blocking. */
+s_stream * stream_fd (int fd, const char *file_name)
+{
+        s_stream *stream = stream_chunks(file_name);
+        if (stream)
+                stream->fd = fd;
+        return stream;
+}
+
+s_stream * stream_stdin ()
+{
+        return stream_fd(0, "stdin");
+}
+
+#ifdef HAVE_MMAP
+/* Maps a regular file whole, followed by a zero byte so that readers
+   can look one character past the end as they do with getline's
+   buffer. */
+static int stream_map (s_stream *stream, int fd)
+{
+        struct stat st;
+        size_t size;
+        char *map;
+        if (fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size <= 0)
+                return -1;
+        size = st.st_size;
+        map = mmap(NULL, size + 1, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS,
+                   -1, 0);
+        if (map == MAP_FAILED)
+                return -1;
+        if (mmap(map, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+            MAP_FAILED) {
+                munmap(map, size + 1);
+                return -1;
+        }
+        posix_madvise(map, size, POSIX_MADV_SEQUENTIAL);
+        stream->s = map;
+        stream->n = size + 1;
+        stream->end = size;
+        stream->map_size = size + 1;
+        return 0;
+}
+#endif
+
 s_stream * stream_open (const char *file_name, s_env *env)
 {
-        s_stream *stream = malloc(sizeof(s_stream));
-        if (stream) {
-                stream->s = NULL;
-                stream->n = 0;
-                stream->start = stream->end = 0;
-                stream->in_cons = 0;
-                if (!(stream->fp = fopen(file_name, "r")))
-                        error(env, "open %s: %s", file_name,
-                              strerror(errno));
-                stream->prompt = NULL;
-                stream->file_name = file_name;
-                stream->line = 0;
+        s_stream *stream;
+        int fd;
+        if ((fd = open(file_name, O_RDONLY)) < 0)
+                error(env, "open %s: %s", file_name, strerror(errno));
+#ifdef HAVE_MMAP
+        if ((stream = new_stream(file_name)) && !stream_map(stream, fd)) {
+                close(fd);
+                return stream;
         }
-        return stream;
+        free(stream);
+#endif
+        return stream_fd(fd, file_name);
 }
 
 void stream_close (s_stream *stream)
 {
-        if (stream && stream->fp)
-                fclose(stream->fp);
+        if (!stream)
+                return;
+#ifdef HAVE_MMAP
+        if (stream->map_size) {
+                munmap(stream->s, stream->map_size);
+                stream->s = NULL;
+                stream->map_size = 0;
+        }
+#endif
+        if (stream->chunked) {
+                free(stream->s);
+                stream->s = NULL;
+        }
+        if (stream->fd >= 0) {
+                close(stream->fd);
+                stream->fd = -1;
+        }
+}
+
+/* Mapped and chunked streams do not track lines while reading :
+   count them when an error message needs one. */
+unsigned long stream_line (s_stream *stream)
+{
+        unsigned long line = stream->line;
+        const char *p;
+        const char *end;
+        if (!stream->map_size && !stream->chunked)
+                return line;
+        p = stream->s;
+        end = stream->s + stream->start;
+        while (p && (p = memchr(p, '\n', end - p))) {
+                line++;
+                p++;
+        }
+        return line;
+}
+
+#define CHAR_SPACE       1
+#define CHAR_TERMINATING 2
+#define CHAR_DIGIT       4
+#define CHAR_NUMBER      8
+
+/* Character classes of the reader, indexed by byte. Characters
+   without a class are symbol constituents. CHAR_NUMBER marks the
+   bytes that can start a number. */
+static const unsigned char g_char_class[256] = {
+        ['\t'] = CHAR_SPACE,
+        ['\n'] = CHAR_SPACE,
+        ['\r'] = CHAR_SPACE,
+        [' ']  = CHAR_SPACE,
+        ['"']  = CHAR_TERMINATING,
+        ['\''] = CHAR_TERMINATING,
+        ['(']  = CHAR_TERMINATING,
+        [')']  = CHAR_TERMINATING,
+        ['[']  = CHAR_TERMINATING,
+        [']']  = CHAR_TERMINATING,
+        ['+']  = CHAR_NUMBER,
+        ['-']  = CHAR_NUMBER,
+        ['.']  = CHAR_NUMBER,
+        ['0']  = CHAR_DIGIT | CHAR_NUMBER,
+        ['1']  = CHAR_DIGIT | CHAR_NUMBER,
+        ['2']  = CHAR_DIGIT | CHAR_NUMBER,
+        ['3']  = CHAR_DIGIT | CHAR_NUMBER,
+        ['4']  = CHAR_DIGIT | CHAR_NUMBER,
+        ['5']  = CHAR_DIGIT | CHAR_NUMBER,
+        ['6']  = CHAR_DIGIT | CHAR_NUMBER,
+        ['7']  = CHAR_DIGIT | CHAR_NUMBER,
+        ['8']  = CHAR_DIGIT | CHAR_NUMBER,
+        ['9']  = CHAR_DIGIT | CHAR_NUMBER
+};
+
+#define char_class(c) (g_char_class[(unsigned char) (c)])
+
+int endchar (int c)
+{
+        return char_class(c) & (CHAR_SPACE | CHAR_TERMINATING);
+}
+
+#define SCAN_SPACE  0
+#define SCAN_TOKEN  1
+#define SCAN_STRING 2
+#define SCAN_SHARP  3
+#define SCAN_CHAR   4
+
+/* Scans the bytes fed since the last call and moves end past every
+   top level form they complete. Prefixes such as quote belong to the
+   form that follows them; a top level token is complete once the
+   character after it has arrived. */
+static void stream_scan (s_stream *stream)
+{
+        s_scan *scan = &stream->scan;
+        const char *s = stream->s;
+        unsigned long pos = scan->pos;
+        int state = scan->state;
+        unsigned long depth = scan->depth;
+        while (pos < stream->fill) {
+                char c = s[pos];
+                switch (state) {
+                case SCAN_STRING: {
+                        const char *q = memchr(s + pos, '"',
+                                               stream->fill - pos);
+                        if (!q) {
+                                pos = stream->fill;
+                                continue;
+                        }
+                        pos = q - s + 1;
+                        state = SCAN_SPACE;
+                        if (!depth)
+                                stream->end = pos;
+                        continue;
+                }
+                case SCAN_TOKEN:
+                        if (!endchar(c)) {
+                                pos++;
+                                continue;
+                        }
+                        state = SCAN_SPACE;
+                        if (!depth)
+                                stream->end = pos;
+                        break;
+                case SCAN_SHARP:
+                        state = SCAN_SPACE;
+                        if (c == ':' || c == '\\') {
+                                state = c == ':' ? SCAN_TOKEN : SCAN_CHAR;
+                                pos++;
+                                continue;
+                        }
+                        break;
+                case SCAN_CHAR:
+                        state = SCAN_TOKEN;
+                        pos++;
+                        continue;
+                }
+                switch (c) {
+                case '"':
+                        state = SCAN_STRING;
+                        break;
+                case '(':
+                case '[':
+                        depth++;
+                        break;
+                case ')':
+                case ']':
+                        if (depth)
+                                depth--;
+                        if (!depth)
+                                stream->end = pos + 1;
+                        break;
+                case '#':
+                        state = SCAN_SHARP;
+                        break;
+                case '\'':
+                case '`':
+                case ',':
+                        break;
+                default:
+                        if (!(char_class(c) & CHAR_SPACE))
+                                state = SCAN_TOKEN;
+                }
+                pos++;
+        }
+        scan->pos = pos;
+        scan->state = state;
+        scan->depth = depth;
+}
+
+/* Drops the forms already read to make room at the end of s. */
+static void stream_compact (s_stream *stream)
+{
+        unsigned long start = stream->start;
+        const char *p = stream->s;
+        const char *end = stream->s + start;
+        if (!start)
+                return;
+        while ((p = memchr(p, '\n', end - p))) {
+                stream->line++;
+                p++;
+        }
+        memmove(stream->s, stream->s + start, stream->fill - start + 1);
+        stream->fill -= start;
+        stream->end -= start;
+        stream->scan.pos -= start;
+        stream->start = 0;
+}
+
+/* Appends bytes to a chunked stream. */
+void stream_feed (s_stream *stream, const char *buf, size_t len)
+{
+        stream_compact(stream);
+        if (stream->fill + len + 1 > stream->n) {
+                size_t n = stream->n ? stream->n : BUFSIZ;
+                while (stream->fill + len + 1 > n)
+                        n *= 2;
+                stream->s = realloc(stream->s, n);
+                assert(stream->s);
+                stream->n = n;
+        }
+        memcpy(stream->s + stream->fill, buf, len);
+        stream->fill += len;
+        stream->s[stream->fill] = 0;
+        stream_scan(stream);
+}
+
+/* No more bytes will come : whatever is left is read as is. */
+void stream_feed_eof (s_stream *stream)
+{
+        stream->eof = 1;
+        stream->end = stream->fill;
+}
+
+/* Reads once from fd into the stream. Returns the number of bytes
+   read, 0 at end of file and -1 if the read would block. */
+static ssize_t stream_read_fd (s_stream *stream)
+{
+        ssize_t r;
+        if (stream->n - stream->fill < BUFSIZ + 1) {
+                size_t n = stream->n ? stream->n * 2 : 4 * BUFSIZ;
+                stream->s = realloc(stream->s, n);
+                assert(stream->s);
+                stream->n = n;
+        }
+        do
+                r = read(stream->fd, stream->s + stream->fill,
+                         stream->n - stream->fill - 1);
+        while (r < 0 && errno == EINTR);
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return -1;
+        if (r <= 0) {
+                stream_feed_eof(stream);
+                return 0;
+        }
+        stream->fill += r;
+        stream->s[stream->fill] = 0;
+        stream_scan(stream);
+        return r;
+}
+
+/* Reads what fd has available without blocking, stopping once a form
+   is complete. Returns -1 at end of file. */
+int stream_pump (s_stream *stream)
+{
+        stream_compact(stream);
+        while (!stream->eof && stream->start == stream->end)
+                if (stream_read_fd(stream) < 0)
+                        return 0;
+        return stream->eof && stream->start == stream->end ? -1 : 0;
+}
+
+/* Returns the next complete form of a chunked stream, or NULL if
+   none has been fed yet or at end of file. */
+u_form * stream_next_form (s_stream *stream, s_env *env)
+{
+        while (stream->start < stream->end &&
+               (char_class(stream->s[stream->start]) & CHAR_SPACE))
+                stream->start++;
+        if (stream->start == stream->end)
+                return NULL;
+        return read_form(stream, env);
+}
+
+static int refill_chunked (s_stream *stream)
+{
+        while (stream->start == stream->end) {
+                if (stream->eof || stream->fd < 0)
+                        return -1;
+                stream_compact(stream);
+                if (stream_read_fd(stream) < 0) {
+                        struct pollfd pfd;
+                        pfd.fd = stream->fd;
+                        pfd.events = POLLIN;
+                        poll(&pfd, 1, -1);
+                }
+        }
+        return 0;
 }
 
 int refill (s_stream *stream)
 {
+        if (stream->map_size)
+                return stream->start < stream->end ? 0 : -1;
+        if (stream->chunked)
+                return refill_chunked(stream);
         while (!stream->s || stream->start == stream->end) {
                 stream->start = 0;
-                if (stream->fp) {
-                        ssize_t end = getline(&stream->s, &stream->n,
-                                              stream->fp);
-                        if (end < 0)
-                                return -1;
-                        stream->end = end - 1;
-                        stream->s[stream->end] = 0;
-                }
-                else {
-                        if (!(stream->s = readline(stream->prompt)))
-                                return -1;
-                        add_history(stream->s);
-                        stream->end = strlen(stream->s);
-                }
+                if (!(stream->s = readline(stream->prompt)))
+                        return -1;
+                add_history(stream->s);
+                stream->end = strlen(stream->s);
                 stream->line++;
         }
         return 0;
@@ -112,15 +443,14 @@ int peek_char (s_stream *stream)
 
 int read_spaces (s_stream *stream)
 {
-        int c;
-        while ((c = peek_char(stream)) >= 0)
-                switch (c) {
-                case ' ': case '\t': case '\r': case '\n':
-                        read_char(stream);
-                        continue;
-                default:
-                        return 0;
-                }
+        while (!refill(stream)) {
+                while (stream->start < stream->end)
+                        if (char_class(stream->s[stream->start]) &
+                            CHAR_SPACE)
+                                stream->start++;
+                        else
+                                return 0;
+        }
         return -1;
 }
 
@@ -138,7 +468,9 @@ u_form * read_cons (s_stream *stream, s_env *env)
                                 *tail = nil();
                                 return head;
                         }
-                        if (c == '.') {
+                        if (c == '.' &&
+                            (stream->start + 1 == stream->end ||
+                             endchar(stream->s[stream->start + 1]))) {
                                 if (!head)
                                         return error(env, "unexpect"
                                                      "ed dot");
@@ -185,43 +517,40 @@ u_form * read_skiplist (s_stream *stream, s_env *env)
         return NULL;
 }
 
+/* Strings read whole from the buffer unless they span the lines of
+   a readline stream, which go through a string builder. */
 u_form * read_string (s_stream *stream)
 {
-        u_form *f = NULL;
-        unsigned long c;
-        if (peek_char(stream) == '"') {
-                stream->start++;
-                while (!refill(stream)) {
-                        for (c = stream->start; c < stream->end &&
-                                     stream->s[c] != '"'; c++)
-                                ;
-                        if (f)
-                                f = (u_form*)
-                                        string_append((s_string*) f,
-                                                      stream->s + stream->start,
-                                                      c - stream->start);
-                        else
-                                f = (u_form*)new_string(c - stream->start,
-                                                        stream->s + stream->start);
-                        if (stream->s[c] == '"') {
-                                stream->start = c + 1;
-                                return f;
-                        }
-                        f = (u_form*) string_append((s_string*) f, "\n",
-                                                    1);
-                        stream->start = c;
+        s_ostream os;
+        int building = 0;
+        if (peek_char(stream) != '"')
+                return NULL;
+        stream->start++;
+        while (!refill(stream)) {
+                const char *s = stream->s + stream->start;
+                unsigned long len = stream->end - stream->start;
+                const char *q = memchr(s, '"', len);
+                if (q && !building) {
+                        stream->start += q - s + 1;
+                        return (u_form*) new_string(q - s, s);
+                }
+                if (!building) {
+                        ostream_init_string(&os);
+                        building = 1;
+                }
+                ostream_write(&os, s, q ? (unsigned long) (q - s) : len);
+                if (q) {
+                        stream->start += q - s + 1;
+                        return (u_form*) ostream_string(&os);
                 }
+                ostream_putc(&os, '\n');
+                stream->start = stream->end;
         }
+        if (building)
+                ostream_free(&os);
         return NULL;
 }
 
-int endchar (int c)
-{
-        return c == '(' || c == ')' || c == '"' || c == ' ' ||
-                c == '\t' || c == '\r' || c == '\n' || c == '\'' ||
-                c == '[' || c == ']';
-}
-
 u_form * read_uninterned_symbol (s_stream *stream)
 {
         s_string *s;
@@ -235,6 +564,47 @@ u_form * read_uninterned_symbol (s_stream *stream)
         return f;
 }
 
+static const struct {
+        const char *name;
+        char c;
+} g_character_names[] = {
+        {"Space",     ' '},
+        {"Newline",   '\n'},
+        {"Tab",       '\t'},
+        {"Return",    '\r'},
+        {"Backspace", '\b'},
+        {"Page",      '\f'},
+        {"Rubout",    127},
+        {"Nul",       0},
+        {NULL,        0}
+};
+
+/* The character after #\\ is taken even if it ends tokens; more
+   constituents make a character name. */
+u_form * read_character (s_stream *stream, s_env *env)
+{
+        const char *s = stream->s + stream->start;
+        unsigned long i;
+        unsigned long j;
+        unsigned long code;
+        unsigned len;
+        if (stream->start == stream->end)
+                return error(env, "missing character after #\\");
+        len = utf8_decode(s, stream->s + stream->end, &code);
+        i = len;
+        while (stream->start + i < stream->end && !endchar(s[i]))
+                i++;
+        stream->start += i;
+        if (i == len)
+                return (u_form*) new_character(code);
+        for (j = 0; g_character_names[j].name; j++)
+                if (strlen(g_character_names[j].name) == i &&
+                    !strncasecmp(g_character_names[j].name, s, i))
+                        return (u_form*) new_character
+                                ((unsigned char) g_character_names[j].c);
+        return error(env, "unknown character name");
+}
+
 u_form * read_sharp (s_stream *stream, s_env *env)
 {
         if (peek_char(stream) == '#') {
@@ -249,43 +619,105 @@ u_form * read_sharp (s_stream *stream, s_env *env)
                 case ':':
                         read_char(stream);
                         return read_uninterned_symbol(stream);
+                case '\\':
+                        read_char(stream);
+                        return read_character(stream, env);
+                case '(': {
+                        u_form *list = read_cons(stream, env);
+                        if (!list)
+                                return NULL;
+                        if (list != nil() && last(list)->cons.cdr != nil())
+                                return error(env, "dotted list in #(");
+                        return (u_form*) list_to_vector(list);
+                }
                 }
                 return error(env, "undefined # macro character %c", c);
         }
         return NULL;
 }
 
+/* Powers of ten that are exact in a double. */
+static const double g_pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+        1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+        1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* Parses [+-]digits[.digits][(e|E)[+-]digits] ending at an end
+   character. Integers that fit a long are accumulated directly.
+   Doubles whose digits fit in 53 bits with a power of ten up to 22
+   are computed with a single correctly rounded multiplication or
+   division; other doubles are left to strtod. */
 u_form * read_number (s_stream *stream)
 {
-        u_form *f = NULL;
-        unsigned long i = stream->start;
-        char *end;
-        unsigned long j = 0;
-        while (i < stream->end && '0' <= stream->s[i] && stream->s[i] <= '9')
-                i++;
-        if (i < stream->end && stream->s[i] == '.') {
-                f = (u_form*) new_double(strtod(stream->s + stream->start,
-                                                &end));
-                j = end - (stream->s + stream->start);
-        }
-        else if (i > stream->start) {
-                f = (u_form*) new_long(strtol(stream->s + stream->start,
-                                              &end, 10));
-                j = end - (stream->s + stream->start);
-        }
-        if (j > 0 && (stream->start + j >= stream->end || endchar(stream->s[stream->start + j]))) {
-                stream->start += j;
-                return f;
+        const char *start = stream->s + stream->start;
+        const char *end = stream->s + stream->end;
+        const char *p = start;
+        unsigned long m = 0;
+        int digits = 0;
+        int exact = 1;
+        int is_double = 0;
+        int negative = 0;
+        long exp = 0;
+        double d;
+        if (*p == '+' || *p == '-')
+                negative = *p++ == '-';
+        for (; p < end && (char_class(*p) & CHAR_DIGIT); p++, digits++)
+                if (m <= (ULONG_MAX - 9) / 10)
+                        m = m * 10 + (*p - '0');
+                else
+                        exact = 0;
+        if (p < end && *p == '.') {
+                is_double = 1;
+                for (p++; p < end && (char_class(*p) & CHAR_DIGIT);
+                     p++, digits++)
+                        if (m <= (ULONG_MAX - 9) / 10) {
+                                m = m * 10 + (*p - '0');
+                                exp--;
+                        }
+                        else
+                                exact = 0;
         }
-        return NULL;
+        if (!digits)
+                return NULL;
+        if (p < end && (*p == 'e' || *p == 'E')) {
+                int exp_negative = 0;
+                long e = 0;
+                const char *q = p + 1;
+                if (q < end && (*q == '+' || *q == '-'))
+                        exp_negative = *q++ == '-';
+                if (q == end || !(char_class(*q) & CHAR_DIGIT))
+                        return NULL;
+                for (; q < end && (char_class(*q) & CHAR_DIGIT); q++)
+                        if (e < 100000)
+                                e = e * 10 + (*q - '0');
+                exp += exp_negative ? -e : e;
+                is_double = 1;
+                p = q;
+        }
+        if (p < end && !endchar(*p))
+                return NULL;
+        stream->start = p - stream->s;
+        if (!is_double && exact &&
+            m <= (unsigned long) LONG_MAX + negative)
+                return (u_form*) new_long((long) (negative ? -m : m));
+        if (!exact || m > (1UL << 53) || exp < -22 || 22 < exp)
+                return (u_form*) new_double(strtod(start, NULL));
+        d = m;
+        d = exp < 0 ? d / g_pow10[-exp] : d * g_pow10[exp];
+        return (u_form*) new_double(negative ? -d : d);
 }
 
+/* pkg:name reads an external symbol of pkg, pkg::name interns
+   name in pkg. */
 u_form * read_symbol (s_stream *stream, s_env *env)
 {
         s_package *pkg = NULL;
-        s_string *s;
-        s_symbol *pkg_name;
+        s_string *s = NULL;
+        s_symbol *pkg_name = NULL;
+        s_string name;
         u_form *f;
+        int external = 0;
         unsigned long i = stream->start;
         while (i < stream->end && !endchar(stream->s[i])
                && stream->s[i] != ':')
@@ -303,25 +735,41 @@ u_form * read_symbol (s_stream *stream, s_env *env)
                 if (i < stream->end &&
                     stream->s[i] == ':')
                         stream->start = ++i;
+                else
+                        external = pkg && pkg != keyword_package();
         }
         if (i < stream->end && stream->s[i] == ':') {
                 stream->start = ++i;
                 error(env, "too many columns after package %s",
-                      string_str(pkg->name->string));
+                      string_str(pkg ? pkg->name->string : s));
         }
         while (i < stream->end && !endchar(stream->s[i]))
                 i++;
         if (i == stream->start) {
-                if (pkg)
+                if (pkg || pkg_name)
                         error(env, "no symbol name after package %s",
-                              string_str(pkg->name->string));
+                              string_str(pkg ? pkg->name->string : s));
                 return NULL;
         }
+        if (pkg_name && !pkg) {
+                stream->start = i;
+                error(env, "no package named %s",
+                      string_str(pkg_name->string));
+        }
         if (!pkg)
                 pkg = package(env);
-        s = new_string(i - stream->start,
-                       stream->s + stream->start);
-        f = (u_form*) intern(s, pkg);
+        if (external) {
+                init_string_ref(&name, i - stream->start,
+                                stream->s + stream->start);
+                stream->start = i;
+                if (!(f = (u_form*) find_external_symbol(&name, pkg)))
+                        error(env, "symbol %.*s is not external in package "
+                              "%s", (int) name.length, string_str(&name),
+                              string_str(pkg->name->string));
+        }
+        else
+                f = (u_form*) intern_slice(stream->s + stream->start,
+                                           i - stream->start, pkg);
         stream->start = i;
         return f;
 }
@@ -375,40 +823,38 @@ u_form * read_form (s_stream *stream, s_env *env)
         u_form *f;
         if (read_spaces(stream))
                 return NULL;
-        if ((f = read_quote(stream, env)))
-                return f;
-        if ((f = read_backquote(stream, env)))
-                return f;
-        if ((f = read_comma(stream, env)))
-                return f;
-        if ((f = read_cons(stream, env)))
-                return f;
-        if ((f = read_skiplist(stream, env)))
-                return f;
-        if ((f = read_string(stream)))
-                return f;
-        if ((f = read_sharp(stream, env)))
-                return f;
-        if ((f = read_number(stream)))
-                return f;
-        read_errors(stream, env);
-        if ((f = read_symbol(stream, env)))
-                return f;
-        if (refill(stream))
+        switch (stream->s[stream->start]) {
+        case '\'':
+                return read_quote(stream, env);
+        case '`':
+                return read_backquote(stream, env);
+        case ',':
+                return read_comma(stream, env);
+        case '(':
+                return read_cons(stream, env);
+        case '[':
+                return read_skiplist(stream, env);
+        case '"':
+                return read_string(stream);
+        case '#':
+                return read_sharp(stream, env);
+        case ')':
+                read_errors(stream, env);
                 return NULL;
-        return NULL;
+        }
+        if ((char_class(stream->s[stream->start]) & CHAR_NUMBER) &&
+            (f = read_number(stream)))
+                return f;
+        return read_symbol(stream, env);
 }
 
 u_form * load_stream (s_stream *stream, s_env *env)
 {
-        static s_symbol *t_sym = NULL;
         u_form *f;
         s_error_handler eh;
-        if (!t_sym)
-                t_sym = sym("t", NULL);
         if (setjmp(eh.buf)) {
                 fprintf(stderr, "error while loading %s line %lu\n",
-                        stream->file_name, stream->line);
+                        stream->file_name, stream_line(stream));
                 print_error(&eh, stderr, env);
                 pop_error_handler(env);
                 return nil();
@@ -417,7 +863,7 @@ u_form * load_stream (s_stream *stream, s_env *env)
         while ((f = read_form(stream, env)))
                 eval(f, env);
         pop_error_handler(env);
-        return (u_form*) t_sym;
+        return g_sym.t;
 }
 
 u_form * load_file (const char *path, s_env *env)
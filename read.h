@@ -5,13 +5,30 @@
 #include "form.h"
 #include "typedefs.h"
 
+/* Where a chunked stream is in scanning for the end of the next top
+   level form. The scan resumes at pos when more bytes are fed. */
+typedef struct scan {
+        unsigned long pos;
+        unsigned long depth;
+        int state;
+} s_scan;
+
+/* Forms are read from s between start and end. Mapped and readline
+   streams hold whole lines or files. Chunked streams hold fill bytes
+   as they came from fd or stream_feed, and only the complete top
+   level forms found by the scan are put before end. */
 struct stream {
         char *s;
         size_t n;
         unsigned long start;
         unsigned long end;
+        unsigned long fill;
         int in_cons;
-        FILE *fp;
+        int chunked;
+        int fd;
+        int eof;
+        s_scan scan;
+        size_t map_size;
         const char *prompt;
         const char *file_name;
         unsigned long line;
@@ -19,8 +36,16 @@ struct stream {
 
 s_stream * stream_readline (const char *prompt);
 s_stream * stream_stdin ();
+s_stream * stream_fd (int fd, const char *file_name);
+s_stream * stream_chunks (const char *file_name);
 s_stream * stream_open (const char *file_name, s_env *env);
 void       stream_close (s_stream *stream);
+unsigned long stream_line (s_stream *stream);
+
+void       stream_feed (s_stream *stream, const char *buf, size_t len);
+void       stream_feed_eof (s_stream *stream);
+int        stream_pump (s_stream *stream);
+u_form *   stream_next_form (s_stream *stream, s_env *env);
 
 u_form * read_form (s_stream *stream, s_env *env);
 
@@ -0,0 +1,249 @@
+#define _POSIX_C_SOURCE 200112L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "alloc.h"
+#include "backtrace.h"
+#include "error.h"
+#include "eval.h"
+#include "function_stats.h"
+#include "profile.h"
+#include "room.h"
+#include "symbols.h"
+
+static const char *g_room_type_names[ROOM_TYPES] = {
+        [FORM_CONS]            = "cons",
+        [FORM_STRING]          = "string",
+        [FORM_SYMBOL]          = "symbol",
+        [FORM_PACKAGE]         = "package",
+        [FORM_CFUN]            = "cfun",
+        [FORM_LAMBDA]          = "lambda",
+        [FORM_LONG]            = "long",
+        [FORM_DOUBLE]          = "double",
+        [FORM_SKIPLIST]        = "skiplist",
+        [FORM_SKIPLIST_NODE]   = "skiplist-node",
+        [FORM_FRAME]           = "frame",
+        [FORM_HASHTABLE]       = "hashtable",
+        [FORM_VECTOR]          = "vector",
+        [FORM_CHARACTER]       = "character",
+        [FORM_OSTREAM]         = "string-output-stream",
+        [FORM_THREAD]          = "thread",
+        [FORM_FUTURE]          = "future",
+        [FORM_COROUTINE]       = "coroutine",
+        [FORM_CHANNEL]         = "channel",
+        [ROOM_BACKTRACE_FRAME] = "backtrace-frame"
+};
+
+/* Counts since tracking started, by type and for the allocations
+   made outside any function. */
+static unsigned long g_room_objects[ROOM_TYPES];
+static unsigned long g_room_bytes[ROOM_TYPES];
+static unsigned long g_room_toplevel_objects = 0;
+static unsigned long g_room_toplevel_bytes = 0;
+static unsigned long g_room_total_objects = 0;
+static unsigned long g_room_total_bytes = 0;
+static int g_room_tracking = 0;
+
+/* A point each time the bytes allocated grow by g_room_step. When
+   the timeline is full every other point is dropped and the step
+   doubles. */
+static pthread_mutex_t g_room_mutex = PTHREAD_MUTEX_INITIALIZER;
+static s_room_point g_room_timeline[ROOM_TIMELINE_SIZE];
+static unsigned long g_room_points = 0;
+static unsigned long g_room_step = ROOM_TIMELINE_STEP;
+static unsigned long g_room_next = ROOM_TIMELINE_STEP;
+static unsigned long g_room_start = 0;
+
+static unsigned long room_now (void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+static void room_point (unsigned long objects, unsigned long bytes)
+{
+        s_room_point *p;
+        pthread_mutex_lock(&g_room_mutex);
+        if (bytes >= g_room_next) {
+                if (g_room_points == ROOM_TIMELINE_SIZE) {
+                        unsigned long i;
+                        for (i = 0; i < ROOM_TIMELINE_SIZE / 2; i++)
+                                g_room_timeline[i] =
+                                        g_room_timeline[2 * i + 1];
+                        g_room_points = ROOM_TIMELINE_SIZE / 2;
+                        g_room_step *= 2;
+                }
+                p = &g_room_timeline[g_room_points++];
+                p->ns = room_now() - g_room_start;
+                p->objects = objects;
+                p->bytes = bytes;
+                g_room_next = bytes - bytes % g_room_step + g_room_step;
+        }
+        pthread_mutex_unlock(&g_room_mutex);
+}
+
+/* The innermost Lisp function on the backtrace of the thread, or
+   the innermost special form or cfun if there is none. */
+static s_function_stats * room_site (void)
+{
+        s_env *env = profile_env();
+        s_backtrace_frame *bf;
+        if (!env || !env->backtrace)
+                return NULL;
+        for (bf = env->backtrace; bf; bf = bf->next)
+                if (bf->fun->type == FORM_LAMBDA)
+                        return function_stats(bf->fun);
+        return function_stats(env->backtrace->fun);
+}
+
+static void room_track (int type, size_t size)
+{
+        s_function_stats *site = room_site();
+        unsigned long objects;
+        unsigned long bytes;
+        __atomic_fetch_add(&g_room_objects[type], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&g_room_bytes[type], size, __ATOMIC_RELAXED);
+        if (site) {
+                __atomic_fetch_add(&site->site_objects, 1,
+                                   __ATOMIC_RELAXED);
+                __atomic_fetch_add(&site->site_bytes, size,
+                                   __ATOMIC_RELAXED);
+        }
+        else {
+                __atomic_fetch_add(&g_room_toplevel_objects, 1,
+                                   __ATOMIC_RELAXED);
+                __atomic_fetch_add(&g_room_toplevel_bytes, size,
+                                   __ATOMIC_RELAXED);
+        }
+        objects = __atomic_add_fetch(&g_room_total_objects, 1,
+                                     __ATOMIC_RELAXED);
+        bytes = __atomic_add_fetch(&g_room_total_bytes, size,
+                                   __ATOMIC_RELAXED);
+        if (bytes >= __atomic_load_n(&g_room_next, __ATOMIC_RELAXED))
+                room_point(objects, bytes);
+}
+
+/* Clears the counts and counts every allocation from now on. */
+void room_track_start (void)
+{
+        s_function_stats *stats;
+        unsigned long i;
+        room_track_stop();
+        for (i = 0; i < ROOM_TYPES; i++)
+                g_room_objects[i] = g_room_bytes[i] = 0;
+        for (stats = function_stats_list(); stats; stats = stats->next)
+                stats->site_objects = stats->site_bytes = 0;
+        g_room_toplevel_objects = g_room_toplevel_bytes = 0;
+        g_room_total_objects = g_room_total_bytes = 0;
+        g_room_points = 0;
+        g_room_step = g_room_next = ROOM_TIMELINE_STEP;
+        g_room_start = room_now();
+        g_room_tracking = 1;
+        __atomic_store_n(&g_alloc_track, room_track, __ATOMIC_RELEASE);
+}
+
+void room_track_stop (void)
+{
+        __atomic_store_n(&g_alloc_track, NULL, __ATOMIC_RELEASE);
+        g_room_tracking = 0;
+}
+
+static int room_compare (const void *a, const void *b)
+{
+        const s_function_stats *x = *(s_function_stats* const*) a;
+        const s_function_stats *y = *(s_function_stats* const*) b;
+        return x->site_bytes < y->site_bytes ? 1 :
+                x->site_bytes > y->site_bytes ? -1 : 0;
+}
+
+static void room_functions (FILE *fp)
+{
+        s_function_stats *stats;
+        s_function_stats **sites;
+        unsigned long max = 0;
+        unsigned long n = 0;
+        unsigned long i;
+        for (stats = function_stats_list(); stats; stats = stats->next)
+                if (stats->site_objects)
+                        max++;
+        if (!(sites = malloc((max + 1) * sizeof(s_function_stats*))))
+                return;
+        for (stats = function_stats_list(); stats && n < max;
+             stats = stats->next)
+                if (stats->site_objects)
+                        sites[n++] = stats;
+        qsort(sites, n, sizeof(s_function_stats*), room_compare);
+        fprintf(fp, "\n%-24s %12s %14s\n", "Function", "Objects",
+                "Bytes");
+        for (i = 0; i < n; i++) {
+                s_string *name = function_stats_name(sites[i]);
+                fprintf(fp, "%-24.*s %12lu %14lu\n", (int) name->length,
+                        string_str(name), sites[i]->site_objects,
+                        sites[i]->site_bytes);
+        }
+        if (g_room_toplevel_objects)
+                fprintf(fp, "%-24s %12lu %14lu\n", "(toplevel)",
+                        g_room_toplevel_objects, g_room_toplevel_bytes);
+        free(sites);
+}
+
+static void room_detail (FILE *fp)
+{
+        unsigned long i;
+        fprintf(fp, "\n%-24s %12s %14s\n", "Type", "Objects", "Bytes");
+        for (i = 0; i < ROOM_TYPES; i++)
+                if (g_room_objects[i])
+                        fprintf(fp, "%-24s %12lu %14lu\n",
+                                g_room_type_names[i], g_room_objects[i],
+                                g_room_bytes[i]);
+        room_functions(fp);
+        pthread_mutex_lock(&g_room_mutex);
+        fprintf(fp, "\n%-24s %12s %14s\n", "Milliseconds", "Objects",
+                "Bytes");
+        for (i = 0; i < g_room_points; i++)
+                fprintf(fp, "%-24lu %12lu %14lu\n",
+                        g_room_timeline[i].ns / 1000000,
+                        g_room_timeline[i].objects,
+                        g_room_timeline[i].bytes);
+        pthread_mutex_unlock(&g_room_mutex);
+}
+
+u_form * cfun_alloc_tracking_start (u_form *args, s_env *env)
+{
+        if (args != nil())
+                return error(env, "invalid arguments for "
+                             "alloc-tracking-start");
+        room_track_start();
+        return g_sym.t;
+}
+
+u_form * cfun_alloc_tracking_stop (u_form *args, s_env *env)
+{
+        if (args != nil())
+                return error(env, "invalid arguments for "
+                             "alloc-tracking-stop");
+        room_track_stop();
+        return nil();
+}
+
+/* (room &key detail) prints the objects and bytes allocated since
+   alloc-tracking-start, and with detail the counts by type and by
+   the function that made them, and how they grew. */
+u_form * cfun_room (u_form *args, s_env *env)
+{
+        u_form *detail = getf(args, g_kw.detail, nil());
+        if (args != nil() && (!consp(args) ||
+                              args->cons.car != g_kw.detail ||
+                              !consp(args->cons.cdr) ||
+                              args->cons.cdr->cons.cdr != nil()))
+                return error(env, "invalid arguments for room");
+        fprintf(stdout, "Allocation tracking is %s.\n",
+                g_room_tracking ? "on" : "off");
+        fprintf(stdout, "%lu objects, %lu bytes allocated while "
+                "tracking.\n", g_room_total_objects, g_room_total_bytes);
+        if (detail != nil())
+                room_detail(stdout);
+        return nil();
+}
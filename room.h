@@ -0,0 +1,31 @@
+#ifndef ROOM_H
+#define ROOM_H
+
+#include "env.h"
+#include "form.h"
+
+/* Allocations are counted by form type, backtrace frames after the
+   last one. */
+#define ROOM_BACKTRACE_FRAME (FORM_CHANNEL + 1)
+#define ROOM_TYPES           (FORM_CHANNEL + 2)
+
+#define ROOM_TIMELINE_SIZE 256
+#define ROOM_TIMELINE_STEP (1024 * 1024)
+
+typedef struct room_point s_room_point;
+
+/* The objects and bytes allocated after ns nanoseconds of tracking. */
+struct room_point {
+        unsigned long ns;
+        unsigned long objects;
+        unsigned long bytes;
+};
+
+void room_track_start (void);
+void room_track_stop (void);
+
+u_form * cfun_alloc_tracking_start (u_form *args, s_env *env);
+u_form * cfun_alloc_tracking_stop (u_form *args, s_env *env);
+u_form * cfun_room (u_form *args, s_env *env);
+
+#endif
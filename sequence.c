@@ -0,0 +1,388 @@
+
+#include <stdlib.h>
+#include "env.h"
+#include "error.h"
+#include "eval.h"
+#include "package.h"
+#include "sequence.h"
+#include "simd.h"
+#include "symbols.h"
+
+int seq_iter_init (s_seq_iter *it, u_form *seq)
+{
+        if (!listp(seq) && !vectorp(seq))
+                return -1;
+        it->seq = seq;
+        it->index = 0;
+        return 0;
+}
+
+int seq_iter_next (s_seq_iter *it, u_form **x)
+{
+        if (vectorp(it->seq)) {
+                if (it->index >= it->seq->vector.length)
+                        return 0;
+                *x = vector_ref(&it->seq->vector, it->index++);
+                return 1;
+        }
+        if (!consp(it->seq))
+                return 0;
+        *x = it->seq->cons.car;
+        it->seq = it->seq->cons.cdr;
+        return 1;
+}
+
+long seq_length (u_form *seq)
+{
+        if (vectorp(seq))
+                return seq->vector.length;
+        return length(seq);
+}
+
+static int numeric_vector_p (u_form *x)
+{
+        return vectorp(x) && x->vector.element_type != VECTOR_T;
+}
+
+static f_cfun * cfun_pointer (u_form *fun)
+{
+        if (fun->type == FORM_CFUN)
+                return fun->cfun.fun;
+        return NULL;
+}
+
+/* Reductions the kernels know about, NULL otherwise. */
+static u_form * reduce_vector (s_vector *v, f_cfun *f)
+{
+        if (!v->length)
+                return NULL;
+        if (f == cfun_plus)
+                switch (v->element_type) {
+                case VECTOR_U8:
+                        return (u_form*) new_long
+                                (g_simd.sum_u8(vector_u8(v), v->length));
+                case VECTOR_FIXNUM:
+                        return (u_form*) new_long
+                                (g_simd.sum_long(vector_fixnum(v),
+                                                 v->length));
+                case VECTOR_DOUBLE:
+                        return (u_form*) new_double
+                                (g_simd.sum_double(vector_double(v),
+                                                   v->length));
+                default:
+                        return NULL;
+                }
+        if (f == cfun_min)
+                switch (v->element_type) {
+                case VECTOR_U8:
+                        return (u_form*) new_long
+                                (g_simd.min_u8(vector_u8(v), v->length));
+                case VECTOR_FIXNUM:
+                        return (u_form*) new_long
+                                (g_simd.min_long(vector_fixnum(v),
+                                                 v->length));
+                case VECTOR_DOUBLE:
+                        return (u_form*) new_double
+                                (g_simd.min_double(vector_double(v),
+                                                   v->length));
+                default:
+                        return NULL;
+                }
+        if (f == cfun_max)
+                switch (v->element_type) {
+                case VECTOR_U8:
+                        return (u_form*) new_long
+                                (g_simd.max_u8(vector_u8(v), v->length));
+                case VECTOR_FIXNUM:
+                        return (u_form*) new_long
+                                (g_simd.max_long(vector_fixnum(v),
+                                                 v->length));
+                case VECTOR_DOUBLE:
+                        return (u_form*) new_double
+                                (g_simd.max_double(vector_double(v),
+                                                   v->length));
+                default:
+                        return NULL;
+                }
+        return NULL;
+}
+
+static u_form * apply_key (u_form *key, u_form *x, s_env *env)
+{
+        if (!key)
+                return x;
+        return funcall(key, cons(x, nil()), env);
+}
+
+static u_form * list2 (u_form *a, u_form *b)
+{
+        return cons(a, cons(b, nil()));
+}
+
+u_form * cfun_reduce (u_form *args, s_env *env)
+{
+        u_form *fun;
+        u_form *seq;
+        u_form *key;
+        u_form *acc;
+        u_form *x;
+        s_seq_iter it;
+        if (!consp(args) || !consp(args->cons.cdr))
+                return error(env, "invalid arguments for reduce");
+        fun = function_designator(args->cons.car, env);
+        seq = args->cons.cdr->cons.car;
+        acc = getf(cddr(args), g_kw.initial_value, NULL);
+        key = getf(cddr(args), g_kw.key, nil());
+        key = key == nil() ? NULL : function_designator(key, env);
+        if (seq_iter_init(&it, seq))
+                return error(env, "reduce: not a sequence");
+        if (!key && numeric_vector_p(seq) &&
+            (x = reduce_vector(&seq->vector, cfun_pointer(fun))))
+                return acc ? funcall(fun, list2(acc, x), env) : x;
+        if (!acc) {
+                if (!seq_iter_next(&it, &acc))
+                        return funcall(fun, nil(), env);
+                acc = apply_key(key, acc, env);
+        }
+        while (seq_iter_next(&it, &x))
+                acc = funcall(fun, list2(acc, apply_key(key, x, env)),
+                              env);
+        return acc;
+}
+
+static int map_into_vectors (u_form *dest, u_form *fun, u_form *seqs)
+{
+        f_cfun *f = cfun_pointer(fun);
+        e_simd_op op;
+        s_vector *d;
+        s_vector *a;
+        s_vector *b;
+        unsigned long n;
+        if (f == cfun_plus)
+                op = SIMD_ADD;
+        else if (f == cfun_minus)
+                op = SIMD_SUB;
+        else if (f == cfun_mul)
+                op = SIMD_MUL;
+        else
+                return 0;
+        if (!vectorp(dest) || length(seqs) != 2 ||
+            !vectorp(car(seqs)) || !vectorp(cadr(seqs)))
+                return 0;
+        d = &dest->vector;
+        a = &car(seqs)->vector;
+        b = &cadr(seqs)->vector;
+        if (a->element_type != d->element_type ||
+            b->element_type != d->element_type)
+                return 0;
+        n = d->length;
+        if (a->length < n)
+                n = a->length;
+        if (b->length < n)
+                n = b->length;
+        switch (d->element_type) {
+        case VECTOR_FIXNUM:
+                g_simd.map_long(op, vector_fixnum(d), vector_fixnum(a),
+                                vector_fixnum(b), n);
+                return 1;
+        case VECTOR_DOUBLE:
+                g_simd.map_double(op, vector_double(d), vector_double(a),
+                                  vector_double(b), n);
+                return 1;
+        default:
+                return 0;
+        }
+}
+
+u_form * cfun_map_into (u_form *args, s_env *env)
+{
+        u_form *dest;
+        u_form *fun;
+        u_form *seqs;
+        u_form *d;
+        s_seq_iter *its;
+        long count;
+        long n;
+        long i;
+        long j;
+        if (!consp(args) || !consp(args->cons.cdr))
+                return error(env, "invalid arguments for map-into");
+        dest = args->cons.car;
+        fun = function_designator(args->cons.cdr->cons.car, env);
+        seqs = cddr(args);
+        if (!listp(dest) && !vectorp(dest))
+                return error(env, "map-into: not a sequence");
+        if (map_into_vectors(dest, fun, seqs))
+                return dest;
+        count = length(seqs);
+        n = seq_length(dest);
+        if (!(its = malloc((count + 1) * sizeof(s_seq_iter))))
+                return error(env, "map-into: out of memory");
+        for (j = 0; j < count; j++) {
+                if (seq_iter_init(&its[j], car(seqs))) {
+                        free(its);
+                        return error(env, "map-into: not a sequence");
+                }
+                if (seq_length(car(seqs)) < n)
+                        n = seq_length(car(seqs));
+                seqs = cdr(seqs);
+        }
+        d = dest;
+        for (i = 0; i < n; i++) {
+                u_form *fargs = nil();
+                u_form **tail = &fargs;
+                u_form *x;
+                for (j = 0; j < count; j++) {
+                        seq_iter_next(&its[j], &x);
+                        *tail = cons(x, nil());
+                        tail = &(*tail)->cons.cdr;
+                }
+                x = funcall(fun, fargs, env);
+                if (consp(d)) {
+                        d->cons.car = x;
+                        d = d->cons.cdr;
+                }
+                else if (vector_set(&dest->vector, i, x)) {
+                        free(its);
+                        return error(env, "map-into: value does not "
+                                     "match the array element type");
+                }
+        }
+        free(its);
+        return dest;
+}
+
+u_form * cfun_dot_product (u_form *args, s_env *env)
+{
+        u_form *a;
+        u_form *b;
+        u_form *acc;
+        u_form *x;
+        u_form *y;
+        s_seq_iter ia;
+        s_seq_iter ib;
+        if (!consp(args) || !consp(args->cons.cdr) ||
+            cddr(args) != nil())
+                return error(env, "invalid arguments for dot-product");
+        a = args->cons.car;
+        b = args->cons.cdr->cons.car;
+        if (seq_length(a) != seq_length(b))
+                return error(env, "dot-product: length mismatch");
+        if (vectorp(a) && vectorp(b) &&
+            a->vector.element_type == b->vector.element_type) {
+                if (a->vector.element_type == VECTOR_DOUBLE)
+                        return (u_form*) new_double
+                                (g_simd.dot_double(vector_double(a),
+                                                   vector_double(b),
+                                                   a->vector.length));
+                if (a->vector.element_type == VECTOR_FIXNUM)
+                        return (u_form*) new_long
+                                (g_simd.dot_long(vector_fixnum(a),
+                                                 vector_fixnum(b),
+                                                 a->vector.length));
+        }
+        if (seq_iter_init(&ia, a) || seq_iter_init(&ib, b))
+                return error(env, "dot-product: not a sequence");
+        acc = (u_form*) new_long(0);
+        while (seq_iter_next(&ia, &x) && seq_iter_next(&ib, &y))
+                acc = cfun_plus(list2(acc, cfun_mul(list2(x, y), env)),
+                                env);
+        return acc;
+}
+
+/* (count item seq :test f) counts the elements e of seq for which
+   (f item e) is true, so the kernel compares e the other way. */
+static int count_cmp (u_form *test, e_simd_cmp *cmp)
+{
+        f_cfun *f;
+        if (!test) {
+                *cmp = SIMD_EQ;
+                return 1;
+        }
+        f = cfun_pointer(test);
+        if (f == cfun_lt)
+                *cmp = SIMD_GT;
+        else if (f == cfun_lte)
+                *cmp = SIMD_GTE;
+        else if (f == cfun_gt)
+                *cmp = SIMD_LT;
+        else if (f == cfun_gte)
+                *cmp = SIMD_LTE;
+        else if (f == cfun_num_eq)
+                *cmp = SIMD_EQ;
+        else
+                return 0;
+        return 1;
+}
+
+static u_form * count_vector (u_form *item, s_vector *v, u_form *test)
+{
+        e_simd_cmp cmp;
+        if (!count_cmp(test, &cmp))
+                return NULL;
+        if (v->element_type == VECTOR_FIXNUM && integerp(item))
+                return (u_form*) new_long
+                        (g_simd.count_long(vector_fixnum(v), v->length,
+                                           item->lng.lng, cmp));
+        if (v->element_type == VECTOR_DOUBLE && floatp(item))
+                return (u_form*) new_long
+                        (g_simd.count_double(vector_double(v), v->length,
+                                             item->dbl.dbl, cmp));
+        if (v->element_type == VECTOR_DOUBLE && integerp(item) && test)
+                return (u_form*) new_long
+                        (g_simd.count_double(vector_double(v), v->length,
+                                             item->lng.lng, cmp));
+        return NULL;
+}
+
+u_form * cfun_count (u_form *args, s_env *env)
+{
+        u_form *item;
+        u_form *seq;
+        u_form *test;
+        u_form *key;
+        u_form *x;
+        s_seq_iter it;
+        long count = 0;
+        if (!consp(args) || !consp(args->cons.cdr))
+                return error(env, "invalid arguments for count");
+        item = args->cons.car;
+        seq = args->cons.cdr->cons.car;
+        test = getf(cddr(args), g_kw.test, nil());
+        test = test == nil() ? NULL : function_designator(test, env);
+        key = getf(cddr(args), g_kw.key, nil());
+        key = key == nil() ? NULL : function_designator(key, env);
+        if (seq_iter_init(&it, seq))
+                return error(env, "count: not a sequence");
+        if (!key && numeric_vector_p(seq) && numberp(item) &&
+            (x = count_vector(item, &seq->vector, test)))
+                return x;
+        while (seq_iter_next(&it, &x)) {
+                x = apply_key(key, x, env);
+                if (test ? funcall(test, list2(item, x), env) != nil() :
+                    eql(item, x) != NULL)
+                        count++;
+        }
+        return (u_form*) new_long(count);
+}
+
+u_form * cfun_count_if (u_form *args, s_env *env)
+{
+        u_form *pred;
+        u_form *key;
+        u_form *x;
+        s_seq_iter it;
+        long count = 0;
+        if (!consp(args) || !consp(args->cons.cdr))
+                return error(env, "invalid arguments for count-if");
+        pred = function_designator(args->cons.car, env);
+        key = getf(cddr(args), g_kw.key, nil());
+        key = key == nil() ? NULL : function_designator(key, env);
+        if (seq_iter_init(&it, args->cons.cdr->cons.car))
+                return error(env, "count-if: not a sequence");
+        while (seq_iter_next(&it, &x))
+                if (funcall(pred, cons(apply_key(key, x, env), nil()),
+                            env) != nil())
+                        count++;
+        return (u_form*) new_long(count);
+}
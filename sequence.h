@@ -0,0 +1,24 @@
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#include "form.h"
+
+typedef struct seq_iter s_seq_iter;
+
+/* Walks a proper list or the active elements of a vector. */
+struct seq_iter {
+        u_form *seq;
+        unsigned long index;
+};
+
+int      seq_iter_init (s_seq_iter *it, u_form *seq);
+int      seq_iter_next (s_seq_iter *it, u_form **x);
+long     seq_length (u_form *seq);
+
+u_form * cfun_reduce (u_form *args, s_env *env);
+u_form * cfun_map_into (u_form *args, s_env *env);
+u_form * cfun_dot_product (u_form *args, s_env *env);
+u_form * cfun_count (u_form *args, s_env *env);
+u_form * cfun_count_if (u_form *args, s_env *env);
+
+#endif
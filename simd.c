@@ -0,0 +1,711 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include "simd.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+# define SIMD_X86 1
+# include <immintrin.h>
+# define AVX2 __attribute__((target("avx2")))
+#endif
+
+/* Scalar kernels. Several accumulators break the dependency chain
+   so that the compiler can keep more than one add in flight. */
+
+static double scalar_sum_double (const double *a, unsigned long n)
+{
+        double s0 = 0.0;
+        double s1 = 0.0;
+        double s2 = 0.0;
+        double s3 = 0.0;
+        unsigned long i = 0;
+        for (; i + 4 <= n; i += 4) {
+                s0 += a[i];
+                s1 += a[i + 1];
+                s2 += a[i + 2];
+                s3 += a[i + 3];
+        }
+        for (; i < n; i++)
+                s0 += a[i];
+        return (s0 + s1) + (s2 + s3);
+}
+
+static long scalar_sum_long (const long *a, unsigned long n)
+{
+        unsigned long s = 0;
+        unsigned long i;
+        for (i = 0; i < n; i++)
+                s += a[i];
+        return (long) s;
+}
+
+static long scalar_sum_u8 (const unsigned char *a, unsigned long n)
+{
+        long s = 0;
+        unsigned long i;
+        for (i = 0; i < n; i++)
+                s += a[i];
+        return s;
+}
+
+#define DEF_SCALAR_MINMAX(name, type, CMP)                              \
+static type name (const type *a, unsigned long n)                       \
+{                                                                       \
+        type m = a[0];                                                  \
+        unsigned long i;                                                \
+        for (i = 1; i < n; i++)                                         \
+                if (a[i] CMP m)                                         \
+                        m = a[i];                                       \
+        return m;                                                       \
+}
+
+DEF_SCALAR_MINMAX(scalar_min_double, double, <)
+DEF_SCALAR_MINMAX(scalar_max_double, double, >)
+DEF_SCALAR_MINMAX(scalar_min_long, long, <)
+DEF_SCALAR_MINMAX(scalar_max_long, long, >)
+DEF_SCALAR_MINMAX(scalar_min_u8, unsigned char, <)
+DEF_SCALAR_MINMAX(scalar_max_u8, unsigned char, >)
+
+static double scalar_dot_double (const double *a, const double *b,
+                                 unsigned long n)
+{
+        double s0 = 0.0;
+        double s1 = 0.0;
+        unsigned long i = 0;
+        for (; i + 2 <= n; i += 2) {
+                s0 += a[i] * b[i];
+                s1 += a[i + 1] * b[i + 1];
+        }
+        for (; i < n; i++)
+                s0 += a[i] * b[i];
+        return s0 + s1;
+}
+
+static long scalar_dot_long (const long *a, const long *b,
+                             unsigned long n)
+{
+        unsigned long s = 0;
+        unsigned long i;
+        for (i = 0; i < n; i++)
+                s += (unsigned long) a[i] * (unsigned long) b[i];
+        return (long) s;
+}
+
+#define SCALAR_COUNT(a, n, x, CMP, count)                               \
+        do {                                                            \
+                unsigned long i_;                                       \
+                for (i_ = 0; i_ < (n); i_++)                            \
+                        (count) += (a)[i_] CMP (x);                     \
+        } while (0)
+
+#define DEF_SCALAR_COUNT(name, type)                                    \
+static unsigned long name (const type *a, unsigned long n, type x,      \
+                           e_simd_cmp cmp)                              \
+{                                                                       \
+        unsigned long count = 0;                                        \
+        switch (cmp) {                                                  \
+        case SIMD_LT:  SCALAR_COUNT(a, n, x, <, count);  break;         \
+        case SIMD_LTE: SCALAR_COUNT(a, n, x, <=, count); break;         \
+        case SIMD_GT:  SCALAR_COUNT(a, n, x, >, count);  break;         \
+        case SIMD_GTE: SCALAR_COUNT(a, n, x, >=, count); break;         \
+        case SIMD_EQ:  SCALAR_COUNT(a, n, x, ==, count); break;         \
+        }                                                               \
+        return count;                                                   \
+}
+
+DEF_SCALAR_COUNT(scalar_count_double, double)
+DEF_SCALAR_COUNT(scalar_count_long, long)
+
+#define SCALAR_MAP(dst, a, b, n, OP)                                    \
+        do {                                                            \
+                unsigned long i_;                                       \
+                for (i_ = 0; i_ < (n); i_++)                            \
+                        (dst)[i_] = (a)[i_] OP (b)[i_];                 \
+        } while (0)
+
+static void scalar_map_double (e_simd_op op, double *dst, const double *a,
+                               const double *b, unsigned long n)
+{
+        switch (op) {
+        case SIMD_ADD: SCALAR_MAP(dst, a, b, n, +); break;
+        case SIMD_SUB: SCALAR_MAP(dst, a, b, n, -); break;
+        case SIMD_MUL: SCALAR_MAP(dst, a, b, n, *); break;
+        }
+}
+
+static void scalar_map_long (e_simd_op op, long *dst, const long *a,
+                             const long *b, unsigned long n)
+{
+        unsigned long *d = (unsigned long*) dst;
+        const unsigned long *ua = (const unsigned long*) a;
+        const unsigned long *ub = (const unsigned long*) b;
+        switch (op) {
+        case SIMD_ADD: SCALAR_MAP(d, ua, ub, n, +); break;
+        case SIMD_SUB: SCALAR_MAP(d, ua, ub, n, -); break;
+        case SIMD_MUL: SCALAR_MAP(d, ua, ub, n, *); break;
+        }
+}
+
+#ifdef SIMD_X86
+
+/* SSE2 is part of the x86-64 baseline : doubles and bytes only,
+   64 bit integer compares need SSE4.2. */
+
+static double sse2_hsum_pd (__m128d v)
+{
+        double t[2];
+        _mm_storeu_pd(t, v);
+        return t[0] + t[1];
+}
+
+static double sse2_sum_double (const double *a, unsigned long n)
+{
+        __m128d s0 = _mm_setzero_pd();
+        __m128d s1 = _mm_setzero_pd();
+        unsigned long i = 0;
+        double s;
+        for (; i + 4 <= n; i += 4) {
+                s0 = _mm_add_pd(s0, _mm_loadu_pd(a + i));
+                s1 = _mm_add_pd(s1, _mm_loadu_pd(a + i + 2));
+        }
+        s = sse2_hsum_pd(_mm_add_pd(s0, s1));
+        for (; i < n; i++)
+                s += a[i];
+        return s;
+}
+
+static long sse2_sum_long (const long *a, unsigned long n)
+{
+        __m128i s = _mm_setzero_si128();
+        unsigned long i = 0;
+        unsigned long t[2];
+        for (; i + 2 <= n; i += 2)
+                s = _mm_add_epi64(s, _mm_loadu_si128((const __m128i*)
+                                                     (a + i)));
+        _mm_storeu_si128((__m128i*) t, s);
+        t[0] += t[1];
+        for (; i < n; i++)
+                t[0] += a[i];
+        return (long) t[0];
+}
+
+static long sse2_sum_u8 (const unsigned char *a, unsigned long n)
+{
+        __m128i s = _mm_setzero_si128();
+        __m128i zero = _mm_setzero_si128();
+        unsigned long i = 0;
+        unsigned long t[2];
+        for (; i + 16 <= n; i += 16)
+                s = _mm_add_epi64(s, _mm_sad_epu8(_mm_loadu_si128
+                                                  ((const __m128i*)
+                                                   (a + i)), zero));
+        _mm_storeu_si128((__m128i*) t, s);
+        t[0] += t[1];
+        for (; i < n; i++)
+                t[0] += a[i];
+        return (long) t[0];
+}
+
+#define DEF_SSE2_MINMAX_PD(name, OP, CMP)                               \
+static double name (const double *a, unsigned long n)                   \
+{                                                                       \
+        __m128d m = _mm_set1_pd(a[0]);                                  \
+        unsigned long i = 0;                                            \
+        double t[2];                                                    \
+        for (; i + 2 <= n; i += 2)                                      \
+                m = OP(m, _mm_loadu_pd(a + i));                         \
+        _mm_storeu_pd(t, m);                                            \
+        if (t[1] CMP t[0])                                              \
+                t[0] = t[1];                                            \
+        for (; i < n; i++)                                              \
+                if (a[i] CMP t[0])                                      \
+                        t[0] = a[i];                                    \
+        return t[0];                                                    \
+}
+
+DEF_SSE2_MINMAX_PD(sse2_min_double, _mm_min_pd, <)
+DEF_SSE2_MINMAX_PD(sse2_max_double, _mm_max_pd, >)
+
+#define DEF_SSE2_MINMAX_U8(name, OP, CMP)                               \
+static unsigned char name (const unsigned char *a, unsigned long n)     \
+{                                                                       \
+        __m128i m = _mm_set1_epi8((char) a[0]);                         \
+        unsigned long i = 0;                                            \
+        unsigned char t[16];                                            \
+        unsigned char r;                                                \
+        for (; i + 16 <= n; i += 16)                                    \
+                m = OP(m, _mm_loadu_si128((const __m128i*) (a + i)));   \
+        _mm_storeu_si128((__m128i*) t, m);                              \
+        r = t[0];                                                       \
+        for (n -= i, a += i, i = 1; i < 16; i++)                        \
+                if (t[i] CMP r)                                         \
+                        r = t[i];                                       \
+        for (i = 0; i < n; i++)                                         \
+                if (a[i] CMP r)                                         \
+                        r = a[i];                                       \
+        return r;                                                       \
+}
+
+DEF_SSE2_MINMAX_U8(sse2_min_u8, _mm_min_epu8, <)
+DEF_SSE2_MINMAX_U8(sse2_max_u8, _mm_max_epu8, >)
+
+static double sse2_dot_double (const double *a, const double *b,
+                               unsigned long n)
+{
+        __m128d s0 = _mm_setzero_pd();
+        __m128d s1 = _mm_setzero_pd();
+        unsigned long i = 0;
+        double s;
+        for (; i + 4 <= n; i += 4) {
+                s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(a + i),
+                                               _mm_loadu_pd(b + i)));
+                s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(a + i + 2),
+                                               _mm_loadu_pd(b + i + 2)));
+        }
+        s = sse2_hsum_pd(_mm_add_pd(s0, s1));
+        for (; i < n; i++)
+                s += a[i] * b[i];
+        return s;
+}
+
+#define SSE2_COUNT_PD(a, n, x, OP, count)                               \
+        do {                                                            \
+                __m128d x_ = _mm_set1_pd(x);                            \
+                unsigned long i_ = 0;                                   \
+                for (; i_ + 2 <= (n); i_ += 2)                          \
+                        (count) += __builtin_popcount                   \
+                                (_mm_movemask_pd                        \
+                                 (OP(_mm_loadu_pd((a) + i_), x_)));     \
+                (a) += i_;                                              \
+                (n) -= i_;                                              \
+        } while (0)
+
+static unsigned long sse2_count_double (const double *a, unsigned long n,
+                                        double x, e_simd_cmp cmp)
+{
+        unsigned long count = 0;
+        switch (cmp) {
+        case SIMD_LT:  SSE2_COUNT_PD(a, n, x, _mm_cmplt_pd, count); break;
+        case SIMD_LTE: SSE2_COUNT_PD(a, n, x, _mm_cmple_pd, count); break;
+        case SIMD_GT:  SSE2_COUNT_PD(a, n, x, _mm_cmpgt_pd, count); break;
+        case SIMD_GTE: SSE2_COUNT_PD(a, n, x, _mm_cmpge_pd, count); break;
+        case SIMD_EQ:  SSE2_COUNT_PD(a, n, x, _mm_cmpeq_pd, count); break;
+        }
+        return count + scalar_count_double(a, n, x, cmp);
+}
+
+#define SSE2_MAP_PD(dst, a, b, n, OP)                                   \
+        do {                                                            \
+                unsigned long i_ = 0;                                   \
+                for (; i_ + 2 <= (n); i_ += 2)                          \
+                        _mm_storeu_pd((dst) + i_,                       \
+                                      OP(_mm_loadu_pd((a) + i_),        \
+                                         _mm_loadu_pd((b) + i_)));      \
+                (dst) += i_;                                            \
+                (a) += i_;                                              \
+                (b) += i_;                                              \
+                (n) -= i_;                                              \
+        } while (0)
+
+static void sse2_map_double (e_simd_op op, double *dst, const double *a,
+                             const double *b, unsigned long n)
+{
+        switch (op) {
+        case SIMD_ADD: SSE2_MAP_PD(dst, a, b, n, _mm_add_pd); break;
+        case SIMD_SUB: SSE2_MAP_PD(dst, a, b, n, _mm_sub_pd); break;
+        case SIMD_MUL: SSE2_MAP_PD(dst, a, b, n, _mm_mul_pd); break;
+        }
+        scalar_map_double(op, dst, a, b, n);
+}
+
+static void sse2_map_long (e_simd_op op, long *dst, const long *a,
+                           const long *b, unsigned long n)
+{
+        unsigned long i = 0;
+        if (op != SIMD_MUL)
+                for (; i + 2 <= n; i += 2) {
+                        __m128i va = _mm_loadu_si128((const __m128i*)
+                                                     (a + i));
+                        __m128i vb = _mm_loadu_si128((const __m128i*)
+                                                     (b + i));
+                        _mm_storeu_si128((__m128i*) (dst + i),
+                                         op == SIMD_ADD ?
+                                         _mm_add_epi64(va, vb) :
+                                         _mm_sub_epi64(va, vb));
+                }
+        scalar_map_long(op, dst + i, a + i, b + i, n - i);
+}
+
+/* AVX2 kernels, compiled for the target regardless of the build
+   flags and only called when the CPU reports AVX2. */
+
+AVX2 static double avx2_hsum_pd (__m256d v)
+{
+        double t[4];
+        _mm256_storeu_pd(t, v);
+        return (t[0] + t[1]) + (t[2] + t[3]);
+}
+
+AVX2 static double avx2_sum_double (const double *a, unsigned long n)
+{
+        __m256d s0 = _mm256_setzero_pd();
+        __m256d s1 = _mm256_setzero_pd();
+        unsigned long i = 0;
+        double s;
+        for (; i + 8 <= n; i += 8) {
+                s0 = _mm256_add_pd(s0, _mm256_loadu_pd(a + i));
+                s1 = _mm256_add_pd(s1, _mm256_loadu_pd(a + i + 4));
+        }
+        s = avx2_hsum_pd(_mm256_add_pd(s0, s1));
+        for (; i < n; i++)
+                s += a[i];
+        return s;
+}
+
+AVX2 static unsigned long avx2_hsum_epi64 (__m256i v)
+{
+        unsigned long t[4];
+        _mm256_storeu_si256((__m256i*) t, v);
+        return (t[0] + t[1]) + (t[2] + t[3]);
+}
+
+AVX2 static long avx2_sum_long (const long *a, unsigned long n)
+{
+        __m256i s0 = _mm256_setzero_si256();
+        __m256i s1 = _mm256_setzero_si256();
+        unsigned long i = 0;
+        unsigned long s;
+        for (; i + 8 <= n; i += 8) {
+                s0 = _mm256_add_epi64(s0, _mm256_loadu_si256
+                                      ((const __m256i*) (a + i)));
+                s1 = _mm256_add_epi64(s1, _mm256_loadu_si256
+                                      ((const __m256i*) (a + i + 4)));
+        }
+        s = avx2_hsum_epi64(_mm256_add_epi64(s0, s1));
+        for (; i < n; i++)
+                s += a[i];
+        return (long) s;
+}
+
+AVX2 static long avx2_sum_u8 (const unsigned char *a, unsigned long n)
+{
+        __m256i s = _mm256_setzero_si256();
+        __m256i zero = _mm256_setzero_si256();
+        unsigned long i = 0;
+        unsigned long t;
+        for (; i + 32 <= n; i += 32)
+                s = _mm256_add_epi64(s, _mm256_sad_epu8
+                                     (_mm256_loadu_si256((const __m256i*)
+                                                         (a + i)),
+                                      zero));
+        t = avx2_hsum_epi64(s);
+        for (; i < n; i++)
+                t += a[i];
+        return (long) t;
+}
+
+#define DEF_AVX2_MINMAX_PD(name, OP, CMP)                               \
+AVX2 static double name (const double *a, unsigned long n)              \
+{                                                                       \
+        __m256d m = _mm256_set1_pd(a[0]);                               \
+        unsigned long i = 0;                                            \
+        double t[4];                                                    \
+        double r;                                                       \
+        for (; i + 4 <= n; i += 4)                                      \
+                m = OP(m, _mm256_loadu_pd(a + i));                      \
+        _mm256_storeu_pd(t, m);                                         \
+        r = t[0];                                                       \
+        if (t[1] CMP r)                                                 \
+                r = t[1];                                               \
+        if (t[2] CMP r)                                                 \
+                r = t[2];                                               \
+        if (t[3] CMP r)                                                 \
+                r = t[3];                                               \
+        for (; i < n; i++)                                              \
+                if (a[i] CMP r)                                         \
+                        r = a[i];                                       \
+        return r;                                                       \
+}
+
+DEF_AVX2_MINMAX_PD(avx2_min_double, _mm256_min_pd, <)
+DEF_AVX2_MINMAX_PD(avx2_max_double, _mm256_max_pd, >)
+
+/* No 64 bit min or max before AVX-512 : select through a compare
+   mask. */
+#define DEF_AVX2_MINMAX_EPI64(name, CMP, GT_ARGS)                       \
+AVX2 static long name (const long *a, unsigned long n)                  \
+{                                                                       \
+        __m256i m = _mm256_set1_epi64x(a[0]);                           \
+        unsigned long i = 0;                                            \
+        long t[4];                                                      \
+        long r;                                                         \
+        for (; i + 4 <= n; i += 4) {                                    \
+                __m256i v = _mm256_loadu_si256((const __m256i*)         \
+                                               (a + i));                \
+                m = _mm256_blendv_epi8(m, v, _mm256_cmpgt_epi64         \
+                                       GT_ARGS);                        \
+        }                                                               \
+        _mm256_storeu_si256((__m256i*) t, m);                           \
+        r = t[0];                                                       \
+        if (t[1] CMP r)                                                 \
+                r = t[1];                                               \
+        if (t[2] CMP r)                                                 \
+                r = t[2];                                               \
+        if (t[3] CMP r)                                                 \
+                r = t[3];                                               \
+        for (; i < n; i++)                                              \
+                if (a[i] CMP r)                                         \
+                        r = a[i];                                       \
+        return r;                                                       \
+}
+
+DEF_AVX2_MINMAX_EPI64(avx2_min_long, <, (m, v))
+DEF_AVX2_MINMAX_EPI64(avx2_max_long, >, (v, m))
+
+#define DEF_AVX2_MINMAX_U8(name, OP, CMP)                               \
+AVX2 static unsigned char name (const unsigned char *a,                 \
+                                unsigned long n)                        \
+{                                                                       \
+        __m256i m = _mm256_set1_epi8((char) a[0]);                      \
+        unsigned long i = 0;                                            \
+        unsigned char t[32];                                            \
+        unsigned char r;                                                \
+        for (; i + 32 <= n; i += 32)                                    \
+                m = OP(m, _mm256_loadu_si256((const __m256i*)           \
+                                             (a + i)));                 \
+        _mm256_storeu_si256((__m256i*) t, m);                           \
+        r = t[0];                                                       \
+        for (n -= i, a += i, i = 1; i < 32; i++)                        \
+                if (t[i] CMP r)                                         \
+                        r = t[i];                                       \
+        for (i = 0; i < n; i++)                                         \
+                if (a[i] CMP r)                                         \
+                        r = a[i];                                       \
+        return r;                                                       \
+}
+
+DEF_AVX2_MINMAX_U8(avx2_min_u8, _mm256_min_epu8, <)
+DEF_AVX2_MINMAX_U8(avx2_max_u8, _mm256_max_epu8, >)
+
+AVX2 static double avx2_dot_double (const double *a, const double *b,
+                                    unsigned long n)
+{
+        __m256d s0 = _mm256_setzero_pd();
+        __m256d s1 = _mm256_setzero_pd();
+        unsigned long i = 0;
+        double s;
+        for (; i + 8 <= n; i += 8) {
+                s0 = _mm256_add_pd(s0, _mm256_mul_pd
+                                   (_mm256_loadu_pd(a + i),
+                                    _mm256_loadu_pd(b + i)));
+                s1 = _mm256_add_pd(s1, _mm256_mul_pd
+                                   (_mm256_loadu_pd(a + i + 4),
+                                    _mm256_loadu_pd(b + i + 4)));
+        }
+        s = avx2_hsum_pd(_mm256_add_pd(s0, s1));
+        for (; i < n; i++)
+                s += a[i] * b[i];
+        return s;
+}
+
+#define AVX2_COUNT_PD(a, n, x, PRED, count)                             \
+        do {                                                            \
+                __m256d x_ = _mm256_set1_pd(x);                         \
+                unsigned long i_ = 0;                                   \
+                for (; i_ + 4 <= (n); i_ += 4)                          \
+                        (count) += __builtin_popcount                   \
+                                (_mm256_movemask_pd                     \
+                                 (_mm256_cmp_pd(_mm256_loadu_pd         \
+                                                ((a) + i_), x_,         \
+                                                PRED)));                \
+                (a) += i_;                                              \
+                (n) -= i_;                                              \
+        } while (0)
+
+AVX2 static unsigned long avx2_count_double (const double *a,
+                                             unsigned long n, double x,
+                                             e_simd_cmp cmp)
+{
+        unsigned long count = 0;
+        switch (cmp) {
+        case SIMD_LT:  AVX2_COUNT_PD(a, n, x, _CMP_LT_OQ, count); break;
+        case SIMD_LTE: AVX2_COUNT_PD(a, n, x, _CMP_LE_OQ, count); break;
+        case SIMD_GT:  AVX2_COUNT_PD(a, n, x, _CMP_GT_OQ, count); break;
+        case SIMD_GTE: AVX2_COUNT_PD(a, n, x, _CMP_GE_OQ, count); break;
+        case SIMD_EQ:  AVX2_COUNT_PD(a, n, x, _CMP_EQ_OQ, count); break;
+        }
+        return count + scalar_count_double(a, n, x, cmp);
+}
+
+/* Only > and = exist for 64 bit integers : a < x is x > a, and
+   <= and >= count the complement. */
+AVX2 static unsigned long avx2_count_long (const long *a, unsigned long n,
+                                           long x, e_simd_cmp cmp)
+{
+        __m256i vx = _mm256_set1_epi64x(x);
+        unsigned long count = 0;
+        unsigned long i = 0;
+        for (; i + 4 <= n; i += 4) {
+                __m256i v = _mm256_loadu_si256((const __m256i*) (a + i));
+                __m256i c;
+                switch (cmp) {
+                case SIMD_LT:
+                case SIMD_GTE:
+                        c = _mm256_cmpgt_epi64(vx, v);
+                        break;
+                case SIMD_GT:
+                case SIMD_LTE:
+                        c = _mm256_cmpgt_epi64(v, vx);
+                        break;
+                default:
+                        c = _mm256_cmpeq_epi64(v, vx);
+                }
+                count += __builtin_popcount(_mm256_movemask_pd
+                                            (_mm256_castsi256_pd(c)));
+        }
+        if (cmp == SIMD_LTE || cmp == SIMD_GTE)
+                count = i - count;
+        return count + scalar_count_long(a + i, n - i, x, cmp);
+}
+
+#define AVX2_MAP_PD(dst, a, b, n, OP)                                   \
+        do {                                                            \
+                unsigned long i_ = 0;                                   \
+                for (; i_ + 4 <= (n); i_ += 4)                          \
+                        _mm256_storeu_pd((dst) + i_,                    \
+                                         OP(_mm256_loadu_pd((a) + i_),  \
+                                            _mm256_loadu_pd((b) + i_)));\
+                (dst) += i_;                                            \
+                (a) += i_;                                              \
+                (b) += i_;                                              \
+                (n) -= i_;                                              \
+        } while (0)
+
+AVX2 static void avx2_map_double (e_simd_op op, double *dst,
+                                  const double *a, const double *b,
+                                  unsigned long n)
+{
+        switch (op) {
+        case SIMD_ADD: AVX2_MAP_PD(dst, a, b, n, _mm256_add_pd); break;
+        case SIMD_SUB: AVX2_MAP_PD(dst, a, b, n, _mm256_sub_pd); break;
+        case SIMD_MUL: AVX2_MAP_PD(dst, a, b, n, _mm256_mul_pd); break;
+        }
+        scalar_map_double(op, dst, a, b, n);
+}
+
+AVX2 static void avx2_map_long (e_simd_op op, long *dst, const long *a,
+                                const long *b, unsigned long n)
+{
+        unsigned long i = 0;
+        if (op != SIMD_MUL)
+                for (; i + 4 <= n; i += 4) {
+                        __m256i va = _mm256_loadu_si256((const __m256i*)
+                                                        (a + i));
+                        __m256i vb = _mm256_loadu_si256((const __m256i*)
+                                                        (b + i));
+                        _mm256_storeu_si256((__m256i*) (dst + i),
+                                            op == SIMD_ADD ?
+                                            _mm256_add_epi64(va, vb) :
+                                            _mm256_sub_epi64(va, vb));
+                }
+        scalar_map_long(op, dst + i, a + i, b + i, n - i);
+}
+
+#endif /* SIMD_X86 */
+
+static const s_simd g_simd_scalar = {
+        "scalar",
+        scalar_sum_double,
+        scalar_sum_long,
+        scalar_sum_u8,
+        scalar_min_double,
+        scalar_max_double,
+        scalar_min_long,
+        scalar_max_long,
+        scalar_min_u8,
+        scalar_max_u8,
+        scalar_dot_double,
+        scalar_dot_long,
+        scalar_count_double,
+        scalar_count_long,
+        scalar_map_double,
+        scalar_map_long
+};
+
+#ifdef SIMD_X86
+
+static const s_simd g_simd_sse2 = {
+        "sse2",
+        sse2_sum_double,
+        sse2_sum_long,
+        sse2_sum_u8,
+        sse2_min_double,
+        sse2_max_double,
+        scalar_min_long,
+        scalar_max_long,
+        sse2_min_u8,
+        sse2_max_u8,
+        sse2_dot_double,
+        scalar_dot_long,
+        sse2_count_double,
+        scalar_count_long,
+        sse2_map_double,
+        sse2_map_long
+};
+
+static const s_simd g_simd_avx2 = {
+        "avx2",
+        avx2_sum_double,
+        avx2_sum_long,
+        avx2_sum_u8,
+        avx2_min_double,
+        avx2_max_double,
+        avx2_min_long,
+        avx2_max_long,
+        avx2_min_u8,
+        avx2_max_u8,
+        avx2_dot_double,
+        scalar_dot_long,
+        avx2_count_double,
+        avx2_count_long,
+        avx2_map_double,
+        avx2_map_long
+};
+
+#endif
+
+s_simd g_simd = {
+        "scalar",
+        scalar_sum_double,
+        scalar_sum_long,
+        scalar_sum_u8,
+        scalar_min_double,
+        scalar_max_double,
+        scalar_min_long,
+        scalar_max_long,
+        scalar_min_u8,
+        scalar_max_u8,
+        scalar_dot_double,
+        scalar_dot_long,
+        scalar_count_double,
+        scalar_count_long,
+        scalar_map_double,
+        scalar_map_long
+};
+
+void simd_init ()
+{
+        const char *want = getenv("CFACTS_SIMD");
+        g_simd = g_simd_scalar;
+        if (want && !strcmp(want, "scalar"))
+                return;
+#ifdef SIMD_X86
+        __builtin_cpu_init();
+        if ((!want || !strcmp(want, "avx2")) &&
+            __builtin_cpu_supports("avx2")) {
+                g_simd = g_simd_avx2;
+                return;
+        }
+        g_simd = g_simd_sse2;
+#endif
+}
@@ -0,0 +1,57 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+typedef enum simd_cmp {
+        SIMD_LT,
+        SIMD_LTE,
+        SIMD_GT,
+        SIMD_GTE,
+        SIMD_EQ
+} e_simd_cmp;
+
+typedef enum simd_op {
+        SIMD_ADD,
+        SIMD_SUB,
+        SIMD_MUL
+} e_simd_op;
+
+typedef struct simd s_simd;
+
+/* Kernels over flat numeric arrays. min and max require n > 0.
+   count returns the number of a[i] such that (a[i] cmp x). map
+   stores (a[i] op b[i]) into dst[i]; dst may alias a or b. Fixnum
+   arithmetic wraps around. */
+struct simd {
+        const char *name;
+        double        (*sum_double) (const double *a, unsigned long n);
+        long          (*sum_long) (const long *a, unsigned long n);
+        long          (*sum_u8) (const unsigned char *a, unsigned long n);
+        double        (*min_double) (const double *a, unsigned long n);
+        double        (*max_double) (const double *a, unsigned long n);
+        long          (*min_long) (const long *a, unsigned long n);
+        long          (*max_long) (const long *a, unsigned long n);
+        unsigned char (*min_u8) (const unsigned char *a, unsigned long n);
+        unsigned char (*max_u8) (const unsigned char *a, unsigned long n);
+        double        (*dot_double) (const double *a, const double *b,
+                                     unsigned long n);
+        long          (*dot_long) (const long *a, const long *b,
+                                   unsigned long n);
+        unsigned long (*count_double) (const double *a, unsigned long n,
+                                       double x, e_simd_cmp cmp);
+        unsigned long (*count_long) (const long *a, unsigned long n,
+                                     long x, e_simd_cmp cmp);
+        void          (*map_double) (e_simd_op op, double *dst,
+                                     const double *a, const double *b,
+                                     unsigned long n);
+        void          (*map_long) (e_simd_op op, long *dst, const long *a,
+                                   const long *b, unsigned long n);
+};
+
+/* Scalar kernels until simd_init selects the widest instruction set
+   the CPU supports, or the one named by CFACTS_SIMD (scalar, sse2,
+   avx2). */
+extern s_simd g_simd;
+
+void simd_init ();
+
+#endif
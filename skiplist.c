@@ -3,6 +3,7 @@
 #define _BSD_SOURCE 1
 #include <stdlib.h>
 #include <strings.h>
+#include "alloc.h"
 #include "form.h"
 #include "skiplist.h"
 
@@ -10,8 +11,10 @@ long int random(void);
 
 s_skiplist_node * new_skiplist_node (void *value, unsigned long height)
 {
-        s_skiplist_node *n = malloc(sizeof(s_skiplist_node) +
-                                    height * sizeof(void*));
+        s_skiplist_node *n = alloc(sizeof(s_skiplist_node) +
+                                   height * sizeof(void*));
+        alloc_track(FORM_SKIPLIST_NODE, sizeof(s_skiplist_node) +
+                    height * sizeof(void*));
         if (n) {
                 n->type = FORM_SKIPLIST_NODE;
                 n->value = value;
@@ -83,6 +86,8 @@ s_skiplist * new_skiplist (int max_height, double spacing)
 {
         s_skiplist *sl = malloc(sizeof(s_skiplist) +
                                 max_height * sizeof(long));
+        alloc_track(FORM_SKIPLIST, sizeof(s_skiplist) +
+                    max_height * sizeof(long));
         if (sl) {
                 sl->type = FORM_SKIPLIST;
                 sl->head = new_skiplist_node(NULL, max_height);
@@ -121,6 +126,9 @@ s_skiplist_node * skiplist_pred (s_skiplist *sl, void *value)
         return pred;
 }
 
+/* Links are published with release stores and unlinked nodes are
+   not freed, so that a reader may walk a skiplist without a lock
+   while a single writer inserts or deletes. */
 void skiplist_node_insert (s_skiplist_node *n, s_skiplist_node *pred)
 {
         unsigned level;
@@ -128,7 +136,8 @@ void skiplist_node_insert (s_skiplist_node *n, s_skiplist_node *pred)
                 s_skiplist_node *p = skiplist_node_next(pred, level);
                 skiplist_node_next(n, level) =
                         skiplist_node_next(p, level);
-                skiplist_node_next(p, level) = n;
+                __atomic_store_n(&skiplist_node_next(p, level), n,
+                                 __ATOMIC_RELEASE);
         }
 }
 
@@ -173,8 +182,9 @@ void * skiplist_delete (s_skiplist *sl, void *x)
                 return NULL;
         for (level = 0; level < next->height; level++) {
                 s_skiplist_node *p = skiplist_node_next(pred, level);
-                skiplist_node_next(p, level) =
-                        skiplist_node_next(next, level);
+                __atomic_store_n(&skiplist_node_next(p, level),
+                                 skiplist_node_next(next, level),
+                                 __ATOMIC_RELEASE);
         }
         value = next->value;
         sl->length--;
@@ -186,11 +196,13 @@ s_skiplist_node * skiplist_find (s_skiplist *sl, void *value)
         s_skiplist_node *node = sl->head;
         int level = node->height;
         while (level--) {
-                s_skiplist_node *n = node;
-                int c;
-                while (n && (c = sl->compare(n->value, value)) < 0)
-                        n = skiplist_node_next(n, level);
-                if (c == 0)
+                s_skiplist_node *n = skiplist_node_next(node, level);
+                int c = 1;
+                while (n && (c = sl->compare(n->value, value)) < 0) {
+                        node = n;
+                        n = skiplist_node_next(node, level);
+                }
+                if (n && c == 0)
                         return n;
         }
         return NULL;
@@ -0,0 +1,468 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include "compare.h"
+#include "env.h"
+#include "error.h"
+#include "eval.h"
+#include "package.h"
+#include "sort.h"
+#include "symbols.h"
+
+#define SORT_BINS 64
+
+static u_form * sort_key (s_sort_pred *sp, u_form *x)
+{
+        if (!sp->key)
+                return x;
+        return funcall(sp->key, cons(x, nil()), sp->env);
+}
+
+static int sort_lessp_equal (s_sort_pred *sp, u_form *a, u_form *b)
+{
+        return compare_equal(sort_key(sp, a), sort_key(sp, b)) < 0;
+}
+
+static int sort_lessp_funcall (s_sort_pred *sp, u_form *a, u_form *b)
+{
+        u_form *args = cons(sort_key(sp, a),
+                            cons(sort_key(sp, b), nil()));
+        return funcall(sp->fun, args, sp->env) != nil();
+}
+
+static int sort_lessp_lt (s_sort_pred *sp, u_form *a, u_form *b)
+{
+        return lt(sort_key(sp, a), sort_key(sp, b), sp->env);
+}
+
+static int sort_lessp_lte (s_sort_pred *sp, u_form *a, u_form *b)
+{
+        return lte(sort_key(sp, a), sort_key(sp, b), sp->env);
+}
+
+static int sort_lessp_gt (s_sort_pred *sp, u_form *a, u_form *b)
+{
+        return gt(sort_key(sp, a), sort_key(sp, b), sp->env);
+}
+
+static int sort_lessp_gte (s_sort_pred *sp, u_form *a, u_form *b)
+{
+        return gte(sort_key(sp, a), sort_key(sp, b), sp->env);
+}
+
+static int sort_lessp_long_lt (s_sort_pred *sp, u_form *a, u_form *b)
+{
+        (void) sp;
+        return a->lng.lng < b->lng.lng;
+}
+
+static int sort_lessp_long_lte (s_sort_pred *sp, u_form *a, u_form *b)
+{
+        (void) sp;
+        return a->lng.lng <= b->lng.lng;
+}
+
+static int sort_lessp_long_gt (s_sort_pred *sp, u_form *a, u_form *b)
+{
+        (void) sp;
+        return a->lng.lng > b->lng.lng;
+}
+
+static int sort_lessp_long_gte (s_sort_pred *sp, u_form *a, u_form *b)
+{
+        (void) sp;
+        return a->lng.lng >= b->lng.lng;
+}
+
+void sort_pred_init (s_sort_pred *sp, u_form *fun, u_form *key,
+                     s_env *env)
+{
+        sp->env = env;
+        sp->key = NULL;
+        if (key && key != nil())
+                sp->key = function_designator(key, env);
+        sp->fun = NULL;
+        sp->lessp = sort_lessp_equal;
+        if (!fun)
+                return;
+        sp->fun = function_designator(fun, env);
+        sp->lessp = sort_lessp_funcall;
+        if (sp->fun->type == FORM_CFUN) {
+                f_cfun *f = sp->fun->cfun.fun;
+                if (f == cfun_lt)
+                        sp->lessp = sort_lessp_lt;
+                else if (f == cfun_lte)
+                        sp->lessp = sort_lessp_lte;
+                else if (f == cfun_gt)
+                        sp->lessp = sort_lessp_gt;
+                else if (f == cfun_gte)
+                        sp->lessp = sort_lessp_gte;
+        }
+}
+
+static int sort_pred_numeric (s_sort_pred *sp)
+{
+        return !sp->key && (sp->lessp == sort_lessp_lt ||
+                            sp->lessp == sort_lessp_lte ||
+                            sp->lessp == sort_lessp_gt ||
+                            sp->lessp == sort_lessp_gte);
+}
+
+static int sort_pred_descending (s_sort_pred *sp)
+{
+        return sp->lessp == sort_lessp_gt || sp->lessp == sort_lessp_gte;
+}
+
+/* Switch to a direct fixnum comparison when every element is a
+   fixnum and the predicate is a known numeric comparison. */
+static void sort_pred_fixnums (s_sort_pred *sp, u_form *list)
+{
+        if (!sort_pred_numeric(sp))
+                return;
+        while (consp(list)) {
+                if (!integerp(list->cons.car))
+                        return;
+                list = list->cons.cdr;
+        }
+        if (sp->lessp == sort_lessp_lt)
+                sp->lessp = sort_lessp_long_lt;
+        else if (sp->lessp == sort_lessp_lte)
+                sp->lessp = sort_lessp_long_lte;
+        else if (sp->lessp == sort_lessp_gt)
+                sp->lessp = sort_lessp_long_gt;
+        else
+                sp->lessp = sort_lessp_long_gte;
+}
+
+/* Merge two sorted lists by relinking their conses. Elements of a
+   come first on ties so that the merge is stable. */
+static u_form * sort_merge (u_form *a, u_form *b, s_sort_pred *sp)
+{
+        u_form *head = nil();
+        u_form **tail = &head;
+        while (consp(a) && consp(b)) {
+                if (sp->lessp(sp, b->cons.car, a->cons.car)) {
+                        *tail = b;
+                        b = b->cons.cdr;
+                } else {
+                        *tail = a;
+                        a = a->cons.cdr;
+                }
+                tail = &(*tail)->cons.cdr;
+        }
+        *tail = consp(a) ? a : b;
+        return head;
+}
+
+/* Bottom-up merge sort : bins[i] holds a sorted run of 2^i conses
+   taken from the list before any run in bins[j] for j < i. */
+u_form * sort_list (u_form *list, s_sort_pred *sp)
+{
+        u_form *bins[SORT_BINS];
+        u_form *result = nil();
+        int max = 0;
+        int i;
+        sort_pred_fixnums(sp, list);
+        while (consp(list)) {
+                u_form *run = list;
+                list = list->cons.cdr;
+                run->cons.cdr = nil();
+                for (i = 0; i < max && bins[i] != nil(); i++) {
+                        run = sort_merge(bins[i], run, sp);
+                        bins[i] = nil();
+                }
+                if (i == max)
+                        max++;
+                bins[i] = run;
+        }
+        for (i = 0; i < max; i++)
+                result = sort_merge(bins[i], result, sp);
+        return result;
+}
+
+/* Introsort : median of three quicksort falling back to heapsort
+   past 2 log2(n) levels of recursion, insertion sort on short runs.
+   LESSP(a, b) is expanded with sp in scope. */
+#define SORT_INSERTION_MAX 16
+
+#define DEF_INTROSORT(name, type, LESSP)                                \
+static void name##_insertion (type *a, unsigned long n,                 \
+                              s_sort_pred *sp)                          \
+{                                                                       \
+        unsigned long i;                                                \
+        unsigned long j;                                                \
+        (void) sp;                                                      \
+        for (i = 1; i < n; i++) {                                       \
+                type x = a[i];                                          \
+                for (j = i; j > 0 && LESSP(x, a[j - 1]); j--)           \
+                        a[j] = a[j - 1];                                \
+                a[j] = x;                                               \
+        }                                                               \
+}                                                                       \
+                                                                        \
+static void name##_sift (type *a, unsigned long i, unsigned long n,     \
+                         s_sort_pred *sp)                               \
+{                                                                       \
+        type x = a[i];                                                  \
+        unsigned long c;                                                \
+        (void) sp;                                                      \
+        while ((c = 2 * i + 1) < n) {                                   \
+                if (c + 1 < n && LESSP(a[c], a[c + 1]))                 \
+                        c++;                                            \
+                if (!LESSP(x, a[c]))                                    \
+                        break;                                          \
+                a[i] = a[c];                                            \
+                i = c;                                                  \
+        }                                                               \
+        a[i] = x;                                                       \
+}                                                                       \
+                                                                        \
+static void name##_heap (type *a, unsigned long n, s_sort_pred *sp)     \
+{                                                                       \
+        unsigned long i = n / 2;                                        \
+        while (i-- > 0)                                                 \
+                name##_sift(a, i, n, sp);                               \
+        while (n-- > 1) {                                               \
+                type x = a[0];                                          \
+                a[0] = a[n];                                            \
+                a[n] = x;                                               \
+                name##_sift(a, 0, n, sp);                               \
+        }                                                               \
+}                                                                       \
+                                                                        \
+static void name##_intro (type *a, long n, int depth, s_sort_pred *sp) \
+{                                                                       \
+        (void) sp;                                                      \
+        while (n > SORT_INSERTION_MAX) {                                \
+                long i = 0;                                             \
+                long j = n - 1;                                         \
+                long m = n / 2;                                         \
+                type pivot;                                             \
+                type x;                                                 \
+                if (depth-- == 0) {                                     \
+                        name##_heap(a, n, sp);                          \
+                        return;                                         \
+                }                                                       \
+                if (LESSP(a[m], a[0])) {                                \
+                        x = a[m]; a[m] = a[0]; a[0] = x;                \
+                }                                                       \
+                if (LESSP(a[j], a[m])) {                                \
+                        x = a[j]; a[j] = a[m]; a[m] = x;                \
+                        if (LESSP(a[m], a[0])) {                        \
+                                x = a[m]; a[m] = a[0]; a[0] = x;        \
+                        }                                               \
+                }                                                       \
+                pivot = a[m];                                           \
+                while (i <= j) {                                        \
+                        while (i < n - 1 && LESSP(a[i], pivot))         \
+                                i++;                                    \
+                        while (j > 0 && LESSP(pivot, a[j]))             \
+                                j--;                                    \
+                        if (i <= j) {                                   \
+                                x = a[i]; a[i] = a[j]; a[j] = x;        \
+                                i++;                                    \
+                                j--;                                    \
+                        }                                               \
+                }                                                       \
+                if (j + 1 < n - i) {                                    \
+                        name##_intro(a, j + 1, depth, sp);              \
+                        a += i;                                         \
+                        n -= i;                                         \
+                } else {                                                \
+                        name##_intro(a + i, n - i, depth, sp);          \
+                        n = j + 1;                                      \
+                }                                                       \
+        }                                                               \
+        name##_insertion(a, n, sp);                                     \
+}                                                                       \
+                                                                        \
+static void name (type *a, unsigned long n, s_sort_pred *sp)            \
+{                                                                       \
+        int depth = 0;                                                  \
+        unsigned long i;                                                \
+        for (i = n; i > 1; i >>= 1)                                     \
+                depth += 2;                                             \
+        name##_intro(a, n, depth, sp);                                  \
+}
+
+#define SORT_LESSP_FORM(a, b) sp->lessp(sp, a, b)
+#define SORT_LESSP_NUM(a, b) ((a) < (b))
+
+DEF_INTROSORT(sort_forms, u_form *, SORT_LESSP_FORM)
+DEF_INTROSORT(sort_longs, long, SORT_LESSP_NUM)
+DEF_INTROSORT(sort_doubles, double, SORT_LESSP_NUM)
+
+/* Stable merge sort of an array of forms through a buffer of the
+   same size. */
+static void sort_forms_stable (u_form **a, u_form **tmp, unsigned long n,
+                               s_sort_pred *sp)
+{
+        unsigned long m = n / 2;
+        unsigned long i = 0;
+        unsigned long j = m;
+        unsigned long k = 0;
+        if (n <= SORT_INSERTION_MAX) {
+                sort_forms_insertion(a, n, sp);
+                return;
+        }
+        sort_forms_stable(a, tmp, m, sp);
+        sort_forms_stable(a + m, tmp, n - m, sp);
+        if (!sp->lessp(sp, a[m], a[m - 1]))
+                return;
+        memcpy(tmp, a, m * sizeof(u_form*));
+        while (i < m && j < n) {
+                if (sp->lessp(sp, a[j], tmp[i]))
+                        a[k++] = a[j++];
+                else
+                        a[k++] = tmp[i++];
+        }
+        while (i < m)
+                a[k++] = tmp[i++];
+}
+
+static void sort_u8s (unsigned char *a, unsigned long n)
+{
+        unsigned long count[256];
+        unsigned long i;
+        unsigned long k = 0;
+        memset(count, 0, sizeof(count));
+        for (i = 0; i < n; i++)
+                count[a[i]]++;
+        for (i = 0; i < 256; i++) {
+                memset(a + k, i, count[i]);
+                k += count[i];
+        }
+}
+
+#define DEF_SORT_REVERSE(name, type)                                    \
+static void name (type *a, unsigned long n)                             \
+{                                                                       \
+        unsigned long i;                                                \
+        for (i = 0; i < n / 2; i++) {                                   \
+                type x = a[i];                                          \
+                a[i] = a[n - 1 - i];                                    \
+                a[n - 1 - i] = x;                                       \
+        }                                                               \
+}
+
+DEF_SORT_REVERSE(sort_reverse_u8s, unsigned char)
+DEF_SORT_REVERSE(sort_reverse_longs, long)
+DEF_SORT_REVERSE(sort_reverse_doubles, double)
+
+static int sort_vector_generic (s_vector *v, s_sort_pred *sp, int stable)
+{
+        u_form **a;
+        u_form **tmp = NULL;
+        unsigned long i;
+        if (v->element_type == VECTOR_T)
+                a = vector_t(v);
+        else {
+                if (!(a = malloc((v->length + 1) * sizeof(u_form*))))
+                        return -1;
+                for (i = 0; i < v->length; i++)
+                        a[i] = vector_ref(v, i);
+        }
+        if (stable) {
+                if (!(tmp = malloc((v->length / 2 + 1) * sizeof(u_form*)))) {
+                        if (v->element_type != VECTOR_T)
+                                free(a);
+                        return -1;
+                }
+                sort_forms_stable(a, tmp, v->length, sp);
+                free(tmp);
+        } else
+                sort_forms(a, v->length, sp);
+        if (v->element_type != VECTOR_T) {
+                for (i = 0; i < v->length; i++)
+                        vector_set(v, i, a[i]);
+                free(a);
+        }
+        return 0;
+}
+
+/* Sort the active elements of v in place. Specialized vectors sorted
+   by a numeric comparison never box their elements; equal numbers
+   are indistinguishable so stability does not matter there. */
+int sort_vector (s_vector *v, s_sort_pred *sp, int stable)
+{
+        unsigned long i;
+        if (v->element_type == VECTOR_T) {
+                if (sort_pred_numeric(sp)) {
+                        for (i = 0; i < v->length; i++)
+                                if (!integerp(vector_t(v)[i]))
+                                        break;
+                        if (i == v->length)
+                                sort_pred_fixnums(sp, nil());
+                }
+                return sort_vector_generic(v, sp, stable);
+        }
+        if (!sort_pred_numeric(sp))
+                return sort_vector_generic(v, sp, stable);
+        switch (v->element_type) {
+        case VECTOR_U8:
+                sort_u8s(vector_u8(v), v->length);
+                if (sort_pred_descending(sp))
+                        sort_reverse_u8s(vector_u8(v), v->length);
+                break;
+        case VECTOR_FIXNUM:
+                sort_longs(vector_fixnum(v), v->length, sp);
+                if (sort_pred_descending(sp))
+                        sort_reverse_longs(vector_fixnum(v), v->length);
+                break;
+        case VECTOR_DOUBLE:
+                sort_doubles(vector_double(v), v->length, sp);
+                if (sort_pred_descending(sp))
+                        sort_reverse_doubles(vector_double(v),
+                                             v->length);
+                break;
+        default:
+                break;
+        }
+        return 0;
+}
+
+u_form * sort (u_form *seq, u_form *fun, u_form *key, int stable,
+               s_env *env)
+{
+        s_sort_pred sp;
+        sort_pred_init(&sp, fun, key, env);
+        if (seq == nil())
+                return seq;
+        switch (seq->type) {
+        case FORM_CONS:
+                if (last(seq)->cons.cdr != nil())
+                        break;
+                return sort_list(seq, &sp);
+        case FORM_VECTOR:
+                if (sort_vector(&seq->vector, &sp, stable))
+                        return error(env, "sort: out of memory");
+                return seq;
+        default:
+                break;
+        }
+        return error(env, "don't know how to sort argument");
+}
+
+static u_form * cfun_sort_ (u_form *args, const char *name, int stable,
+                            s_env *env)
+{
+        u_form *fun = NULL;
+        u_form *key = NULL;
+        if (!consp(args))
+                return error(env, "invalid arguments for %s", name);
+        if (consp(args->cons.cdr)) {
+                fun = args->cons.cdr->cons.car;
+                key = getf(args->cons.cdr->cons.cdr, g_kw.key, NULL);
+        }
+        return sort(args->cons.car, fun, key, stable, env);
+}
+
+u_form * cfun_sort (u_form *args, s_env *env)
+{
+        return cfun_sort_(args, "sort", 0, env);
+}
+
+u_form * cfun_stable_sort (u_form *args, s_env *env)
+{
+        return cfun_sort_(args, "stable-sort", 1, env);
+}
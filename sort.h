@@ -0,0 +1,25 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include "form.h"
+
+typedef struct sort_pred s_sort_pred;
+
+struct sort_pred {
+        u_form *fun;
+        u_form *key;
+        int (*lessp) (s_sort_pred *sp, u_form *a, u_form *b);
+        s_env *env;
+};
+
+void     sort_pred_init (s_sort_pred *sp, u_form *fun, u_form *key,
+                         s_env *env);
+u_form * sort_list (u_form *list, s_sort_pred *sp);
+int      sort_vector (s_vector *v, s_sort_pred *sp, int stable);
+u_form * sort (u_form *seq, u_form *fun, u_form *key, int stable,
+               s_env *env);
+
+u_form * cfun_sort (u_form *args, s_env *env);
+u_form * cfun_stable_sort (u_form *args, s_env *env);
+
+#endif
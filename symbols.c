@@ -0,0 +1,19 @@
+#include <stdlib.h>
+#include "form.h"
+#include "package.h"
+#include "symbols.h"
+
+s_symbols  g_sym;
+s_keywords g_kw;
+
+void init_symbols ()
+{
+#define SYMBOLS_INTERN(name, string)                                  \
+        g_sym.name = (u_form*) sym(string, NULL);
+        SYMBOLS(SYMBOLS_INTERN)
+#undef SYMBOLS_INTERN
+#define KEYWORDS_INTERN(name, string)                                 \
+        g_kw.name = (u_form*) kw(string);
+        KEYWORDS(KEYWORDS_INTERN)
+#undef KEYWORDS_INTERN
+}
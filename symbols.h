@@ -0,0 +1,74 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include "typedefs.h"
+
+/* Symbols the evaluator compares against or returns. They are
+   interned in common-lisp once by init_symbols so hot paths read a
+   pointer instead of walking the package, and so the reader finds
+   them there instead of interning copies in the current package. */
+#define SYMBOLS(X)                                                    \
+        X(nil,                  "nil")                                \
+        X(t,                    "t")                                  \
+        X(lambda,               "lambda")                             \
+        X(function,             "function")                           \
+        X(macro,                "macro")                              \
+        X(labels,               "labels")                             \
+        X(flet,                 "flet")                               \
+        X(quote,                "quote")                              \
+        X(backquote,            "backquote")                          \
+        X(comma,                "comma")                              \
+        X(comma_atsign,         "comma-atsign")                       \
+        X(comma_dot,            "comma-dot")                          \
+        X(comma_var,            "*comma*")                            \
+        X(comma_atsign_var,     "*comma-atsign*")                     \
+        X(comma_dot_var,        "*comma-dot*")                        \
+        X(otherwise,            "otherwise")                          \
+        X(rest,                 "&rest")                              \
+        X(body,                 "&body")                              \
+        X(key,                  "&key")                               \
+        X(package_var,          "*package*")                          \
+        X(internal_time_units_per_second,                             \
+          "internal-time-units-per-second")                           \
+        X(fixnum,               "fixnum")                             \
+        X(double_float,         "double-float")                       \
+        X(unsigned_byte,        "unsigned-byte")                      \
+        X(string,               "string")
+
+#define KEYWORDS(X)                                                   \
+        X(size,                 "size")                               \
+        X(rehash_size,          "rehash-size")                        \
+        X(rehash_threshold,     "rehash-threshold")                   \
+        X(synchronized,         "synchronized")                       \
+        X(key,                  "key")                                \
+        X(test,                 "test")                               \
+        X(initial_value,        "initial-value")                      \
+        X(element_type,         "element-type")                       \
+        X(initial_element,      "initial-element")                    \
+        X(fill_pointer,         "fill-pointer")                       \
+        X(use,                  "use")                                \
+        X(calls,                "calls")                              \
+        X(time,                 "time")                               \
+        X(self,                 "self")                               \
+        X(bytes,                "bytes")                              \
+        X(detail,               "detail")                             \
+        X(internal,             "internal")                           \
+        X(external,             "external")                           \
+        X(inherited,            "inherited")
+
+#define SYMBOLS_FIELD(name, string) u_form *name;
+
+typedef struct symbols {
+        SYMBOLS(SYMBOLS_FIELD)
+} s_symbols;
+
+typedef struct keywords {
+        KEYWORDS(SYMBOLS_FIELD)
+} s_keywords;
+
+extern s_symbols  g_sym;
+extern s_keywords g_kw;
+
+void init_symbols ();
+
+#endif
@@ -0,0 +1,149 @@
+#include <assert.h>
+#include <check.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include "alloc.h"
+
+#define N 1000
+#define SIZE 32
+
+void *g_objects[N];
+
+static s_alloc_cache * owner (void *p)
+{
+        return ((s_alloc_page*) ((uintptr_t) p & ~(uintptr_t)
+                                 (ALLOC_PAGE_SIZE - 1)))->owner;
+}
+
+static void * alloc_objects (void *arg)
+{
+        unsigned long i;
+        (void) arg;
+        for (i = 0; i < N; i++) {
+                g_objects[i] = alloc(SIZE);
+                memset(g_objects[i], 0xAB, SIZE);
+        }
+        return NULL;
+}
+
+static void free_objects (void)
+{
+        unsigned long i;
+        for (i = 0; i < N; i++)
+                alloc_free(g_objects[i], SIZE);
+}
+
+static int freed_p (void *p)
+{
+        unsigned long i;
+        for (i = 0; i < N; i++)
+                if (g_objects[i] == p)
+                        return 1;
+        return 0;
+}
+
+/* Allocates until every object freed by free_objects came back. */
+static void * realloc_objects (void *arg)
+{
+        unsigned long found = 0;
+        unsigned long i;
+        (void) arg;
+        for (i = 0; found < N && i < N + ALLOC_PAGE_SIZE / SIZE; i++)
+                if (freed_p(alloc(SIZE)))
+                        found++;
+        return (void*) found;
+}
+
+static void run_thread (void * (*f) (void *), void **result)
+{
+        pthread_t t;
+        int r;
+        r = pthread_create(&t, NULL, f, NULL);
+        assert(!r);
+        r = pthread_join(t, result);
+        assert(!r);
+}
+
+START_TEST (test_alloc_reuse)
+{
+        void *p = alloc(SIZE);
+        void *q;
+        assert(p);
+        alloc_free(p, SIZE);
+        q = alloc(SIZE);
+        assert(q == p);
+        q = alloc(ALLOC_SMALL_MAX + 1);
+        assert(q);
+        alloc_free(q, ALLOC_SMALL_MAX + 1);
+}
+END_TEST
+
+START_TEST (test_alloc_sizes)
+{
+        void *p[ALLOC_SMALL_MAX + 1];
+        unsigned long i;
+        for (i = 1; i <= ALLOC_SMALL_MAX; i++) {
+                p[i] = alloc(i);
+                assert(p[i]);
+                memset(p[i], i, i);
+        }
+        for (i = 1; i <= ALLOC_SMALL_MAX; i++) {
+                assert(((unsigned char*) p[i])[0] == i);
+                assert(((unsigned char*) p[i])[i - 1] == i);
+                alloc_free(p[i], i);
+        }
+}
+END_TEST
+
+START_TEST (test_alloc_remote_free)
+{
+        void *found;
+        run_thread(alloc_objects, NULL);
+        free_objects();
+        run_thread(realloc_objects, &found);
+        assert((unsigned long) found == N);
+}
+END_TEST
+
+START_TEST (test_alloc_thread_exit)
+{
+        s_alloc_cache *cache;
+        run_thread(alloc_objects, NULL);
+        cache = owner(g_objects[0]);
+        run_thread(alloc_objects, NULL);
+        assert(owner(g_objects[0]) == cache);
+}
+END_TEST
+
+Suite * alloc_suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+    TCase *tc_threads;
+    s = suite_create("Alloc");
+    tc_core = tcase_create("Core");
+    tcase_add_test(tc_core, test_alloc_reuse);
+    tcase_add_test(tc_core, test_alloc_sizes);
+    suite_add_tcase(s, tc_core);
+    tc_threads = tcase_create("Threads");
+    tcase_add_test(tc_threads, test_alloc_remote_free);
+    tcase_add_test(tc_threads, test_alloc_thread_exit);
+    suite_add_tcase(s, tc_threads);
+    return s;
+}
+
+int main(void)
+{
+    int number_failed;
+    Suite *s;
+    SRunner *sr;
+
+    s = alloc_suite();
+    sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? 0 : 1;
+}
@@ -4,6 +4,7 @@
 #include "form.h"
 #include "hashtable.h"
 #include "package.h"
+#include "symbols.h"
 
 s_hashtable *g_h = NULL;
 
@@ -173,6 +174,28 @@ START_TEST (test_hashtable_insert_twenty)
 }
 END_TEST
 
+START_TEST (test_hashtable_synchronized)
+{
+        s_hashtable *h = new_hashtable(10, 0, 10.0, 1.5);
+        long i;
+        int r;
+        r = hashtable_synchronize(h);
+        assert(!r);
+        for (i = 0; i < 100; i++)
+                sethash(h, (u_form*) new_long(i), (u_form*) new_long(-i));
+        assert(h->count == 100 && h->size == 100);
+        assert(h->array->size == h->size);
+        for (i = 0; i < 100; i++)
+                assert(gethash(h, (u_form*) new_long(i))->lng.lng == -i);
+        r = remhash(h, (u_form*) new_long(42));
+        assert(r);
+        assert(!gethash(h, (u_form*) new_long(42)));
+        assert(h->count == 99);
+        clrhash(h);
+        assert(h->count == 0 && !gethash(h, (u_form*) new_long(1)));
+}
+END_TEST
+
 START_TEST (test_remhash_one)
 {
         assert(g_h->count == 10);
@@ -216,6 +239,7 @@ Suite * skiplist_suite(void)
     s = suite_create("Hashtable");
     tc_core = tcase_create("Core");
     tcase_add_test(tc_core, test_hashtable_create);
+    tcase_add_test(tc_core, test_hashtable_synchronized);
     suite_add_tcase(s, tc_core);
     tc_inserts = tcase_create("Inserts");
     tcase_add_checked_fixture(tc_inserts, setup_inserts, teardown_inserts);
@@ -239,6 +263,7 @@ int main(void)
     Suite *s;
     SRunner *sr;
 
+    init_symbols();
     s = skiplist_suite();
     sr = srunner_create(s);
 
@@ -0,0 +1,136 @@
+#include <assert.h>
+#include <check.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include "env.h"
+#include "eval.h"
+#include "form.h"
+#include "form_string.h"
+#include "print.h"
+#include "read.h"
+
+static s_env g_env;
+
+static const char g_input[] =
+        "(a \"b\nc\" (1 . 2.5)) 'x #(1 2) [3 1] `(y) 42";
+
+static void check_forms (u_form **f)
+{
+        assert(consp(f[0]) && stringp(cadr(f[0])));
+        assert(!strcmp(string_str(&cadr(f[0])->string), "b\nc"));
+        assert(consp(f[1]) && symbolp(cadr(f[1])));
+        assert(f[2] && f[2]->type == FORM_VECTOR);
+        assert(f[3] && f[3]->type == FORM_SKIPLIST);
+        assert(consp(f[4]));
+        assert(f[5] && f[5]->type == FORM_LONG && f[5]->lng.lng == 42);
+}
+
+START_TEST (test_read_feed_bytes)
+{
+        s_stream *stream = stream_chunks("test");
+        u_form *f[6];
+        u_form *last;
+        unsigned long i;
+        int count = 0;
+        for (i = 0; i < sizeof(g_input) - 1; i++) {
+                stream_feed(stream, g_input + i, 1);
+                while ((f[count] = stream_next_form(stream, &g_env)))
+                        count++;
+        }
+        assert(count == 5);
+        stream_feed_eof(stream);
+        f[5] = stream_next_form(stream, &g_env);
+        assert(f[5]);
+        last = stream_next_form(stream, &g_env);
+        assert(!last);
+        check_forms(f);
+        stream_close(stream);
+}
+END_TEST
+
+START_TEST (test_read_nonblocking_fd)
+{
+        int fds[2];
+        s_stream *stream;
+        u_form *f[6];
+        int count = 0;
+        int r;
+        ssize_t n;
+        r = pipe(fds);
+        assert(!r);
+        fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+        stream = stream_fd(fds[0], "pipe");
+        r = stream_pump(stream);
+        assert(r == 0);
+        f[0] = stream_next_form(stream, &g_env);
+        assert(!f[0]);
+        n = write(fds[1], g_input, 10);
+        assert(n == 10);
+        r = stream_pump(stream);
+        assert(r == 0);
+        f[0] = stream_next_form(stream, &g_env);
+        assert(!f[0]);
+        n = write(fds[1], g_input + 10, sizeof(g_input) - 11);
+        assert(n == sizeof(g_input) - 11);
+        close(fds[1]);
+        while (!stream_pump(stream))
+                while ((f[count] = stream_next_form(stream, &g_env)))
+                        count++;
+        assert(count == 6);
+        check_forms(f);
+        stream_close(stream);
+}
+END_TEST
+
+START_TEST (test_read_utf8)
+{
+        static const char input[] = "\"a\xc3\xa9\xe6\x97\xa5\" #\\\xe6\x97\xa5 ";
+        s_stream *stream = stream_chunks("test");
+        u_form *f[2];
+        unsigned long i;
+        int count = 0;
+        for (i = 0; i < sizeof(input) - 1; i++) {
+                stream_feed(stream, input + i, 1);
+                while ((f[count] = stream_next_form(stream, &g_env)))
+                        count++;
+        }
+        assert(count == 2);
+        assert(stringp(f[0]) && f[0]->string.length == 6);
+        assert(string_char_count(&f[0]->string) == 3);
+        assert(string_char(&f[0]->string, 1) == 0xE9);
+        assert(string_char_offset(&f[0]->string, 2) == 3);
+        assert(characterp(f[1]) && f[1]->character.code == 0x65E5);
+        stream_close(stream);
+}
+END_TEST
+
+Suite * read_suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("Read");
+    tc_core = tcase_create("Core");
+    tcase_add_test(tc_core, test_read_feed_bytes);
+    tcase_add_test(tc_core, test_read_nonblocking_fd);
+    tcase_add_test(tc_core, test_read_utf8);
+    suite_add_tcase(s, tc_core);
+    return s;
+}
+
+int main(void)
+{
+    int number_failed;
+    Suite *s;
+    SRunner *sr;
+
+    env_init_(&g_env, NULL);
+    s = read_suite();
+    sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? 0 : 1;
+}
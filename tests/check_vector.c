@@ -0,0 +1,115 @@
+
+#include <assert.h>
+#include <check.h>
+#include "compare.h"
+#include "eval.h"
+#include "form.h"
+#include "hashtable.h"
+#include "package.h"
+#include "simd.h"
+#include "symbols.h"
+#include "vector.h"
+
+START_TEST (test_vector_create)
+{
+        s_vector *v = new_vector(VECTOR_FIXNUM, 10);
+        assert(v && v->length == 10 && v->size == 10);
+        assert(vector_fixnum(v)[9] == 0);
+        v = new_vector(VECTOR_T, 3);
+        assert(v && vector_t(v)[2] == nil());
+}
+END_TEST
+
+START_TEST (test_vector_set)
+{
+        s_vector *v = new_vector(VECTOR_U8, 2);
+        assert(vector_set(v, 0, (u_form*) new_long(255)) == 0);
+        assert(vector_set(v, 1, (u_form*) new_long(256)) < 0);
+        assert(vector_set(v, 1, (u_form*) kw("a")) < 0);
+        assert(vector_u8(v)[0] == 255);
+        v = new_vector(VECTOR_DOUBLE, 1);
+        assert(vector_set(v, 0, (u_form*) new_long(2)) == 0);
+        assert(vector_ref(v, 0)->dbl.dbl == 2.0);
+}
+END_TEST
+
+START_TEST (test_vector_push_extend)
+{
+        s_vector *v = new_vector(VECTOR_FIXNUM, 0);
+        long i;
+        for (i = 0; i < 1000; i++)
+                assert(vector_push_extend(v, (u_form*) new_long(i), 1)
+                       == 0);
+        assert(v->length == 1000 && v->size >= 1000);
+        for (i = 0; i < 1000; i++)
+                assert(vector_fixnum(v)[i] == i);
+}
+END_TEST
+
+START_TEST (test_vector_equal)
+{
+        u_form *list = cons((u_form*) new_long(1),
+                            cons((u_form*) new_long(2), nil()));
+        s_vector *a = list_to_vector(list);
+        s_vector *b = list_to_vector(list);
+        assert(a->length == 2 && vector_t(a)[1]->lng.lng == 2);
+        assert(compare_equal(a, b) == 0);
+        assert(sxhash((u_form*) a) == sxhash((u_form*) b));
+        vector_push_extend(b, (u_form*) new_long(3), 1);
+        assert(compare_equal(a, b) < 0);
+}
+END_TEST
+
+START_TEST (test_vector_simd)
+{
+        long a[37];
+        double d[37];
+        unsigned long i;
+        simd_init();
+        for (i = 0; i < 37; i++) {
+                a[i] = (long) i - 18;
+                d[i] = a[i] / 2.0;
+        }
+        assert(g_simd.sum_long(a, 37) == 0);
+        assert(g_simd.sum_double(d, 37) == 0.0);
+        assert(g_simd.min_long(a, 37) == -18);
+        assert(g_simd.max_double(d, 37) == 9.0);
+        assert(g_simd.count_long(a, 37, 0, SIMD_LT) == 18);
+        assert(g_simd.count_long(a, 37, 0, SIMD_GTE) == 19);
+        assert(g_simd.count_double(d, 37, 0.0, SIMD_LTE) == 19);
+        assert(g_simd.dot_long(a, a, 37) == 2 * 18 * 19 * 37 / 6);
+        g_simd.map_long(SIMD_SUB, a, a, a, 37);
+        assert(g_simd.sum_long(a, 37) == 0 && a[36] == 0);
+}
+END_TEST
+
+Suite * vector_suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+    s = suite_create("Vector");
+    tc_core = tcase_create("Core");
+    tcase_add_test(tc_core, test_vector_create);
+    tcase_add_test(tc_core, test_vector_set);
+    tcase_add_test(tc_core, test_vector_push_extend);
+    tcase_add_test(tc_core, test_vector_equal);
+    tcase_add_test(tc_core, test_vector_simd);
+    suite_add_tcase(s, tc_core);
+    return s;
+}
+
+int main(void)
+{
+    int number_failed;
+    Suite *s;
+    SRunner *sr;
+
+    init_symbols();
+    s = vector_suite();
+    sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+#include <stdlib.h>
+#include "error.h"
+#include "eval.h"
+#include "profile.h"
+#include "symbols.h"
+#include "thread.h"
+
+static void * thread_main (void *arg)
+{
+        s_thread *th = arg;
+        s_error_handler eh;
+        if (setjmp(eh.buf)) {
+                th->error = eh.string;
+                return NULL;
+        }
+        profile_set_env(&th->env);
+        push_error_handler(&eh, &th->env);
+        th->result = funcall(th->function, th->args, &th->env);
+        pop_error_handler(&th->env);
+        return NULL;
+}
+
+s_thread * make_thread (u_form *function, u_form *args, s_env *env)
+{
+        s_thread *th = malloc(sizeof(s_thread));
+        if (!th) {
+                error(env, "make-thread: out of memory");
+                return NULL;
+        }
+        th->type = FORM_THREAD;
+        th->function = function_designator(function, env);
+        th->args = args;
+        th->result = nil();
+        th->error = NULL;
+        th->joined = 0;
+        env_init_thread(&th->env, env);
+        if (pthread_create(&th->pthread, NULL, thread_main, th)) {
+                free(th);
+                error(env, "make-thread: cannot create thread");
+                return NULL;
+        }
+        return th;
+}
+
+u_form * join_thread (s_thread *th, s_env *env)
+{
+        if (!th->joined) {
+                pthread_join(th->pthread, NULL);
+                th->joined = 1;
+        }
+        if (th->error)
+                return error(env, "join-thread: %.*s",
+                             (int) th->error->length,
+                             string_str(th->error));
+        return th->result;
+}
+
+/* (make-thread function &rest args) */
+u_form * cfun_make_thread (u_form *args, s_env *env)
+{
+        if (!consp(args))
+                return error(env, "invalid arguments for make-thread");
+        return (u_form*) make_thread(args->cons.car, args->cons.cdr, env);
+}
+
+u_form * cfun_join_thread (u_form *args, s_env *env)
+{
+        if (!consp(args) || !threadp(args->cons.car) ||
+            args->cons.cdr != nil())
+                return error(env, "invalid arguments for join-thread");
+        return join_thread((s_thread*) args->cons.car, env);
+}
+
+u_form * cfun_threadp (u_form *args, s_env *env)
+{
+        if (!consp(args) || args->cons.cdr != nil())
+                return error(env, "invalid arguments for threadp");
+        return threadp(args->cons.car) ? g_sym.t : nil();
+}
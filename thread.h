@@ -0,0 +1,32 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <pthread.h>
+#include "env.h"
+#include "form.h"
+
+typedef struct thread s_thread;
+
+/* A thread applies a function to its arguments in an env of its own,
+   which shares the global frame and packages of the env that made
+   it. join-thread returns the result, or signals the error that
+   ended the thread. */
+struct thread {
+        e_form_type type;
+        pthread_t pthread;
+        u_form *function;
+        u_form *args;
+        u_form *result;
+        s_string *error;
+        int joined;
+        s_env env;
+};
+
+s_thread * make_thread (u_form *function, u_form *args, s_env *env);
+u_form *   join_thread (s_thread *th, s_env *env);
+
+u_form * cfun_make_thread (u_form *args, s_env *env);
+u_form * cfun_join_thread (u_form *args, s_env *env);
+u_form * cfun_threadp (u_form *args, s_env *env);
+
+#endif
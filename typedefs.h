@@ -1,7 +1,6 @@
 #ifndef TYPEDEFS_H
 #define TYPEDEFS_H
 
-typedef struct values  s_values;
 typedef struct cons    s_cons;
 typedef struct string  s_string;
 typedef struct symbol  s_symbol;
@@ -10,6 +9,7 @@ typedef struct cfun    s_cfun;
 typedef struct lambda  s_lambda;
 typedef struct lng     s_long;
 typedef struct dbl     s_double;
+typedef struct character s_character;
 
 typedef union form u_form;
 
@@ -19,10 +19,16 @@ typedef struct block s_block;
 typedef struct env s_env;
 typedef struct error_handler s_error_handler;
 typedef struct frame s_frame;
+typedef struct function_stats s_function_stats;
 typedef struct hashtable s_hashtable;
+typedef struct hashtable_array s_hashtable_array;
+typedef struct stats_call s_stats_call;
 typedef struct stream s_stream;
+typedef struct symbol_entry s_symbol_entry;
+typedef struct symbol_table s_symbol_table;
 typedef struct tags s_tags;
 typedef struct unwind_protect s_unwind_protect;
+typedef struct vector s_vector;
 
 typedef u_form * f_cfun (u_form *args, s_env *env);
 
@@ -1,4 +1,5 @@
 
+#include <string.h>
 #include "env.h"
 #include "eval.h"
 #include "unwind_protect.h"
@@ -15,18 +16,28 @@ void pop_unwind_protect (s_env *env)
                 env->unwind_protect = env->unwind_protect->next;
 }
 
+/* Evaluates form then body, even if form exits non-locally, and
+   returns the values of form. */
 u_form * unwind_protect (u_form *form, u_form *body, s_env *env)
 {
-        u_form *f = nil();
+        u_form *values[MULTIPLE_VALUES_LIMIT];
+        unsigned long count;
+        u_form *f;
         s_unwind_protect up;
         if (setjmp(up.buf)) {
                 pop_unwind_protect(env);
                 cspecial_progn(body, env);
                 longjmp(*up.jmp, 1);
         }
+        push_unwind_protect(&up, env);
         f = eval(form, env);
         pop_unwind_protect(env);
+        if ((count = env->values_count) > 1)
+                memcpy(values, env->values, count * sizeof(u_form*));
         cspecial_progn(body, env);
+        if (count > 1)
+                memcpy(env->values, values, count * sizeof(u_form*));
+        env->values_count = count;
         return f;
 }
 
@@ -0,0 +1,303 @@
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "env.h"
+#include "error.h"
+#include "eval.h"
+#include "form.h"
+#include "package.h"
+#include "symbols.h"
+#include "vector.h"
+
+unsigned long vector_element_size (e_vector_element_type element_type)
+{
+        switch (element_type) {
+        case VECTOR_T:
+                return sizeof(u_form*);
+        case VECTOR_U8:
+                return sizeof(unsigned char);
+        case VECTOR_FIXNUM:
+                return sizeof(long);
+        case VECTOR_DOUBLE:
+                return sizeof(double);
+        }
+        return 0;
+}
+
+static void vector_fill (s_vector *v, unsigned long start,
+                         unsigned long end)
+{
+        if (v->element_type == VECTOR_T)
+                while (start < end)
+                        vector_t(v)[start++] = nil();
+        else
+                memset((char*) v->data + start *
+                       vector_element_size(v->element_type), 0,
+                       (end - start) *
+                       vector_element_size(v->element_type));
+}
+
+/* The largest size whose data fits in an unsigned long of bytes. */
+unsigned long vector_max_size (e_vector_element_type element_type)
+{
+        return ULONG_MAX / vector_element_size(element_type);
+}
+
+s_vector * new_vector (e_vector_element_type element_type,
+                       unsigned long size)
+{
+        s_vector *v;
+        if (size > vector_max_size(element_type) ||
+            !(v = malloc(sizeof(s_vector))))
+                return NULL;
+        v->type = FORM_VECTOR;
+        v->element_type = element_type;
+        v->length = size;
+        v->size = size;
+        v->data = malloc((size ? size : 1) *
+                         vector_element_size(element_type));
+        if (!v->data) {
+                free(v);
+                return NULL;
+        }
+        vector_fill(v, 0, size);
+        alloc_track(FORM_VECTOR, sizeof(s_vector) + size *
+                    vector_element_size(element_type));
+        return v;
+}
+
+s_vector * list_to_vector (u_form *list)
+{
+        s_vector *v = new_vector(VECTOR_T, length(list));
+        unsigned long i = 0;
+        if (v)
+                while (consp(list)) {
+                        vector_t(v)[i++] = list->cons.car;
+                        list = list->cons.cdr;
+                }
+        return v;
+}
+
+u_form * vector_ref (s_vector *v, unsigned long index)
+{
+        switch (v->element_type) {
+        case VECTOR_T:
+                return vector_t(v)[index];
+        case VECTOR_U8:
+                return (u_form*) new_long(vector_u8(v)[index]);
+        case VECTOR_FIXNUM:
+                return (u_form*) new_long(vector_fixnum(v)[index]);
+        case VECTOR_DOUBLE:
+                return (u_form*) new_double(vector_double(v)[index]);
+        }
+        return NULL;
+}
+
+int vector_set (s_vector *v, unsigned long index, u_form *x)
+{
+        switch (v->element_type) {
+        case VECTOR_T:
+                vector_t(v)[index] = x;
+                return 0;
+        case VECTOR_U8:
+                if (!integerp(x) || x->lng.lng < 0 || x->lng.lng > 255)
+                        return -1;
+                vector_u8(v)[index] = x->lng.lng;
+                return 0;
+        case VECTOR_FIXNUM:
+                if (!integerp(x))
+                        return -1;
+                vector_fixnum(v)[index] = x->lng.lng;
+                return 0;
+        case VECTOR_DOUBLE:
+                if (floatp(x))
+                        vector_double(v)[index] = x->dbl.dbl;
+                else if (integerp(x))
+                        vector_double(v)[index] = x->lng.lng;
+                else
+                        return -1;
+                return 0;
+        }
+        return -1;
+}
+
+int vector_push_extend (s_vector *v, u_form *x, unsigned long extension)
+{
+        if (v->length == v->size) {
+                unsigned long max = vector_max_size(v->element_type);
+                unsigned long size = v->size > max / 2 ? max :
+                        v->size * 2;
+                void *data;
+                if (extension > max - v->size || v->size == max)
+                        return -1;
+                if (size < v->size + extension)
+                        size = v->size + extension;
+                if (size == v->size)
+                        size++;
+                data = realloc(v->data, size *
+                               vector_element_size(v->element_type));
+                if (!data)
+                        return -1;
+                v->data = data;
+                vector_fill(v, v->size, size);
+                v->size = size;
+        }
+        if (vector_set(v, v->length, x))
+                return -1;
+        v->length++;
+        return 0;
+}
+
+static int element_type_designator (u_form *x, e_vector_element_type *et)
+{
+        if (x == g_sym.t)
+                *et = VECTOR_T;
+        else if (x == g_sym.fixnum)
+                *et = VECTOR_FIXNUM;
+        else if (x == g_sym.double_float)
+                *et = VECTOR_DOUBLE;
+        else if (car(x) == g_sym.unsigned_byte &&
+                 integerp(cadr(x)) && cadr(x)->lng.lng == 8 &&
+                 cddr(x) == nil())
+                *et = VECTOR_U8;
+        else
+                return -1;
+        return 0;
+}
+
+u_form * cfun_make_array (u_form *args, s_env *env)
+{
+        u_form *size;
+        u_form *element_type;
+        u_form *initial_element;
+        u_form *fill_pointer;
+        e_vector_element_type et;
+        s_vector *v;
+        unsigned long i;
+        if (!consp(args))
+                return error(env, "invalid arguments for make-array");
+        size = args->cons.car;
+        if (consp(size) && size->cons.cdr == nil())
+                size = size->cons.car;
+        element_type = getf(args->cons.cdr, g_kw.element_type, g_sym.t);
+        initial_element = getf(args->cons.cdr, g_kw.initial_element,
+                               NULL);
+        fill_pointer = getf(args->cons.cdr, g_kw.fill_pointer, nil());
+        if (element_type_designator(element_type, &et))
+                return error(env, "make-array: unsupported element "
+                             "type");
+        if (!integerp(size) || size->lng.lng < 0 ||
+            (unsigned long) size->lng.lng > vector_max_size(et))
+                return error(env, "make-array: invalid dimension");
+        if (!(v = new_vector(et, size->lng.lng)))
+                return error(env, "make-array: out of memory");
+        if (initial_element)
+                for (i = 0; i < v->size; i++)
+                        if (vector_set(v, i, initial_element))
+                                return error(env, "make-array: invalid "
+                                             "initial element");
+        if (integerp(fill_pointer)) {
+                if (fill_pointer->lng.lng < 0 ||
+                    (unsigned long) fill_pointer->lng.lng > v->size)
+                        return error(env, "make-array: invalid fill "
+                                     "pointer");
+                v->length = fill_pointer->lng.lng;
+        }
+        return (u_form*) v;
+}
+
+u_form * cfun_vector (u_form *args, s_env *env)
+{
+        (void) env;
+        return (u_form*) list_to_vector(args);
+}
+
+u_form * cfun_vectorp (u_form *args, s_env *env)
+{
+        if (!consp(args) || args->cons.cdr != nil())
+                return error(env, "invalid arguments for vectorp");
+        return vectorp(args->cons.car) ? g_sym.t : nil();
+}
+
+static long vector_index (u_form *v, u_form *index, const char *name,
+                          s_env *env)
+{
+        if (!vectorp(v))
+                error(env, "%s: not a vector", name);
+        if (!integerp(index) || index->lng.lng < 0 ||
+            (unsigned long) index->lng.lng >= v->vector.size)
+                error(env, "%s: index out of bounds", name);
+        return index->lng.lng;
+}
+
+u_form * cfun_aref (u_form *args, s_env *env)
+{
+        long i;
+        if (!consp(args) || !consp(args->cons.cdr) ||
+            args->cons.cdr->cons.cdr != nil())
+                return error(env, "invalid arguments for aref");
+        i = vector_index(args->cons.car, args->cons.cdr->cons.car,
+                         "aref", env);
+        return vector_ref(&args->cons.car->vector, i);
+}
+
+u_form * cfun_aset (u_form *args, s_env *env)
+{
+        long i;
+        u_form *x;
+        if (!consp(args) || !consp(args->cons.cdr) ||
+            !consp(args->cons.cdr->cons.cdr) ||
+            args->cons.cdr->cons.cdr->cons.cdr != nil())
+                return error(env, "invalid arguments for aset");
+        i = vector_index(args->cons.car, args->cons.cdr->cons.car,
+                         "aset", env);
+        x = args->cons.cdr->cons.cdr->cons.car;
+        if (vector_set(&args->cons.car->vector, i, x))
+                return error(env, "aset: value does not match the "
+                             "array element type");
+        return x;
+}
+
+u_form * cfun_vector_push_extend (u_form *args, s_env *env)
+{
+        s_vector *v;
+        unsigned long extension = 1;
+        if (!consp(args) || !consp(args->cons.cdr) ||
+            !vectorp(args->cons.cdr->cons.car))
+                return error(env, "invalid arguments for "
+                             "vector-push-extend");
+        if (consp(cddr(args))) {
+                if (!integerp(caddr(args)) || caddr(args)->lng.lng < 1 ||
+                    cdr(cddr(args)) != nil())
+                        return error(env, "invalid arguments for "
+                                     "vector-push-extend");
+                extension = caddr(args)->lng.lng;
+        }
+        v = &args->cons.cdr->cons.car->vector;
+        if (vector_push_extend(v, args->cons.car, extension))
+                return error(env, "vector-push-extend: value does not "
+                             "match the array element type");
+        return (u_form*) new_long(v->length - 1);
+}
+
+u_form * cfun_array_element_type (u_form *args, s_env *env)
+{
+        if (!consp(args) || !vectorp(args->cons.car) ||
+            args->cons.cdr != nil())
+                return error(env, "invalid arguments for "
+                             "array-element-type");
+        switch (args->cons.car->vector.element_type) {
+        case VECTOR_T:
+                return g_sym.t;
+        case VECTOR_U8:
+                return cons(g_sym.unsigned_byte,
+                            cons((u_form*) new_long(8), nil()));
+        case VECTOR_FIXNUM:
+                return g_sym.fixnum;
+        case VECTOR_DOUBLE:
+                return g_sym.double_float;
+        }
+        return nil();
+}
@@ -0,0 +1,44 @@
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include "typedefs.h"
+
+typedef enum vector_element_type {
+        VECTOR_T,
+        VECTOR_U8,
+        VECTOR_FIXNUM,
+        VECTOR_DOUBLE
+} e_vector_element_type;
+
+struct vector {
+        e_form_type type;
+        e_vector_element_type element_type;
+        unsigned long length;
+        unsigned long size;
+        void *data;
+};
+
+#define vector_t(v)      ((u_form**) ((s_vector*) v)->data)
+#define vector_u8(v)     ((unsigned char*) ((s_vector*) v)->data)
+#define vector_fixnum(v) ((long*) ((s_vector*) v)->data)
+#define vector_double(v) ((double*) ((s_vector*) v)->data)
+
+s_vector *    new_vector (e_vector_element_type element_type,
+                          unsigned long size);
+s_vector *    list_to_vector (u_form *list);
+unsigned long vector_element_size (e_vector_element_type element_type);
+unsigned long vector_max_size (e_vector_element_type element_type);
+u_form *      vector_ref (s_vector *v, unsigned long index);
+int           vector_set (s_vector *v, unsigned long index, u_form *x);
+int           vector_push_extend (s_vector *v, u_form *x,
+                                  unsigned long extension);
+
+u_form * cfun_make_array (u_form *args, s_env *env);
+u_form * cfun_vector (u_form *args, s_env *env);
+u_form * cfun_vectorp (u_form *args, s_env *env);
+u_form * cfun_aref (u_form *args, s_env *env);
+u_form * cfun_aset (u_form *args, s_env *env);
+u_form * cfun_vector_push_extend (u_form *args, s_env *env);
+u_form * cfun_array_element_type (u_form *args, s_env *env);
+
+#endif